@@ -1,6 +1,6 @@
 //FILE: client/app_simple_client.c
 //
-//Description: this is the simple client application code. The client first connects to the local SNP process. Then it initializes the SRT client by calling srt_client_init(). It creates 2 sockets and connects to the server  by calling srt_client_sock() and srt_client_connect() twice. It then sends short strings to the server from these two connections. After some time, the client disconnects from the server by calling srt_client_disconnect(). Finally the client closes the socket by calling srt_client_close(). The client then disconnects from the local SNP process.
+//Description: this is the simple client application code. The client first connects to the local SNP process. Then it initializes the SRT client by calling srt_client_init(). It creates 2 sockets and connects to the server  by calling srt_client_sock() and srt_client_connect() twice. It then sends short strings to the server from these two connections. Once the server has Acked the strings, the client disconnects from the server by calling srt_client_disconnect(). Finally the client closes the socket by calling srt_client_close(). The client then disconnects from the local SNP process.
 
 //Date: May 6, 2008
 
@@ -22,16 +22,13 @@
 #include "../topology/topology.h"
 #include "srt_client.h"
 
-//Two connection are created. One uses client port CLIENTPORT1 and server port SVRPORT1. The other uses client port CLIENTPORT2 and server port SVRPORT2.
+//Two connection are created to server port SVRPORT1, where the server accepts both. One uses client port CLIENTPORT1, the other uses client port CLIENTPORT2.
 #define CLIENTPORT1 87
 #define SVRPORT1 88
 #define CLIENTPORT2 89
-#define SVRPORT2 90
 
 //After connecting to the SNP process, wait STARTDELAY for server to start.
 #define STARTDELAY 1
-//After the strings are sent, wait WAITTIME seconds, and then close the connections.
-#define WAITTIME 5
 
 //This function connects to the local SNP process on port NETWORK_PORT. If TCP connection fails, return -1. The TCP socket desciptor returned will be used by SRT to send segments.
 int connectToNetwork() {
@@ -94,17 +91,17 @@ int main() {
 	}
 	printf("client connected to server, client port:%d, server port %d\n",CLIENTPORT1,SVRPORT1);
 	
-	//create a srt client sock on port CLIENTPORT2 and connect to srt server port SVRPORT2
+	//create a srt client sock on port CLIENTPORT2 and connect to srt server port SVRPORT1, too
 	int sockfd2 = srt_client_sock(CLIENTPORT2);
 	if(sockfd2<0) {
 		printf("fail to create srt client sock");
 		exit(1);
 	}
-	if(srt_client_connect(sockfd2,svr_nodeID,SVRPORT2)<0) {
+	if(srt_client_connect(sockfd2,svr_nodeID,SVRPORT1)<0) {
 		printf("fail to connect to srt server\n");
 		exit(1);
 	}
-	printf("client connected to server, client port:%d, server port %d\n",CLIENTPORT2, SVRPORT2);
+	printf("client connected to server, client port:%d, server port %d\n",CLIENTPORT2, SVRPORT1);
 
 	//send strings through the first connection
       	char mydata[6] = "hello";
@@ -120,8 +117,7 @@ int main() {
 		printf("send string:%s to connection 2\n",mydata2);	
       	}
 
-	//wait for a while and close the connections
-	sleep(WAITTIME);
+	//close the connections, srt_client_disconnect lingers until the server Acked all strings
 
 	if(srt_client_disconnect(sockfd)<0) {
 		printf("fail to disconnect from srt server\n");
@@ -1,6 +1,6 @@
 //FILE: client/app_stress_client.c
 //
-//Description: this is the stress test client application code. The client first connects to the local SNP process. Then it initializes the SRT client by calling srt_client_init(). It creates a socket and connects to the server  by calling srt_client_sock() and srt_client_connect(). Then it reads text data from file sampletext.txt, and sends the length of the file and file data to the server. After some time, the client disconnects from the server by calling srt_client_disconnect(). Finally the client closes the socket by calling srt_client_close(). The client then disconnects from the local SNP process.
+//Description: this is the stress test client application code. The client first connects to the local SNP process. Then it initializes the SRT client by calling srt_client_init(). It creates a socket and connects to the server  by calling srt_client_sock() and srt_client_connect(). Then it sends the length of the file send_this_text.txt and, by calling srt_client_sendfile(), the file data straight from the file to the server. Once the server has Acked the file data, the client disconnects from the server by calling srt_client_disconnect(). Finally the client closes the socket by calling srt_client_close(). The client then disconnects from the local SNP process.
 
 //Date: May 6, 2008
 
@@ -15,6 +15,7 @@
 #include <arpa/inet.h>
 #include <netdb.h>
 #include <unistd.h>
+#include <fcntl.h>
 #include <assert.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -28,8 +29,6 @@
 
 //After connecting to tehe local SNP process, wait STARTDELAY for server to start.
 #define STARTDELAY 1
-//After the file is sent, the client waits for WAITTIME seconds, and then closes the connection.
-#define WAITTIME 5
 
 //This function connects to the local SNP process on port NETWORK_PORT. If TCP connection fails, return -1. The TCP socket desciptor returned will be used by SRT to send segments.
 int connectToNetwork() {
@@ -94,23 +93,20 @@ int main() {
 	}
 	printf("client connected to server, client port:%d, server port %d\n",CLIENTPORT1,SVRPORT1);
 	
-	//get sampletext.txt file length,
-	//create a buffer and read the file data in
-	FILE *f;
-	f = fopen("send_this_text.txt","r");
-	assert(f!=NULL);
-	fseek(f,0,SEEK_END);
-	int fileLen = ftell(f);
-	fseek(f,0,SEEK_SET);
-	char *buffer = (char*)malloc(fileLen);
-	fread(buffer,fileLen,1,f);
-	fclose(f);
-	//send file length first, then send the whole file
+	//get sampletext.txt file length
+	int fd = open("send_this_text.txt",O_RDONLY);
+	assert(fd>=0);
+	int fileLen = lseek(fd,0,SEEK_END);
+	//send file length first, then send the whole file straight from the file
 	srt_client_send(sockfd,&fileLen,sizeof(int));
-      	srt_client_send(sockfd, buffer, fileLen);
-	free(buffer);
-	//wait for a while and close the connections
-	sleep(WAITTIME);
+	if(srt_client_sendfile(sockfd,fd,0,fileLen)<0) {
+		printf("fail to send the file\n");
+	}
+	close(fd);
+	//wait until the server Acked the whole file and close the connection
+	if(srt_client_flush(sockfd)<0) {
+		printf("fail to deliver the file\n");
+	}
 
 	if(srt_client_disconnect(sockfd)<0) {
 		printf("fail to disconnect from srt server\n");
@@ -16,36 +16,17 @@
 #include <unistd.h>
 #include <time.h>
 #include <string.h>
+#include <errno.h>
 #include <pthread.h>
 #include "srt_client.h"
 #include "../topology/topology.h"
 
-#ifdef __MACH__
-#include <mach/clock.h>
-#include <mach/mach.h>
-#endif
-
-
-unsigned long current_utc_time_ns(struct timespec *ts) {
-#ifdef __MACH__ // OS X does not have clock_gettime, use clock_get_time
-  clock_serv_t cclock;
-  mach_timespec_t mts;
-  host_get_clock_service(mach_host_self(), CALENDAR_CLOCK, &cclock);
-  clock_get_time(cclock, &mts);
-  mach_port_deallocate(mach_task_self(), cclock);
-  ts->tv_sec = mts.tv_sec;
-  ts->tv_nsec = mts.tv_nsec;
-  return ts->tv_nsec + ts->tv_sec*NANOSECONDS_PER_SECOND;
-#else
-  clock_gettime(CLOCK_REALTIME, ts);
-  return ts->tv_nsec;
-#endif
-}
-
-
 // global variables
 int overlay_conn_fd; // for the overlay TCP socket descriptor ‘‘conn’’ used as input parameter for snp_sendseg and snp_recvseg
-client_tcb_t *client_TCB_Table[MAX_TRANSPORT_CONNECTIONS];
+txsched_t *txSched; // transmit scheduler sending the segments of all sockets on the overlay connection
+fastopen_cookie_t cookieCache[FASTOPEN_COOKIE_CACHE]; // fast open cookies of the servers, indexed by node ID
+pthread_mutex_t cookieMutex = PTHREAD_MUTEX_INITIALIZER; // protects cookieCache
+conntable_t clientConnTable; // socket descriptors of the client TCBs and their index by connection
 
 
 //
@@ -65,11 +46,12 @@ client_tcb_t *client_TCB_Table[MAX_TRANSPORT_CONNECTIONS];
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
 
-// This function initializes the TCB table marking all entries NULL. It also initializes 
+// This function initializes the connection table of the TCBs. It also initializes 
 // a global variable for the overlay TCP socket descriptor ``conn'' used as input parameter
-// for snp_sendseg and snp_recvseg. Finally, the function starts the seghandler thread to 
-// handle the incoming segments. There is only one seghandler for the client side which
-// handles call connections for the client.
+// for snp_sendseg and snp_recvseg, and starts the transmit scheduler that sends the
+// segments of all sockets on it. Finally, the function starts the dispatcher 
+// thread and its pool of worker threads, which run seghandler for the incoming segments
+// of all connections, each connection on one worker.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
@@ -77,71 +59,99 @@ void srt_client_init(int conn)
 {
 	//Initialize global overaly TCP socket descriptor for sendseg and recvseg
 	overlay_conn_fd = conn;
+	conntable_init(&clientConnTable);
 
-	// instantiation of seghandler thread
-	//there's only one seghandler for the client side. Start seghandler thread to handle incoming segments
-	pthread_t segHandlerThread;
-    if (pthread_create(&segHandlerThread, NULL, seghandler, NULL)){
-    	printf("Error creating seghandler thread.\n");
-    }
+	//start the transmit scheduler, all sockets send through it
+	txSched = txsched_start(conn);
+	if (txSched == NULL) {
+		printf("Error starting the transmit scheduler.\n");
+	}
+
+	//start the dispatcher, its worker threads run seghandler for the incoming segments
+	if (dispatch_start(conn, seghandler) == NULL) {
+		printf("Error starting the seghandler threads.\n");
+	}
 
 	printf("Initialized client.\n");
 }
 
 
-// This function looks up the client TCB table to find the first NULL entry, and creates
-// a new TCB entry using malloc() for that entry. All fields in the TCB are initialized 
+// This function creates a new TCB entry using malloc() and stores it in the client connection
+// table, which hands out a free socket descriptor for it. All fields in the TCB are initialized 
 // e.g., TCB state is set to CLOSED and the client port set to the function call parameter 
-// client port.  The TCB table entry index should be returned as the new socket ID to the client 
-// and be used to identify the connection on the client side. If no entry in the TC table  
-// is available the function returns -1.
+// client port.  The socket descriptor should be returned as the new socket ID to the client 
+// and be used to identify the connection on the client side. If MAX_TRANSPORT_CONNECTIONS  
+// sockets are in use the function returns -1.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
 int srt_client_sock(unsigned int client_port)
 {
-	//malloc new TCB entry at first NULL entry
-	int sockfd = 0;
-	while (sockfd < MAX_TRANSPORT_CONNECTIONS){
-		if (client_TCB_Table[sockfd] == NULL) {
-
-			//malloc new client tcb entry
-			client_TCB_Table[sockfd] = malloc(sizeof(client_tcb_t));
-			MALLOC_CHECK(client_TCB_Table[sockfd]);
-			memset(client_TCB_Table[sockfd], 0, sizeof(client_tcb_t));
-
-			//initialize TCB entry
-			client_TCB_Table[sockfd]->client_portNum = client_port;
-			client_TCB_Table[sockfd]->state = CLOSED;
-			client_TCB_Table[sockfd]->next_seqNum = 0;
-			client_TCB_Table[sockfd]->bufMutex = malloc(sizeof(pthread_mutex_t));
-			memset(client_TCB_Table[sockfd]->bufMutex, 0, sizeof(pthread_mutex_t));
-			client_TCB_Table[sockfd]->sendBufHead = NULL;
-			client_TCB_Table[sockfd]->sendBufTail = NULL;
-			client_TCB_Table[sockfd]->sendBufunSent = NULL;
-			client_TCB_Table[sockfd]->unAck_segNum = 0;
-			client_TCB_Table[sockfd]->client_nodeID = topology_getMyNodeID(); //new
-			printf("My nodeID is %u.\n", client_TCB_Table[sockfd]->client_nodeID);
-
-			//initialize mutex
-			if (pthread_mutex_init(client_TCB_Table[sockfd]->bufMutex, NULL) != 0) {
-			    printf("\n mutex init failed\n");
-			    return -1;
-			}
+	return srt_client_socktype(client_port, SRT_STREAM);
+}
 
-			break;
-		} else {
-			sockfd++;
-		}
+
+// Creates a socket like srt_client_sock, of the given type: SRT_STREAM, the type of
+// srt_client_sock, carries a byte stream, SRT_SEQPACKET carries messages. On a SRT_SEQPACKET
+// socket each srt_client_send is one message, however many segments it takes, and the server
+// receives it whole with one srt_server_recvmsg; srt_client_recvmsg does the same for the
+// messages of the server. It only connects to a server socket that is SRT_SEQPACKET too.
+// Forward error correction isn't used on SRT_SEQPACKET connections.
+// On a SRT_DGRAM socket, srt_client_connect only sets the server port the datagrams go to and
+// come from, without a handshake, each srt_client_send is one datagram of at most MAX_SEG_LEN
+// bytes, and srt_client_recvmsg receives the datagrams of the server. Datagrams aren't Acked or
+// retransmitted, see srt_server_sendto. Returns the socket descriptor, or -1 if the type is
+// unknown or MAX_TRANSPORT_CONNECTIONS sockets are in use.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_socktype(unsigned int client_port, int type)
+{
+	if (type != SRT_STREAM && type != SRT_SEQPACKET && type != SRT_DGRAM) {
+		printf("Unknown socket type %d.\n", type);
+		return -1;
 	}
 
-	if (sockfd == MAX_TRANSPORT_CONNECTIONS) {
+	//malloc new client tcb entry
+	client_tcb_t *newTCB = malloc(sizeof(client_tcb_t));
+	MALLOC_CHECK(newTCB);
+	memset(newTCB, 0, sizeof(client_tcb_t));
+
+	//initialize TCB entry
+	newTCB->client_portNum = client_port;
+	newTCB->state = CLOSED;
+	newTCB->bufMutex = malloc(sizeof(pthread_mutex_t));
+	memset(newTCB->bufMutex, 0, sizeof(pthread_mutex_t));
+	timer_condinit(&newTCB->stateCond);
+	txsched_flowinit(&newTCB->txFlow);
+	stream_init(&newTCB->stream, newTCB->bufMutex, txSched, &newTCB->txFlow);
+	newTCB->client_nodeID = topology_getMyNodeID(); //new
+	printf("My nodeID is %u.\n", newTCB->client_nodeID);
+
+	//initialize mutex
+	if (pthread_mutex_init(newTCB->bufMutex, NULL) != 0) {
+	    printf("\n mutex init failed\n");
+	    free(newTCB->bufMutex);
+	    free(newTCB);
+	    return -1;
+	}
+	stream_setseqpacket(&newTCB->stream, type == SRT_SEQPACKET);
+
+	//the TCB is bound to its connection in srt_client_connect
+	int sockfd = conntable_alloc(&clientConnTable, newTCB);
+	if (sockfd < 0) {
 		printf("You've reached the maximum number of transport connections.\n");
+		pthread_mutex_destroy(newTCB->bufMutex);
+		free(newTCB->bufMutex);
+		free(newTCB);
 		return -1;
-	} else {
-		printf("Created new TCB client entry with sockfd %d.\n", sockfd);
-		return sockfd;
 	}
+	newTCB->sockfd = sockfd;
+	if (type == SRT_DGRAM) {
+		newTCB->dgram = dgram_create(newTCB->bufMutex, txSched, &newTCB->txFlow, client_port);
+	}
+	printf("Created new TCB client entry with sockfd %d.\n", sockfd);
+	return sockfd;
 }
 
 
@@ -152,13 +162,30 @@ int srt_client_sock(unsigned int client_port)
 // If no SYNACK is received after SYNSEG_TIMEOUT timeout, then the SYN is 
 // retransmitted. If SYNACK is received, return 1. Otherwise, if the number of SYNs 
 // sent > SYN_MAX_RETRY,  transition to CLOSED state and return -1.
+// The SYN carries the client's MSS and the SYNACK carries the MSS agreed by the server.
+// The SYNACK also carries a fast open cookie, which is cached for srt_client_connect_send.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
 int srt_client_connect(int sockfd, int nodeID, unsigned int server_port)
+{
+	return srt_client_connect_send(sockfd, nodeID, server_port, NULL, 0);
+}
+
+
+// Connects like srt_client_connect and sends length bytes of data. If a fast open cookie
+// of the server is cached from an earlier connection, the first segment of the data goes
+// out in the SYN and the server delivers it before the handshake completes, saving the
+// round trip. Otherwise, or if the server doesn't accept the data on SYN, all data is
+// sent with srt_client_send once connected. Every SYN asks the server for a cookie.
+// Returns 1 if connected and the data is queued, -1 otherwise.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_connect_send(int sockfd, int nodeID, unsigned int server_port, void* data, unsigned int length)
 {
 	//find TCB entry
-	client_tcb_t *currentTCB = client_TCB_Table[sockfd];
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
 	if (currentTCB == NULL){
 		printf("Couldn't find the specified client TCB entry.\n");
 		return -1;
@@ -189,6 +216,15 @@ int srt_client_connect(int sockfd, int nodeID, unsigned int server_port)
 	//set up server port number
 	currentTCB->svr_portNum = server_port;
 	currentTCB->svr_nodeID = nodeID; //new
+	//segments from the server are routed to this TCB from now on
+	conntable_bind(&clientConnTable, sockfd, currentTCB->client_portNum, nodeID, server_port);
+
+	//datagrams need no handshake
+	if (currentTCB->dgram != NULL) {
+		printf("Datagram socket. Sending to server port %u from now on.\n", server_port);
+		currentTCB->state = CONNECTED;
+		return (length > 0) ? srt_client_send(sockfd, data, length) : 1;
+	}
 
 	//create SYN seg_t
 	seg_t* synSegPtr = malloc(sizeof(seg_t));
@@ -197,50 +233,99 @@ int srt_client_connect(int sockfd, int nodeID, unsigned int server_port)
 	synSegPtr->header.src_port = currentTCB->client_portNum;
 	synSegPtr->header.dest_port = currentTCB->svr_portNum;
 	synSegPtr->header.type = SYN;
-	synSegPtr->header.seq_num = currentTCB->next_seqNum;
+	pthread_mutex_lock(currentTCB->bufMutex);
+	stream_pickisn(&currentTCB->stream, currentTCB->client_portNum, nodeID, server_port);
+	synSegPtr->header.seq_num = currentTCB->stream.next_seqNum;
+	pthread_mutex_unlock(currentTCB->bufMutex);
+
+	//announce our MSS and offer timestamps, seghandler opens the stream with what the server agrees to
+	srt_synopt_t synOpt;
+	memset(&synOpt, 0, sizeof(srt_synopt_t));
+	synOpt.mss = MAX_SEG_LEN;
+
+	//ask for a fast open cookie, and send the first data right away if we have one
+	unsigned int synDataLen = 0;
+	synOpt.flags = SYNOPT_COOKIE_REQ | SYNOPT_TIMESTAMP;
+	if (length > 0 && cookieCacheGet(nodeID, &synOpt.cookie)) {
+		synOpt.flags |= SYNOPT_COOKIE;
+	}
+	//a rebuilt segment wouldn't know whether it ends a message
+	if (currentTCB->stream.fecWanted && !currentTCB->stream.seqpacket) {
+		synOpt.flags |= SYNOPT_FEC;
+	}
+	if (currentTCB->stream.seqpacket) {
+		synOpt.flags |= SYNOPT_SEQPACKET;
+	}
+	seg_putsynopt(synSegPtr, &synOpt);
+	if (synOpt.flags & SYNOPT_COOKIE) {
+		synDataLen = seg_putsyndata(synSegPtr, data, length);
+		//a message only goes out in the SYN if it fits whole
+		if (currentTCB->stream.seqpacket && synDataLen < length) {
+			seg_putsynopt(synSegPtr, &synOpt);
+			synDataLen = 0;
+		}
+		printf("Fast open: sending %u bytes in the SYN.\n", synDataLen);
+	}
+	currentTCB->synDataAcked = 0;
 
+	pthread_mutex_lock(currentTCB->bufMutex);
 	currentTCB->state = SYNSENT;
 	//send SYN seg_t
-	if (snp_sendseg(overlay_conn_fd, currentTCB->svr_nodeID, synSegPtr) < 0) {
+	if (txsched_send(txSched, &currentTCB->txFlow, currentTCB->svr_nodeID, synSegPtr) < 0) {
 		printf("Error sending SYN seg_t.\n");
+		currentTCB->state = CLOSED;
+		pthread_mutex_unlock(currentTCB->bufMutex);
+		free(synSegPtr);
 		return -1;
 	}
 
-
-	//start timer
-	struct timespec ts;
-	unsigned long  tstart, tend;
-	tstart = current_utc_time_ns(&ts);
+	//wait for the SYNACK, seghandler changes the state to CONNECTED and signals stateCond.
+	//The SYN is resent every SYN_TIMEOUT, at most SYN_MAX_RETRY times
+	unsigned long deadline = timer_now_ns() + SYN_TIMEOUT;
 	int tries = 0;
-
-	//keep trying until receive SYNACK (seghandler changes currentTCB.state to CONNECTED) or max out tries
-	while (tries < SYN_MAX_RETRY && currentTCB->state == SYNSENT) {
-		//calc time elapsed
-		tend = current_utc_time_ns(&ts);
-		if (tstart > tend) 
-			tend += 1000000000;
-		
-		//if timeout, resend SYN
-		if (labs(tend - tstart) > SYN_TIMEOUT) {
-			tstart = current_utc_time_ns(&ts);
-			//resend SYN and increment tries
-			printf("Resending SYN.\n");
-			if (snp_sendseg(overlay_conn_fd, currentTCB->svr_nodeID, synSegPtr) < 0) {
-				printf("Error sending SYN seg_t.\n");
-				return -1;
-			}
-			tries++;
+	while (currentTCB->state == SYNSENT) {
+		if (timer_condwait(&currentTCB->stateCond, currentTCB->bufMutex, deadline) != ETIMEDOUT
+			|| currentTCB->state != SYNSENT) {
+			continue;
+		}
+		if (tries == SYN_MAX_RETRY) {
+			break;
 		}
+		//resend SYN and increment tries
+		printf("Resending SYN.\n");
+		if (txsched_send(txSched, &currentTCB->txFlow, currentTCB->svr_nodeID, synSegPtr) < 0) {
+			printf("Error sending SYN seg_t.\n");
+			break;
+		}
+		tries++;
+		deadline = timer_now_ns() + SYN_TIMEOUT;
 	}
+	int connected = (currentTCB->state == CONNECTED);
+	if (!connected) {
+		currentTCB->state = CLOSED;
+	}
+	pthread_mutex_unlock(currentTCB->bufMutex);
 
 	free(synSegPtr);
 	//if SYNACK is received, seghandler will change state to CONNECTED
-	if (currentTCB->state == CONNECTED) {
+	if (connected) {
 		printf("We're CONNECTED!\n");
+		//the SYNACK acknowledges the data the server took from the SYN
+		if (currentTCB->synDataAcked) {
+			pthread_mutex_lock(currentTCB->bufMutex);
+			currentTCB->stream.next_seqNum += synDataLen;
+			currentTCB->stream.pushSeq = currentTCB->stream.next_seqNum;
+			pthread_mutex_unlock(currentTCB->bufMutex);
+			printf("Fast open: server took %u bytes from the SYN.\n", synDataLen);
+		} else {
+			synDataLen = 0;
+		}
+		if (length > synDataLen) {
+			return srt_client_send(sockfd, (char *)data + synDataLen, length - synDataLen);
+		}
 		return 1;
 	} else {
 		printf("Couldn't connect. Switching to CLOSED.\n");
-		currentTCB->state = CLOSED;
 		return -1;
 	}
 }
@@ -248,11 +333,10 @@ int srt_client_connect(int sockfd, int nodeID, unsigned int server_port)
 
 // Send data to a srt server. This function should use the socket ID to find the TCP entry. 
 // Then It should create segBufs using the given data and append them to send buffer linked list. 
-// If the send buffer was empty before insertion, a thread called sendbuf_timer 
-// should be started to poll the send buffer every SENDBUF_POLLING_INTERVAL time
-// to check if a timeout event should occur. If the function completes successfully, 
-// it returns 1. Otherwise, it returns -1.
-// 
+// The retransmission timer of the connection's stream is armed once segments are
+// sent. If the function completes successfully, it returns 1. Otherwise, it returns -1.
+// If the socket is coalescing or corked, the data is first appended to the partial
+// segment at the tail of the send buffer if that segment hasn't been sent yet.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
@@ -260,7 +344,7 @@ int srt_client_send(int sockfd, void* data, unsigned int length)
 {
   
 	//find TCB entry
-	client_tcb_t *currentTCB = client_TCB_Table[sockfd];
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
 	if (currentTCB == NULL){
 		printf("Couldn't find the specified client TCB entry.\n");
 		return -1;
@@ -275,6 +359,9 @@ int srt_client_send(int sockfd, void* data, unsigned int length)
 		  return -1;
 
 		case CONNECTED:
+		  if (currentTCB->dgram != NULL) {
+		  	return dgram_send(currentTCB->dgram, currentTCB->svr_nodeID, currentTCB->svr_portNum, data, length);
+		  }
 		  printf("\nAdding segBufs to queue to send to %u.\n", currentTCB->svr_portNum);
 		  break;
 
@@ -287,127 +374,451 @@ int srt_client_send(int sockfd, void* data, unsigned int length)
 		  return -1;
 	}
 
-	//how many segments do we need?
-	char *dataToTransmit = (char *)data;
-	unsigned int dataLength = length;
-	unsigned int numOfSegments = dataLength / MAX_SEG_LEN;
-	unsigned int dataRemainder = dataLength % MAX_SEG_LEN;
-	if (dataRemainder > 0 ){
-		numOfSegments++;
+	return stream_send(&currentTCB->stream, data, length);
+}
+
+
+// Send length bytes of the file fd, starting at offset, to a srt server without reading the
+// file into memory. The file is mapped with mmap in chunks of SENDFILE_CHUNK bytes and its
+// segments are cut from the mapping: only their headers are queued in the send buffer, the
+// data is copied from the mapping when a segment is sent or retransmitted. A chunk is unmapped
+// once the server Acked all of it, and the function waits while SENDFILE_CHUNKS chunks are
+// unAcked, so a file of any size is sent with bounded memory. The file must not be truncated
+// while it is sent. Returns 1 once all data is queued, -1 if the socket isn't CONNECTED,
+// offset + length is past the end of the file, the file can't be mapped, the connection is
+// closed first or the server Acks no chunk for SENDFILE_TIMEOUT.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_sendfile(int sockfd, int fd, off_t offset, unsigned long length)
+{
+	//find TCB entry
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified client TCB entry.\n");
+		return -1;
 	}
-	if (numOfSegments <= 0) {
-		printf("No data to send. Returning to application.\n");
-		return 1;
+	if (currentTCB->state != CONNECTED || currentTCB->dgram != NULL) {
+		printf("Socket isn't CONNECTED or is SRT_DGRAM. Can't send file.\n");
+		return -1;
 	}
 
-	//create segBuf structs and append to sendBuffer
-	while (numOfSegments > 0) {
-
-		//create segBuf
-		segBuf_t *currentSegBuf = malloc(sizeof(segBuf_t));
-		memset(currentSegBuf, 0, sizeof(segBuf_t));
-		currentSegBuf->next = NULL;
-
-		//copy data and increment data pointer to next segment
-			//also update header.length
-		if (numOfSegments > 1) { //if it's a full segment...
-			memcpy(currentSegBuf->seg.data, dataToTransmit, MAX_SEG_LEN);
-			dataToTransmit += MAX_SEG_LEN;
-			currentSegBuf->seg.header.length = MAX_SEG_LEN;
-		} else { //if it's a partial segment..
-			memcpy(currentSegBuf->seg.data, dataToTransmit, dataRemainder);
-			//currentSegBuf->seg.data[dataRemainder] = '\0';
-			currentSegBuf->seg.header.length = dataRemainder;// + 1;
-		}
+	printf("\nSending %lu bytes of file to %u.\n", length, currentTCB->svr_portNum);
+	return stream_sendfile(&currentTCB->stream, fd, offset, length);
+}
 
-		//write header
-		currentSegBuf->seg.header.src_port = currentTCB->client_portNum;
-		currentSegBuf->seg.header.dest_port = currentTCB->svr_portNum;
-		currentSegBuf->seg.header.seq_num = currentTCB->next_seqNum;
-		currentTCB->next_seqNum += currentSegBuf->seg.header.length;
-		currentSegBuf->seg.header.type = DATA;
-
-		//add it to the appropriate space in the queue
-		pthread_mutex_lock(currentTCB->bufMutex);
-		if (currentTCB->sendBufHead == NULL) { //this is the first segment
-			currentTCB->sendBufHead = currentSegBuf;
-			currentTCB->sendBufTail = currentSegBuf;
-			currentTCB->sendBufunSent = currentSegBuf;
-
-			pthread_t sendBufTimeoutThread;
-		    if (pthread_create(&sendBufTimeoutThread, NULL, sendBuf_timer, currentTCB)){
-		    	printf("Error creating closeWaitTimer thread.\n");
-		    }
-		} else { //there's already stuff in the buffer
-			currentTCB->sendBufTail->next = currentSegBuf;
-			currentTCB->sendBufTail = currentSegBuf;
-			if (currentTCB->sendBufunSent == NULL) {
-				currentTCB->sendBufunSent = currentSegBuf;
-			}
-		}
 
-		//printf("Sending from srt_client_send.\n");
-		/* printing queue
-		currentSegBuf = currentTCB->sendBufHead;
-		while (currentSegBuf != NULL) {
-			printf("seq_num: %u, data: %s\n", currentSegBuf->seg.header.seq_num, currentSegBuf->seg.data);
-			currentSegBuf = currentSegBuf->next;
-		} */
-		pthread_mutex_unlock(currentTCB->bufMutex);
+// Receive data from the srt server. Connections are full duplex: the server sends with
+// srt_server_send and the client receives into the receive buffer of the TCB's stream.
+// Like srt_server_recv, this function waits until length bytes are available, then it
+// stores the data in buf and returns 1.
+// If the function fails, or the receive timeout expires first, return -1
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_recv(int sockfd, void* buf, unsigned int length)
+{
+	//find TCB entry
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified client TCB entry.\n");
+		return -1;
+	}
 
-		numOfSegments--;
+	return stream_recv(&currentTCB->stream, buf, length);
+}
+
+
+// Read data from the srt server as it arrives, like srt_server_read: returns up to length
+// bytes as soon as there is data, or with SRT_WAITALL all length bytes.
+// Returns the number of bytes read, or -1 if the socket doesn't exist or the receive
+// timeout expired first.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_read(int sockfd, void* buf, unsigned int length, int flags)
+{
+	//find TCB entry
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified client TCB entry.\n");
+		return -1;
 	}
 
-	//send segments until sent-but-not-Acked segments reaches GBN_WINDOW or segments are all sent
-	if (sendMaxSegments(currentTCB) < 0) {
-		printf("Error sending initial segments from srt_client_send.\n");
+	return stream_read(&currentTCB->stream, buf, length, flags);
+}
+
+
+// Receive a message from the server of a SRT_SEQPACKET socket, like srt_server_recvmsg: waits
+// until one whole srt_server_send of the server arrived and stores it in buf, cut to length bytes.
+// On a SRT_DGRAM socket it waits for a datagram of the server the same way.
+// Returns the number of bytes stored, 0 once the connection was closed and all messages were
+// read, or -1 if the socket doesn't exist or is SRT_STREAM, or the receive timeout expired first.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_recvmsg(int sockfd, void* buf, unsigned int length)
+{
+	//find TCB entry
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified client TCB entry.\n");
+		return -1;
 	}
+	if (currentTCB->dgram != NULL) {
+		return dgram_recv(currentTCB->dgram, buf, length, NULL, NULL, currentTCB->stream.recvTimeout);
+	}
+	if (!currentTCB->stream.seqpacket) {
+		printf("Socket isn't SRT_SEQPACKET. Can't receive a message.\n");
+		return -1;
+	}
+
+	return stream_recvmsg(&currentTCB->stream, buf, length);
+}
+
 
+// Turns the sequence numbers of the datagrams a SRT_DGRAM socket sends on or off, like
+// srt_server_setdgramseq. Returns 1 on success, -1 if the socket doesn't exist or isn't SRT_DGRAM.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_setdgramseq(int sockfd, int on)
+{
+	//find TCB entry
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified client TCB entry.\n");
+		return -1;
+	}
+	if (currentTCB->dgram == NULL) {
+		printf("Socket isn't SRT_DGRAM.\n");
+		return -1;
+	}
+
+	dgram_setnumbered(currentTCB->dgram, on);
 	return 1;
 }
 
- //sends unsent segments until GBN_WINDOW or end of queue and updates currentTCB->unAck_segNum
-	//returns 1 for success or -1 for failure
-int sendMaxSegments(client_tcb_t *currentTCB){
 
-	struct timespec ts;
-	pthread_mutex_lock(currentTCB->bufMutex);
-	segBuf_t *currentSegBuf = currentTCB->sendBufunSent;
-
-	//send segBufs
-	while (currentTCB->unAck_segNum <= GBN_WINDOW && currentSegBuf != NULL){
-		currentSegBuf->sentTime = current_utc_time_ns(&ts) / NS_TO_MICROSECONDS;
-		if (snp_sendseg(overlay_conn_fd, currentTCB->svr_nodeID, &currentSegBuf->seg) < 0) {
-			printf("Error sending seg_t with seq_num %u.\n", currentSegBuf->seg.header.seq_num);
-			return -1;
-		} else {
-			printf("Sent seq_num %u. Client: %u, Server: %u\n", currentSegBuf->seg.header.seq_num, 
-				currentSegBuf->seg.header.src_port, currentSegBuf->seg.header.dest_port);
-		}
-		currentTCB->unAck_segNum++;
-		currentSegBuf = currentSegBuf->next;
+// Copies the statistics of a SRT_DGRAM socket into stats, like srt_server_dgramstats.
+// Returns 1 on success, -1 if the socket doesn't exist or isn't SRT_DGRAM.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_dgramstats(int sockfd, srt_dgramstats_t* stats)
+{
+	//find TCB entry
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified client TCB entry.\n");
+		return -1;
+	}
+	if (currentTCB->dgram == NULL) {
+		printf("Socket isn't SRT_DGRAM.\n");
+		return -1;
 	}
 
-	if (currentSegBuf != NULL) {
-		currentTCB->sendBufunSent = currentSegBuf;
-	} else {
-		currentTCB->sendBufunSent = NULL;
+	dgram_getstats(currentTCB->dgram, stats);
+	return 1;
+}
+
+
+// Sets the delayed-ACK policy of the socket for the data received from the server, like
+// srt_server_setdelack. Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_setdelack(int sockfd, unsigned int ackEvery, unsigned int ackDelay_ms)
+{
+	//find TCB entry
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified client TCB entry.\n");
+		return -1;
 	}
 
-	pthread_mutex_unlock(currentTCB->bufMutex);
+	stream_setdelack(&currentTCB->stream, ackEvery, ackDelay_ms);
 	return 1;
 }
 
+//looks up the fast open cookie cached for the server node
+//returns 1 and stores the cookie in *cookie if there is one, otherwise 0
+int cookieCacheGet(int nodeID, unsigned int *cookie)
+{
+	fastopen_cookie_t *entry = &cookieCache[(unsigned int)nodeID % FASTOPEN_COOKIE_CACHE];
+	int found = 0;
+	pthread_mutex_lock(&cookieMutex);
+	if (entry->valid && entry->nodeID == nodeID) {
+		*cookie = entry->cookie;
+		found = 1;
+	}
+	pthread_mutex_unlock(&cookieMutex);
+	return found;
+}
 
+//caches the fast open cookie the server node handed out, replacing the entry in its slot
+void cookieCachePut(int nodeID, unsigned int cookie)
+{
+	fastopen_cookie_t *entry = &cookieCache[(unsigned int)nodeID % FASTOPEN_COOKIE_CACHE];
+	pthread_mutex_lock(&cookieMutex);
+	entry->nodeID = nodeID;
+	entry->cookie = cookie;
+	entry->valid = 1;
+	pthread_mutex_unlock(&cookieMutex);
+}
+
+//sends a FINACK to the server of currentTCB
+//returns 1 for success or -1 for failure
+int sendFinAck(client_tcb_t *currentTCB)
+{
+	//create FINACK seg_t
+	seg_t* finSegPtr = malloc(sizeof(seg_t));
+	MALLOC_CHECK(finSegPtr);
+	memset(finSegPtr, 0, sizeof(seg_t));
+	finSegPtr->header.src_port = currentTCB->client_portNum;
+	finSegPtr->header.dest_port = currentTCB->svr_portNum;
+	finSegPtr->header.type = FINACK;
+
+	//send FINACK seg_t
+	int ret = txsched_send(txSched, &currentTCB->txFlow, currentTCB->svr_nodeID, finSegPtr);
+	free(finSegPtr);
+	return (ret < 0) ? -1 : 1;
+}
+
+
+// Turns small-write coalescing on or off for the socket. In coalescing mode, while
+// sent data is unAcked, srt_client_send appends small writes to the partial segment at
+// the tail of the send buffer instead of sending a segment per write. The partial segment
+// is sent when it fills up, when all outstanding data is Acked, on srt_client_flush or
+// after it has been held for flushTimeout_ms milliseconds (COALESCE_FLUSH_TIMEOUT if 0).
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_setcoalesce(int sockfd, int on, unsigned int flushTimeout_ms)
+{
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified client TCB entry.\n");
+		return -1;
+	}
+
+	if (stream_setcoalesce(&currentTCB->stream, on, flushTimeout_ms) < 0) {
+		printf("Error sending segments from srt_client_setcoalesce.\n");
+		return -1;
+	}
+	return 1;
+}
+
+
+// Corks the socket: partial segments are held back even when nothing is outstanding, so
+// the following writes are merged into full segments. Full segments are still sent. A
+// corked partial segment is sent after the socket's flush timeout at the latest.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_cork(int sockfd)
+{
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified client TCB entry.\n");
+		return -1;
+	}
+
+	return stream_cork(&currentTCB->stream, 1);
+}
+
+
+// Uncorks the socket and sends the data held back while it was corked.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_uncork(int sockfd)
+{
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified client TCB entry.\n");
+		return -1;
+	}
+
+	if (stream_cork(&currentTCB->stream, 0) < 0) {
+		printf("Error sending segments from srt_client_uncork.\n");
+		return -1;
+	}
+	return 1;
+}
+
+
+// Sends any partial segment held back by coalescing or corking and blocks until all data
+// written to the socket so far is Acked by the server, at most for the socket's linger time
+// (LINGER_TIMEOUT if linger is off). Data written after the call may be held back again.
+// Returns 1 once everything is Acked, -1 on timeout or if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_flush(int sockfd)
+{
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified client TCB entry.\n");
+		return -1;
+	}
+
+	unsigned long timeout = currentTCB->stream.linger ? currentTCB->stream.linger : LINGER_TIMEOUT;
+	if (stream_drain(&currentTCB->stream, timeout) < 0) {
+		printf("Timed out waiting for the server to Ack all data.\n");
+		return -1;
+	}
+	return 1;
+}
+
+
+// Sets how long srt_client_recv and srt_client_read wait for data from the server:
+// timeout_ms milliseconds, or forever if 0, which is the default.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_setrecvtimeout(int sockfd, unsigned int timeout_ms)
+{
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified client TCB entry.\n");
+		return -1;
+	}
+
+	stream_setrecvtimeout(&currentTCB->stream, timeout_ms);
+	return 1;
+}
+
+
+// Sets the linger option of the socket. With linger on, srt_client_disconnect first waits
+// until all data in the send buffer is Acked, at most linger_ms milliseconds (LINGER_TIMEOUT
+// if 0), and then sends the FIN. With linger off, unAcked data is dropped at once.
+// Linger is on by default. Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_setlinger(int sockfd, int on, unsigned int linger_ms)
+{
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified client TCB entry.\n");
+		return -1;
+	}
+
+	stream_setlinger(&currentTCB->stream, on, linger_ms);
+	return 1;
+}
+
+
+// Turns the pacer on or off for the socket. With pacing on, new segments and
+// retransmissions don't put the whole window on the SNP connection back-to-back but
+// release bursts of burst segments (PACING_BURST if 0) spaced at rate bytes per second.
+// If rate is 0, the rate follows the connection: GBN_WINDOW segments per smoothed RTT,
+// times PACING_GAIN_PERCENT; until the first RTT is measured nothing is paced.
+// Pacing is on by default. Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_setpacing(int sockfd, int on, unsigned int rate, unsigned int burst)
+{
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified client TCB entry.\n");
+		return -1;
+	}
+
+	//segments waiting for a pacing slot go out under the new setting
+	if (stream_setpacing(&currentTCB->stream, on, rate, burst) < 0) {
+		printf("Error sending segments from srt_client_setpacing.\n");
+		return -1;
+	}
+	return 1;
+}
+
+
+// Sets the transmit scheduling of the socket. The sockets of a process share the overlay
+// connection: sockets of a lower priority number are served first, and sockets of the same
+// priority share it in proportion to their weight. priority is at most TXSCHED_PRIORITIES - 1,
+// weight 0 is taken as 1. New sockets have weight 1 and TXSCHED_DEFAULT_PRIORITY.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_setsched(int sockfd, unsigned int weight, unsigned int priority)
+{
+	//find TCB entry
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified client TCB entry.\n");
+		return -1;
+	}
+
+	txsched_setflow(txSched, &currentTCB->txFlow, weight, priority);
+	return 1;
+}
+
+
+// Turns forward error correction on or off for the next connection of the socket. With it on,
+// the SYN asks the server for it, and if the server agrees, both ends send a DATAFEC parity
+// segment of their data every few segments, more often the more segments are retransmitted.
+// When one segment of the data a parity segment covers is lost, the receiver rebuilds it
+// without waiting for the retransmission. It is off by default.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_setfec(int sockfd, int on)
+{
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified client TCB entry.\n");
+		return -1;
+	}
+
+	stream_setfec(&currentTCB->stream, on);
+	return 1;
+}
+
+
+// Sets the number of overlay paths, at most MULTIPATH_MAX_PATHS, the segments the socket sends are
+// striped over. Each segment carries a path hint to SNP: path 0 is the routing table's route, the
+// others start at the neighbors whose own route to the destination doesn't lead back through this
+// node. New segments are spread over the paths in inverse proportion to the RTT measured on each,
+// raised by the share of segments lost on it, and a retransmission goes out on another path than
+// the one it was lost on. The receiver puts the segments back in order. 1, the default, sends all
+// segments on the routing table's route. Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_setmultipath(int sockfd, unsigned int paths)
+{
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified client TCB entry.\n");
+		return -1;
+	}
+
+	stream_setmultipath(&currentTCB->stream, paths);
+	return 1;
+}
 
 
 // This function is used to disconnect from the server. It takes the socket ID as 
-// an input parameter. The socket ID is used to find the TCB entry in the TCB table.  
+// an input parameter. The socket ID is used to find the TCB entry in the connection table.  
+// If the socket lingers, it first waits until the server Acked all data sent.
 // This function sends a FIN segment to the server. After the FIN segment is sent
 // the state should transition to FINWAIT and a timer started. If the 
 // state == CLOSED after the timeout the FINACK was successfully received. Else,
 // if after a number of retries FIN_MAX_RETRY the state is still FINWAIT then
 // the state transitions to CLOSED and -1 is returned.
+// The server holds the FINACK back until the client Acked the data the server sent before
+// the FIN, so the data of the server is still received in FINWAIT and can be read after
+// disconnecting. Retries only count while none of it arrives, so data that doesn't fit in the
+// receive buffer must be read by another thread meanwhile, or disconnecting fails.
 
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -415,7 +826,7 @@ int sendMaxSegments(client_tcb_t *currentTCB){
 int srt_client_disconnect(int sockfd)
 {
   	//find TCB entry
-	client_tcb_t *currentTCB = client_TCB_Table[sockfd];
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
 	if (currentTCB == NULL){
 		printf("Couldn't find the specified client TCB entry.\n");
 		return -1;
@@ -431,42 +842,21 @@ int srt_client_disconnect(int sockfd)
 		  return -1;
 
 		case CONNECTED:
+		    //a datagram socket has no connection to finish
+		    if (currentTCB->dgram != NULL) {
+		    	printf("Datagram socket. Changing state to CLOSED.\n");
+		    	dgram_stop(currentTCB->dgram);
+		    	currentTCB->state = CLOSED;
+		    	return 1;
+		    }
 		    printf("Trying to disconnect.\n");
 
-		    //clear send buffer
-		    //printf("Clearing sendBuf.\n");
-		    pthread_mutex_lock(currentTCB->bufMutex);
-
-		    /*
-		    segBuf_t *currentSegBuf = currentTCB->sendBufHead;
-		    segBuf_t *tempSegBuf;
-
-		    //send everything again
-		    while (currentSegBuf != NULL){
-		    	struct timespec ts;
-				currentSegBuf->sentTime = current_utc_time_ns(&ts) / NS_TO_MICROSECONDS;
-				if (snp_sendseg(overlay_conn_fd, currentTCB->svr_nodeID, &currentSegBuf->seg) < 0) {
-					printf("Error sending seg_t with seq_num %u.\n", currentSegBuf->seg.header.seq_num);
-					return -1;
-				} else {
-					printf("Sent seg_t with seq_num %u.\n", currentSegBuf->seg.header.seq_num);
-				}
-				currentSegBuf = currentSegBuf->next;
-			}
-			*/
-
-			//free all of the segbufs
-			segBuf_t *currentSegBuf = currentTCB->sendBufHead;
-			segBuf_t *tempSegBuf;
-		    while (currentSegBuf != NULL) {
-		    	tempSegBuf = currentSegBuf;
-		    	currentSegBuf = currentSegBuf->next;
-		    	free(tempSegBuf);
+		    //wait for the server to Ack the data still in flight, then clear send buffer
+		    if (currentTCB->stream.linger > 0 && stream_drain(&currentTCB->stream, currentTCB->stream.linger) < 0) {
+		    	printf("Linger timed out. Dropping unAcked data.\n");
 		    }
-		    currentTCB->sendBufHead = NULL;
-		    currentTCB->sendBufTail = NULL;
-		    currentTCB->sendBufunSent = NULL;
-		    pthread_mutex_unlock(currentTCB->bufMutex);
+		    //the data of the server is still received until the FINACK
+		    stream_stopsend(&currentTCB->stream);
 
 		  	//create FIN seg_t
 			seg_t* finSegPtr = malloc(sizeof(seg_t));
@@ -476,47 +866,53 @@ int srt_client_disconnect(int sockfd)
 			finSegPtr->header.dest_port = currentTCB->svr_portNum;
 			finSegPtr->header.type = FIN;
 
+			pthread_mutex_lock(currentTCB->bufMutex);
 			currentTCB->state = FINWAIT;
 			//send FIN seg_t
-			if (snp_sendseg(overlay_conn_fd, currentTCB->svr_nodeID, finSegPtr) < 0) {
+			if (txsched_send(txSched, &currentTCB->txFlow, currentTCB->svr_nodeID, finSegPtr) < 0) {
 				printf("Error sending FIN seg_t to %u.\n", finSegPtr->header.dest_port);
+				currentTCB->state = CLOSED;
+				pthread_mutex_unlock(currentTCB->bufMutex);
+				free(finSegPtr);
 				return -1;
 			}
 
-
-			//start timer
-			struct timespec ts;
-			unsigned long  tstart, tend;
-			tstart = current_utc_time_ns(&ts);
+			//wait for the FINACK, seghandler changes the state to CLOSED and signals stateCond.
+			//The FIN is resent every FIN_TIMEOUT, at most FIN_MAX_RETRY times in a row without
+			//data of the server arriving: the server Acks the FIN once its data is delivered
+			unsigned long deadline = timer_now_ns() + FIN_TIMEOUT;
+			unsigned int received = currentTCB->stream.expect_seqNum;
 			int tries = 0;
-
-			//keep trying until receive FINACK (seghandler changes currentTCB.state to CLOSED) or max out tries
-			while (tries < FIN_MAX_RETRY && currentTCB->state == FINWAIT) {
-				//calc time elapsed
-				tend = current_utc_time_ns(&ts);
-
-				//if timeout, resend FIN
-				if (tend - tstart> FIN_TIMEOUT) {
-					tstart = current_utc_time_ns(&ts);
-					//resend FIN and increment tries
-					printf("Resending FIN to %u.\n", finSegPtr->header.dest_port);
-					if (snp_sendseg(overlay_conn_fd, currentTCB->svr_nodeID, finSegPtr) < 0) {
-						printf("Error sending FIN seg_t to %u.\n", finSegPtr->header.dest_port);
-						return -1;
-					}
-					tries++;
+			while (currentTCB->state == FINWAIT) {
+				if (timer_condwait(&currentTCB->stateCond, currentTCB->bufMutex, deadline) != ETIMEDOUT
+					|| currentTCB->state != FINWAIT) {
+					continue;
 				}
+				if (tries == FIN_MAX_RETRY) {
+					break;
+				}
+				//resend FIN and increment tries
+				printf("Resending FIN to %u.\n", finSegPtr->header.dest_port);
+				if (txsched_send(txSched, &currentTCB->txFlow, currentTCB->svr_nodeID, finSegPtr) < 0) {
+					printf("Error sending FIN seg_t to %u.\n", finSegPtr->header.dest_port);
+					break;
+				}
+				tries = (currentTCB->stream.expect_seqNum == received) ? tries + 1 : 0;
+				received = currentTCB->stream.expect_seqNum;
+				deadline = timer_now_ns() + FIN_TIMEOUT;
 			}
+			int closed = (currentTCB->state == CLOSED);
+			currentTCB->state = CLOSED;
+			pthread_mutex_unlock(currentTCB->bufMutex);
+			free(finSegPtr);
+			stream_stop(&currentTCB->stream);
 
 			//if FINACK is received, seghandler will change state to CLOSED
-			if (currentTCB->state == CLOSED) {
+			if (closed) {
 				printf("Successful disconnection!\n");
-				free(finSegPtr);
 				return 1;
 			} else {
 				printf("Couldn't disconnect - maxed out tries. Switching to CLOSED.\n");
-				currentTCB->state = CLOSED;
-				free(finSegPtr);
 				return -1;
 			}
 
@@ -540,7 +936,7 @@ int srt_client_disconnect(int sockfd)
 int srt_client_close(int sockfd)
 {
   //find TCB entry
-	client_tcb_t *currentTCB = client_TCB_Table[sockfd];
+	client_tcb_t *currentTCB = conntable_get(&clientConnTable, sockfd);
 	if (currentTCB == NULL){
 		printf("Couldn't find the specified client TCB entry.\n");
 		return -1;
@@ -549,10 +945,19 @@ int srt_client_close(int sockfd)
 	switch(currentTCB->state) {
 		case CLOSED:
 		  printf("Trying to close.\n");
-		  pthread_mutex_destroy(client_TCB_Table[sockfd]->bufMutex);
-		  free(client_TCB_Table[sockfd]->bufMutex);
-		  free(client_TCB_Table[sockfd]);
-		  client_TCB_Table[sockfd] = NULL;
+		  conntable_free(&clientConnTable, sockfd);
+		  //segments still queued, like the FINACK of the server's FIN, are sent before the flow is closed
+		  if (txsched_flowflush(txSched, &currentTCB->txFlow, FIN_TIMEOUT) < 0) {
+		  	printf("Dropping the segments still queued.\n");
+		  }
+		  stream_destroy(&currentTCB->stream);
+		  if (currentTCB->dgram != NULL) {
+		  	dgram_destroy(currentTCB->dgram);
+		  }
+		  pthread_cond_destroy(&currentTCB->stateCond);
+		  pthread_mutex_destroy(currentTCB->bufMutex);
+		  free(currentTCB->bufMutex);
+		  free(currentTCB);
 		  printf("Successfully closed!\n");
 		  return 1;
 
@@ -575,199 +980,109 @@ int srt_client_close(int sockfd)
 }
 
 
-// This is a thread  started by srt_client_init(). It handles all the incoming 
-// segments from the server. The design of seghanlder is an infinite loop that calls snp_recvseg(). If
-// snp_recvseg() fails then the overlay connection is closed and the thread is terminated. Depending
+// This function handles an incoming segment from the server. It is called by the worker threads
+// of the dispatcher started by srt_client_init(), which receives the segments with snp_recvseg() and
+// hands all segments of a connection to the same worker, in order. If snp_recvseg() fails
+// then the overlay connection is closed and the threads are terminated. Depending
 // on the state of the connection when a segment is received  (based on the incoming segment) various
-// actions are taken. See the client FSM for more details.
+// actions are taken. See the client FSM for more details. A FIN of the server, sent when it closes
+// an idle connection, switches a CONNECTED or FINWAIT connection to CLOSED and is Acked.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
-void *seghandler(void* arg)
+void seghandler(seg_t* segPtr, int src_nodeID)
 {
-  	seg_t *segPtr = malloc(sizeof(seg_t));
-	MALLOC_CHECK(segPtr);
-	memset(segPtr, 0, sizeof(seg_t));
-
-	char *segTypeStrings[] = {"SYN", "SYNACK", "FIN", "FINACK", "DATA", "DATAACK"};
+	char *segTypeStrings[] = {"SYN", "SYNACK", "FIN", "FINACK", "DATA", "DATAACK", "DATAFEC", "DGRAM"};
 	char *states[] = {"Unknown", "CLOSED", "SYNSENT", "CONNECTED", "FINWAIT"};
-	int src_nodeID;
-
-	while (snp_recvseg(overlay_conn_fd, &src_nodeID, segPtr) > 0) {
 
-		if(!segPtr) {
-			printf("segPtr is NULL.\n");
-			break;
+	//get the client_tcb_t of the connection. The reference taken on it keeps srt_client_close
+	//from freeing it until the segment is handled
+	int sockfd;
+	client_tcb_t *currentTCB = conntable_lookup(&clientConnTable, segPtr->header.dest_port, src_nodeID, segPtr->header.src_port, &sockfd);
+
+	if (currentTCB != NULL){
+		printf("\nReceived %s in state %s. client: %u, server: %u.\n", 
+			segTypeStrings[segPtr->header.type], states[currentTCB->state], segPtr->header.dest_port, segPtr->header.src_port);
+		switch(currentTCB->state) {
+			case CLOSED:
+			  //printf("State is CLOSED.\n");
+			  printf("Doing nothing.\n");
+			  break;
+
+			case SYNSENT:
+			  //printf("State is SYNSENT.\n");
+			  if (segPtr->header.type == SYNACK && currentTCB->svr_portNum == segPtr->header.src_port && currentTCB->svr_nodeID==src_nodeID){
+			  	srt_synopt_t synOpt;
+			  	seg_getsynopt(segPtr, &synOpt);
+			  	pthread_mutex_lock(currentTCB->bufMutex);
+			  	stream_open(&currentTCB->stream, currentTCB->client_portNum, src_nodeID, segPtr->header.src_port,
+			  		segPtr->header.seq_num, min(MAX_SEG_LEN, synOpt.mss));
+			  	currentTCB->stream.timestamps = (synOpt.flags & SYNOPT_TIMESTAMP) ? 1 : 0;
+			  	if (synOpt.flags & SYNOPT_FEC) {
+			  		stream_startfec(&currentTCB->stream);
+			  	}
+			  	if (synOpt.flags & SYNOPT_COOKIE) {
+			  		cookieCachePut(currentTCB->svr_nodeID, synOpt.cookie);
+			  	}
+			  	currentTCB->synDataAcked = (synOpt.flags & SYNOPT_DATA) ? 1 : 0;
+			  	printf("Changing state to CONNECTED. MSS is %u.\n", currentTCB->stream.mss);
+			  	currentTCB->state = CONNECTED;
+			  	pthread_cond_signal(&currentTCB->stateCond);
+			  	pthread_mutex_unlock(currentTCB->bufMutex);
+			  } else {
+			  	printf("Doing nothing.\n");
+			  }
+			  break;
+
+			case CONNECTED:
+			  //printf("State is CONNECTED.\n");
+			  if ((segPtr->header.type == DATA || segPtr->header.type == DATAACK || segPtr->header.type == DATAFEC) && currentTCB->svr_portNum == segPtr->header.src_port && currentTCB->svr_nodeID==src_nodeID){
+			  	//the server's data and its ACKs of ours
+			  	stream_input(&currentTCB->stream, segPtr);
+			  } else if (segPtr->header.type == DGRAM && currentTCB->dgram != NULL && currentTCB->svr_portNum == segPtr->header.src_port && currentTCB->svr_nodeID==src_nodeID) {
+			  	dgram_input(currentTCB->dgram, segPtr, src_nodeID);
+			  } else if (segPtr->header.type == FIN && currentTCB->svr_portNum == segPtr->header.src_port && currentTCB->svr_nodeID==src_nodeID) {
+			  	//the server closed the idle connection
+			  	printf("Server closed the connection. Changing state to CLOSED.\n");
+			  	pthread_mutex_lock(currentTCB->bufMutex);
+			  	currentTCB->state = CLOSED;
+			  	pthread_cond_signal(&currentTCB->stateCond);
+			  	pthread_mutex_unlock(currentTCB->bufMutex);
+			  	stream_stop(&currentTCB->stream);
+			  	if (sendFinAck(currentTCB) < 0) {
+			  		printf("Error sending FINACK seg_t.\n");
+			  	}
+			  } else {
+			  	printf("Doing nothing.\n");
+			  }
+			  break;
+
+			case FINWAIT:
+			  //printf("State is FINWAIT.\n");
+			  if ((segPtr->header.type == FINACK || segPtr->header.type == FIN) && currentTCB->svr_portNum == segPtr->header.src_port && currentTCB->svr_nodeID==src_nodeID){
+			  	//the FINACK, or the FIN of the server closing the idle connection meanwhile
+			  	printf("Changing state to CLOSED.\n");
+			  	pthread_mutex_lock(currentTCB->bufMutex);
+			  	currentTCB->state = CLOSED;
+			  	pthread_cond_signal(&currentTCB->stateCond);
+			  	pthread_mutex_unlock(currentTCB->bufMutex);
+			  	if (segPtr->header.type == FIN && sendFinAck(currentTCB) < 0) {
+			  		printf("Error sending FINACK seg_t.\n");
+			  	}
+			  } else if ((segPtr->header.type == DATA || segPtr->header.type == DATAACK || segPtr->header.type == DATAFEC) && currentTCB->svr_portNum == segPtr->header.src_port && currentTCB->svr_nodeID==src_nodeID){
+			  	//the server sends the rest of its data before it Acks our FIN
+			  	stream_input(&currentTCB->stream, segPtr);
+			  } else {
+			  	printf("Doing nothing.\n");
+			  }
+			  break;
+
+			default:
+			  printf("Unknown state.\n");
+			  break;
 		}
-		
-
-		//get the right client_tcb_t index
-		unsigned int destPort = segPtr->header.dest_port;
-		int idx = 0;
-		while (idx < MAX_TRANSPORT_CONNECTIONS) {
-			if (client_TCB_Table[idx] != NULL) {
-				if (client_TCB_Table[idx]->client_portNum == destPort){
-					break;
-				}
-			}
-			idx++;
-		}
-
-		if (idx < MAX_TRANSPORT_CONNECTIONS){
-			client_tcb_t *currentTCB = client_TCB_Table[idx];
-			//printf("Sockfd is %d, and port is %u.\n", idx, segPtr->header.dest_port);
-			printf("\nReceived %s in state %s. client: %u, server: %u.\n", 
-				segTypeStrings[segPtr->header.type], states[currentTCB->state], segPtr->header.dest_port, segPtr->header.src_port);
-			switch(currentTCB->state) {
-				case CLOSED:
-				  //printf("State is CLOSED.\n");
-				  printf("Doing nothing.\n");
-				  break;
-
-				case SYNSENT:
-				  //printf("State is SYNSENT.\n");
-				  if (segPtr->header.type == SYNACK && currentTCB->svr_portNum == segPtr->header.src_port && currentTCB->svr_nodeID==src_nodeID){
-				  	printf("Changing state to CONNECTED.\n");
-				  	currentTCB->state = CONNECTED;
-				  } else {
-				  	printf("Doing nothing.\n");
-				  }
-				  break;
-
-				case CONNECTED:
-				  //printf("State is CONNECTED.\n");
-				  if (segPtr->header.type == DATAACK && currentTCB->svr_portNum == segPtr->header.src_port && currentTCB->svr_nodeID==src_nodeID){
-				  	printf("Server expects seq_num %u.\n", segPtr->header.seq_num);
-				  	pthread_mutex_lock(currentTCB->bufMutex);
-				  	segBuf_t *tempSegBuf;
-
-				  	//free acked segBufs from send buffer
-				  	while (currentTCB->sendBufHead != NULL && currentTCB->sendBufHead->seg.header.seq_num < segPtr->header.seq_num) {
-				  		tempSegBuf = currentTCB->sendBufHead;
-				    	currentTCB->sendBufHead = currentTCB->sendBufHead->next;
-				    	free(tempSegBuf);
-				    	printf("Freed seq_num %u\n", tempSegBuf->seg.header.seq_num);
-				    	currentTCB->unAck_segNum--;
-				  	}
-
-				  	//send if there are unsent segments
-				  	if (currentTCB->sendBufunSent != NULL) {
-					  	printf("Sending post-DATAACK unsent: %u\n", currentTCB->sendBufunSent->seg.header.seq_num);
-					  	pthread_mutex_unlock(currentTCB->bufMutex);
-					  	if (sendMaxSegments(currentTCB) < 0) {
-							printf("Error sending segments from seghandler.\n");
-						}
-					} else {
-						printf("Nothing unsent for client: %u server: %u.\n", segPtr->header.dest_port, segPtr->header.src_port);
-						pthread_mutex_unlock(currentTCB->bufMutex);
-					}
-
-				  	/*
-				  	while (currentTCB->unAck_segNum < GBN_WINDOW && currentTCB->sendBufunSent != NULL){
-				  		struct timespec ts;
-				  		currentTCB->sendBufunSent->sentTime = current_utc_time_ns(&ts) / NS_TO_MICROSECONDS;
-						if (snp_sendseg(overlay_conn_fd, currentTCB->svr_nodeID, &currentTCB->sendBufunSent->seg) < 0) {
-							printf("Error sending seg_t with seq_num %u from seghandler.\n", currentTCB->sendBufunSent->seg.header.seq_num);
-						} else {
-							printf("Sent seg_t with seq_num %u from seghandler.\n", currentTCB->sendBufunSent->seg.header.seq_num);
-						}
-						currentTCB->unAck_segNum++;
-						currentTCB->sendBufunSent = currentTCB->sendBufunSent->next;
-				  	}
-				  	*/
-
-				  	
-				  } else {
-				  	printf("Doing nothing.\n");
-				  }
-				  break;
-
-				case FINWAIT:
-				  //printf("State is FINWAIT.\n");
-				  if (segPtr->header.type == FINACK  && currentTCB->svr_portNum == segPtr->header.src_port && currentTCB->svr_nodeID==src_nodeID){
-				  	printf("Changing state to CLOSED.\n");
-				  	currentTCB->state = CLOSED;
-				  } else {
-				  	printf("Doing nothing.\n");
-				  }
-				  break;
-
-				default:
-				  printf("Unknown state.\n");
-				  break;
-			}
-		} else {
-			printf("Couldn't find the client_tcb the server was trying to reach.\n");
-		}
-
-		memset(segPtr, 0, sizeof(seg_t));
-	
+		conntable_put(&clientConnTable, sockfd);
+	} else {
+		printf("Couldn't find the client_tcb the server was trying to reach.\n");
 	}
-
-	printf("seghandler is closing the overlay connection.\n");
-	//free(client_TCB_Table);
-	free(segPtr);
-	close(overlay_conn_fd);
-	pthread_exit(NULL);
 }
 
-
-
-// This thread continuously polls send buffer to trigger timeout events
-// It should always be running when the send buffer is not empty
-// If the current time -  first sent-but-unAcked segment's sent time > DATA_TIMEOUT, a timeout event occurs
-// When timeout, resend all sent-but-unAcked segments
-// When the send buffer is empty, this thread terminates
-//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
-void* sendBuf_timer(void* arg)
-{
-  	client_tcb_t *currentTCB = (client_tcb_t *)arg;
-	struct timespec ts;
-	unsigned int currentTime;
-
-	//nanosleep for a bit first
-	struct timespec req, rm;
-	req.tv_sec = 0;
-	req.tv_nsec = BUFTIMER_INIT_SLEEP;
-	nanosleep(&req,&rm);
-
-	while (currentTCB->sendBufHead != NULL) {
-		currentTime = current_utc_time_ns(&ts) / NS_TO_MICROSECONDS;
-		if (currentTime < currentTCB->sendBufHead->sentTime || 
-			(currentTime - currentTCB->sendBufHead->sentTime) > DATA_TIMEOUT){
-
-			//send sent-but-unAcked segments again
-			pthread_mutex_lock(currentTCB->bufMutex);
-			printf("Buftimer timed out!\n");
-			int sentSegments = 0;
-			segBuf_t *currentSegBuf = currentTCB->sendBufHead;
-			while (sentSegments <= currentTCB->unAck_segNum && currentSegBuf != NULL) {
-
-				currentSegBuf->sentTime = current_utc_time_ns(&ts) / NS_TO_MICROSECONDS;
-				if (snp_sendseg(overlay_conn_fd, currentTCB->svr_nodeID, &currentSegBuf->seg) < 0) {
-					printf("Error sending seg_t with seq_num %u.\n", currentSegBuf->seg.header.seq_num);
-				} else {
-					printf("Buftimer sent seq_num %u. Client: %u, Server: %u\n", currentSegBuf->seg.header.seq_num, 
-				currentSegBuf->seg.header.src_port, currentSegBuf->seg.header.dest_port);
-				}
-				sentSegments++;
-				currentSegBuf = currentSegBuf->next;
-			}
-
-			if (currentSegBuf != NULL) {
-				currentTCB->sendBufunSent = currentSegBuf;
-			} else {
-				currentTCB->sendBufunSent = NULL;
-			}
-			pthread_mutex_unlock(currentTCB->bufMutex);
-		} else {
-			printf("Not timed out yet. seq_num %u with (current - sentTime) = %lu.\n", 
-				currentTCB->sendBufHead->seg.header.seq_num, currentTime - currentTCB->sendBufHead->sentTime);
-		}
-		req.tv_sec = 0;
-		req.tv_nsec = SENDBUF_POLLING_INTERVAL / 2;
-		nanosleep(&req,&rm);
-	}
-	printf("Exiting sendBufTimer for client: %u, server: %u. sendBufHead == NULL: %s\n.", currentTCB->client_portNum, currentTCB->svr_portNum, (currentTCB->sendBufHead == NULL) ? "TRUE" : "FALSE" );
-	return NULL;
-	pthread_exit(NULL);
-}
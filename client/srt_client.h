@@ -15,6 +15,12 @@
 
 #include <pthread.h>
 #include "../common/seg.h"
+#include "../common/timer.h"
+#include "../common/conntable.h"
+#include "../common/dispatch.h"
+#include "../common/txsched.h"
+#include "../common/stream.h"
+#include "../common/dgram.h"
 
 //client states used in FSM
 #define	CLOSED 1
@@ -22,12 +28,12 @@
 #define	CONNECTED 3
 #define	FINWAIT 4
 
-//unit to store segments in send buffer linked list.
-typedef struct segBuf {
-        seg_t seg;
-        unsigned long sentTime;
-        struct segBuf* next;
-} segBuf_t;
+//fast open cookie a server handed out in a SYNACK, cached for later connections to it
+typedef struct fastopen_cookie {
+	int nodeID;             //node ID of the server
+	unsigned int cookie;    //cookie to send in the SYN
+	int valid;              //1 if the entry holds a cookie
+} fastopen_cookie_t;
 
 
 //client transport control block. the client side of a SRT connection uses this data structure to keep track of the connection information.   
@@ -36,13 +42,14 @@ typedef struct client_tcb {
 	unsigned int svr_portNum;       	//port number of server
 	unsigned int client_nodeID;     //node ID of client, similar as IP address, currently unused
 	unsigned int client_portNum;    	//port number of client
-	unsigned int state;     			//state of client
-	unsigned int next_seqNum;       	//next sequence number to be used by new segment 
-	pthread_mutex_t* bufMutex;      	//send buffer mutex
-	segBuf_t* sendBufHead;          	//head of send buffer
-	segBuf_t* sendBufunSent;        	//first unsent segment in send buffer
-	segBuf_t* sendBufTail;          	//tail of send buffer
-	unsigned int unAck_segNum;      	//number of sent-but-not-Acked segments
+	atomic_uint state;     			//state of client, changed by seghandler with bufMutex held
+	int sockfd;                     	//socket descriptor of the TCB in the connection table
+	pthread_mutex_t* bufMutex;      	//mutex of the send and receive buffers
+	pthread_cond_t stateCond;       	//signaled by seghandler when the SYNACK, FINACK or a FIN of the server changes the state
+	txsched_flow_t txFlow;          	//queue of the segments waiting for the transmit scheduler
+	stream_t stream;                	//data transfer in both directions, set up when the SYNACK arrives
+	int synDataAcked;               	//1 if the SYNACK acknowledged fast open data sent in the SYN
+	dgram_t* dgram;                 	//datagram state of a SRT_DGRAM socket, NULL for the other types
 } client_tcb_t;
 
 
@@ -52,16 +59,16 @@ typedef struct client_tcb {
 
 
 
- //sends segments until GBN_WINDOW or end of queue
-	//returns 1 for success or -1 for failure
-int sendMaxSegments(client_tcb_t *currentTCB);
+//looks up the fast open cookie cached for the server node
+//returns 1 and stores the cookie in *cookie if there is one, otherwise 0
+int cookieCacheGet(int nodeID, unsigned int *cookie);
 
+//caches the fast open cookie the server node handed out, replacing the entry in its slot
+void cookieCachePut(int nodeID, unsigned int cookie);
 
-//thread that is always running when send buffer is not empty
-	//polls first sent-but-not-Acked segment (head)
-	//if currentTime - sentTime > DATA_TIMEOUT, calls sendMaxSegments
-void *sendBufTimer(void* arg);
-
+//sends a FINACK to the server of currentTCB
+//returns 1 for success or -1 for failure
+int sendFinAck(client_tcb_t *currentTCB);
 
 
 
@@ -86,23 +93,41 @@ void *sendBufTimer(void* arg);
 
 void srt_client_init(int conn);
 
-// This function initializes the TCB table marking all entries NULL. It also initializes 
+// This function initializes the connection table of the TCBs. It also initializes 
 // a global variable for the overlay TCP socket descriptor ``conn'' used as input parameter
-// for snp_sendseg and snp_recvseg. Finally, the function starts the seghandler thread to 
-// handle the incoming segments. There is only one seghandler for the client side which
-// handles call connections for the client.
+// for snp_sendseg and snp_recvseg, and starts the transmit scheduler that sends the
+// segments of all sockets on it. Finally, the function starts the dispatcher 
+// thread and its pool of worker threads, which run seghandler for the incoming segments
+// of all connections, each connection on one worker.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
 
 int srt_client_sock(unsigned int client_port);
 
-// This function looks up the client TCB table to find the first NULL entry, and creates
-// a new TCB entry using malloc() for that entry. All fields in the TCB are initialized 
+// This function creates a new TCB entry using malloc() and stores it in the client connection
+// table, which hands out a free socket descriptor for it. All fields in the TCB are initialized 
 // e.g., TCB state is set to CLOSED and the client port set to the function call parameter 
-// client port.  The TCB table entry index should be returned as the new socket ID to the client 
-// and be used to identify the connection on the client side. If no entry in the TC table  
-// is available the function returns -1.
+// client port.  The socket descriptor should be returned as the new socket ID to the client 
+// and be used to identify the connection on the client side. If MAX_TRANSPORT_CONNECTIONS  
+// sockets are in use the function returns -1.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_client_socktype(unsigned int client_port, int type);
+
+// Creates a socket like srt_client_sock, of the given type: SRT_STREAM, the type of
+// srt_client_sock, carries a byte stream, SRT_SEQPACKET carries messages. On a SRT_SEQPACKET
+// socket each srt_client_send is one message, however many segments it takes, and the server
+// receives it whole with one srt_server_recvmsg; srt_client_recvmsg does the same for the
+// messages of the server. It only connects to a server socket that is SRT_SEQPACKET too.
+// Forward error correction isn't used on SRT_SEQPACKET connections.
+// On a SRT_DGRAM socket, srt_client_connect only sets the server port the datagrams go to and
+// come from, without a handshake, each srt_client_send is one datagram of at most MAX_SEG_LEN
+// bytes, and srt_client_recvmsg receives the datagrams of the server. Datagrams aren't Acked or
+// retransmitted, see srt_server_sendto. Returns the socket descriptor, or -1 if the type is
+// unknown or MAX_TRANSPORT_CONNECTIONS sockets are in use.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
@@ -116,6 +141,21 @@ int srt_client_connect(int socked, int nodeID, unsigned int server_port);
 // If no SYNACK is received after SYNSEG_TIMEOUT timeout, then the SYN is 
 // retransmitted. If SYNACK is received, return 1. Otherwise, if the number of SYNs 
 // sent > SYN_MAX_RETRY,  transition to CLOSED state and return -1.
+// The SYN carries the client's MSS and the SYNACK carries the MSS agreed by the server,
+// which is the segment size srt_client_send uses on this connection. The SYNACK also
+// carries a fast open cookie, which is cached for srt_client_connect_send.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_client_connect_send(int sockfd, int nodeID, unsigned int server_port, void* data, unsigned int length);
+
+// Connects like srt_client_connect and sends length bytes of data. If a fast open cookie
+// of the server is cached from an earlier connection, the first segment of the data goes
+// out in the SYN and the server delivers it before the handshake completes, saving the
+// round trip. Otherwise, or if the server doesn't accept the data on SYN, all data is
+// sent with srt_client_send once connected. Every SYN asks the server for a cookie.
+// Returns 1 if connected and the data is queued, -1 otherwise.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
@@ -124,11 +164,10 @@ int srt_client_send(int sockfd, void* data, unsigned int length);
 
 // Send data to a srt server. This function should use the SRT socket ID to find the TCP entry. 
 // It creates segBufs using the given data and append them to send linked list. 
-// If the send buffer is empty before insertion, a thread called sendbuf_timer 
-// should be started to poll the send buffer every SENDBUF_POLLING_INTERVAL time
-// to check if a timeout event should occur. If the function completes successfully, 
+// The retransmission timer of the connection's stream is armed once segments are
+// sent. If the function completes successfully, 
 // it returns 1. Otherwise, it returns -1. srt_client_send is a non-blocking function call.
-// Because user data is fragmented into fixed sized SRT segments there may be
+// Because user data is fragmented into SRT segments of the negotiated MSS there may be
 // multiple segBufs queued to the send link list for a single srt_client_send call.
 // If the call is successful the data is queued on the TCB send linked list and
 // depending on the condition of the sliding window the data will either be
@@ -137,15 +176,195 @@ int srt_client_send(int sockfd, void* data, unsigned int length);
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
 
+int srt_client_sendfile(int sockfd, int fd, off_t offset, unsigned long length);
+
+// Send length bytes of the file fd, starting at offset, to a srt server without reading the
+// file into memory. The file is mapped with mmap in chunks of SENDFILE_CHUNK bytes and its
+// segments are cut from the mapping: only their headers are queued in the send buffer, the
+// data is copied from the mapping when a segment is sent or retransmitted. A chunk is unmapped
+// once the server Acked all of it, and the function waits while SENDFILE_CHUNKS chunks are
+// unAcked, so a file of any size is sent with bounded memory. The file must not be truncated
+// while it is sent. Returns 1 once all data is queued, -1 if the socket isn't CONNECTED,
+// offset + length is past the end of the file, the file can't be mapped, the connection is
+// closed first or the server Acks no chunk for SENDFILE_TIMEOUT.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_client_recv(int sockfd, void* buf, unsigned int length);
+
+// Receive data from the srt server. Connections are full duplex: the server sends with
+// srt_server_send and the client receives into the receive buffer of the TCB's stream.
+// Like srt_server_recv, this function waits until length bytes are available, then it
+// stores the data in buf and returns 1.
+// If the function fails, or the receive timeout expires first, return -1
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_client_read(int sockfd, void* buf, unsigned int length, int flags);
+
+// Read data from the srt server as it arrives, like srt_server_read: returns up to length
+// bytes as soon as there is data, or with SRT_WAITALL all length bytes.
+// Returns the number of bytes read, or -1 if the socket doesn't exist or the receive
+// timeout expired first.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_client_recvmsg(int sockfd, void* buf, unsigned int length);
+
+// Receive a message from the server of a SRT_SEQPACKET socket, like srt_server_recvmsg: waits
+// until one whole srt_server_send of the server arrived and stores it in buf, cut to length bytes.
+// On a SRT_DGRAM socket it waits for a datagram of the server the same way.
+// Returns the number of bytes stored, 0 once the connection was closed and all messages were
+// read, or -1 if the socket doesn't exist or is SRT_STREAM, or the receive timeout expired first.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_client_setdgramseq(int sockfd, int on);
+
+// Turns the sequence numbers of the datagrams a SRT_DGRAM socket sends on or off, like
+// srt_server_setdgramseq. Returns 1 on success, -1 if the socket doesn't exist or isn't SRT_DGRAM.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_client_dgramstats(int sockfd, srt_dgramstats_t* stats);
+
+// Copies the statistics of a SRT_DGRAM socket into stats, like srt_server_dgramstats.
+// Returns 1 on success, -1 if the socket doesn't exist or isn't SRT_DGRAM.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_client_setdelack(int sockfd, unsigned int ackEvery, unsigned int ackDelay_ms);
+
+// Sets the delayed-ACK policy of the socket for the data received from the server, like
+// srt_server_setdelack. Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_client_setcoalesce(int sockfd, int on, unsigned int flushTimeout_ms);
+
+// Turns small-write coalescing on or off for the socket. In coalescing mode, while
+// sent data is unAcked, srt_client_send appends small writes to the partial segment at
+// the tail of the send buffer instead of sending a segment per write. The partial segment
+// is sent when it fills up, when all outstanding data is Acked, on srt_client_flush or
+// after it has been held for flushTimeout_ms milliseconds (COALESCE_FLUSH_TIMEOUT if 0).
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_client_cork(int sockfd);
+
+// Corks the socket: partial segments are held back even when nothing is outstanding, so
+// the following writes are merged into full segments. Full segments are still sent. A
+// corked partial segment is sent after the socket's flush timeout at the latest.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_client_uncork(int sockfd);
+
+// Uncorks the socket and sends the data held back while it was corked.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_client_flush(int sockfd);
+
+// Sends any partial segment held back by coalescing or corking and blocks until all data
+// written to the socket so far is Acked by the server, at most for the socket's linger time
+// (LINGER_TIMEOUT if linger is off). Data written after the call may be held back again.
+// Returns 1 once everything is Acked, -1 on timeout or if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_client_setrecvtimeout(int sockfd, unsigned int timeout_ms);
+
+// Sets how long srt_client_recv and srt_client_read wait for data from the server:
+// timeout_ms milliseconds, or forever if 0, which is the default.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_client_setlinger(int sockfd, int on, unsigned int linger_ms);
+
+// Sets the linger option of the socket. With linger on, srt_client_disconnect first waits
+// until all data in the send buffer is Acked, at most linger_ms milliseconds (LINGER_TIMEOUT
+// if 0), and then sends the FIN. With linger off, unAcked data is dropped at once.
+// Linger is on by default. Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_client_setpacing(int sockfd, int on, unsigned int rate, unsigned int burst);
+
+// Turns the pacer on or off for the socket. With pacing on, new segments and
+// retransmissions don't put the whole window on the SNP connection back-to-back but
+// release bursts of burst segments (PACING_BURST if 0) spaced at rate bytes per second.
+// If rate is 0, the rate follows the connection: GBN_WINDOW segments per smoothed RTT,
+// times PACING_GAIN_PERCENT; until the first RTT is measured nothing is paced.
+// Pacing is on by default. Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_client_setsched(int sockfd, unsigned int weight, unsigned int priority);
+
+// Sets the transmit scheduling of the socket. The sockets of a process share the overlay
+// connection: sockets of a lower priority number are served first, and sockets of the same
+// priority share it in proportion to their weight. priority is at most TXSCHED_PRIORITIES - 1,
+// weight 0 is taken as 1. New sockets have weight 1 and TXSCHED_DEFAULT_PRIORITY.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_setfec(int sockfd, int on);
+
+// Turns forward error correction on or off for the next connection of the socket. With it on,
+// the SYN asks the server for it, and if the server agrees, both ends send a DATAFEC parity
+// segment of their data every few segments, more often the more segments are retransmitted.
+// When one segment of the data a parity segment covers is lost, the receiver rebuilds it
+// without waiting for the retransmission. It is off by default.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_client_setmultipath(int sockfd, unsigned int paths);
+
+// Sets the number of overlay paths, at most MULTIPATH_MAX_PATHS, the segments the socket sends are
+// striped over. Each segment carries a path hint to SNP: path 0 is the routing table's route, the
+// others start at the neighbors whose own route to the destination doesn't lead back through this
+// node. New segments are spread over the paths in inverse proportion to the RTT measured on each,
+// raised by the share of segments lost on it, and a retransmission goes out on another path than
+// the one it was lost on. The receiver puts the segments back in order. 1, the default, sends all
+// segments on the routing table's route. Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
 int srt_client_disconnect(int sockfd);
 
 // This function is used to disconnect from the server. It takes the socket ID as 
-// an input parameter. The socket ID is used to find the TCB entry in the TCB table.  
+// an input parameter. The socket ID is used to find the TCB entry in the connection table.  
+// If the socket lingers, it first waits until the server Acked all data sent.
 // This function sends a FIN segment to the server. After the FIN segment is sent
 // the state should transition to FINWAIT and a timer started. If the 
 // state == CLOSED after the timeout the FINACK was successfully received. Else,
 // if after a number of retries FIN_MAX_RETRY the state is still FINWAIT then
 // the state transitions to CLOSED and -1 is returned.
+// The server holds the FINACK back until the client Acked the data the server sent before
+// the FIN, so the data of the server is still received in FINWAIT and can be read after
+// disconnecting. Retries only count while none of it arrives, so data that doesn't fit in the
+// receive buffer must be read by another thread meanwhile, or disconnecting fails.
 
 
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
@@ -160,24 +379,17 @@ int srt_client_close(int sockfd);
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
 
-void *seghandler(void* arg);
+void seghandler(seg_t* segPtr, int src_nodeID);
 
-// This is a thread  started by srt_client_init(). It handles all the incoming 
-// segments from the server. The design of seghanlder is an infinite loop that calls snp_recvseg(). If
-// snp_recvseg() fails then the overlay connection is closed and the thread is terminated. Depending
+// This function handles an incoming segment from the server. It is called by the worker threads
+// of the dispatcher started by srt_client_init(), which receives the segments with snp_recvseg() and
+// hands all segments of a connection to the same worker, in order. If snp_recvseg() fails
+// then the overlay connection is closed and the threads are terminated. Depending
 // on the state of the connection when a segment is received  (based on the incoming segment) various
-// actions are taken. See the client FSM for more details.
+// actions are taken. See the client FSM for more details. A FIN of the server, sent when it closes
+// an idle connection, switches a CONNECTED or FINWAIT connection to CLOSED and is Acked.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
 
-void* sendBuf_timer(void* clienttcb);
-
-// This thread continuously polls send buffer to trigger timeout events
-// It should always be running when the send buffer is not empty
-// If the current time -  first sent-but-unAcked segment's sent time > DATA_TIMEOUT, a timeout event occurs
-// When timeout, resend all sent-but-unAcked segments
-// When the send buffer is empty, this thread terminates
-//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
-
 #endif
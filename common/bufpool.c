@@ -0,0 +1,92 @@
+//FILE: common/bufpool.c
+//
+//Description: this file implements the receive buffer pool shared by the SRT client and server.
+//
+//Date: October 19, 2026
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include "constants.h"
+#include "bufpool.h"
+
+//buffers come in sizes RECV_BUF_MIN << class, up to RECEIVE_BUF_SIZE
+#define BUFPOOL_CLASSES 32
+
+static pthread_mutex_t poolMutex = PTHREAD_MUTEX_INITIALIZER;	//protects everything below
+static unsigned long inUse;			//bytes of the buffers handed out
+static void* cache[BUFPOOL_CLASSES][BUFPOOL_KEEP];	//freed buffers of each size, kept mapped
+static unsigned int cacheLen[BUFPOOL_CLASSES];	//number of buffers in cache of each size
+
+//returns the size class of a buffer of size bytes
+static unsigned int bufpool_class(unsigned int size)
+{
+	unsigned int class = 0;
+	while ((RECV_BUF_MIN << class) < size) {
+		class++;
+	}
+	return class;
+}
+
+//This function takes a buffer of size bytes, a power of two from RECV_BUF_MIN to
+//RECEIVE_BUF_SIZE, from the pool. Returns NULL if the buffers in use would take more than
+//RECV_MEM_LIMIT bytes with it, or if it can't be mapped. Buffers of RECV_BUF_MIN bytes are
+//handed out regardless of the limit, so every connection can receive.
+void* bufpool_alloc(unsigned int size)
+{
+	unsigned int class = bufpool_class(size);
+	void* buf = NULL;
+
+	pthread_mutex_lock(&poolMutex);
+	if (size > RECV_BUF_MIN && inUse + size > RECV_MEM_LIMIT) {
+		pthread_mutex_unlock(&poolMutex);
+		return NULL;
+	}
+	if (cacheLen[class] > 0) {
+		buf = cache[class][--cacheLen[class]];
+	}
+	inUse += size;
+	pthread_mutex_unlock(&poolMutex);
+
+	if (buf == NULL) {
+		buf = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (buf == MAP_FAILED) {
+			perror("Error mapping receive buffer");
+			pthread_mutex_lock(&poolMutex);
+			inUse -= size;
+			pthread_mutex_unlock(&poolMutex);
+			return NULL;
+		}
+	}
+	return buf;
+}
+
+//This function returns a buffer of size bytes taken with bufpool_alloc to the pool.
+//The pages of a cached buffer are given back, it is mapped in again on the first write after reuse.
+void bufpool_free(void* buf, unsigned int size)
+{
+	unsigned int class = bufpool_class(size);
+
+	pthread_mutex_lock(&poolMutex);
+	inUse -= size;
+	if (cacheLen[class] < BUFPOOL_KEEP) {
+		madvise(buf, size, MADV_DONTNEED);
+		cache[class][cacheLen[class]++] = buf;
+		buf = NULL;
+	}
+	pthread_mutex_unlock(&poolMutex);
+
+	if (buf != NULL) {
+		munmap(buf, size);
+	}
+}
+
+//This function returns 1 if the buffers in use take more than three quarters of RECV_MEM_LIMIT,
+//0 otherwise.
+int bufpool_pressure()
+{
+	pthread_mutex_lock(&poolMutex);
+	int pressure = (inUse > RECV_MEM_LIMIT / 4 * 3);
+	pthread_mutex_unlock(&poolMutex);
+	return pressure;
+}
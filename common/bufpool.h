@@ -0,0 +1,27 @@
+//FILE: common/bufpool.h
+//
+//Description: this file defines the pool the receive buffers of the SRT client and server are
+//taken from. Buffers are mapped with mmap, so their pages only take memory once data is
+//written to them, and freed buffers are kept for reuse with their pages given back. The pool
+//counts the bytes of the buffers in use against RECV_MEM_LIMIT, so receive buffers only grow
+//while there is memory left, and shrink sooner when it runs low.
+//
+//Date: October 19, 2026
+
+#ifndef BUFPOOL_H
+#define BUFPOOL_H
+
+//This function takes a buffer of size bytes, a power of two from RECV_BUF_MIN to
+//RECEIVE_BUF_SIZE, from the pool. Returns NULL if the buffers in use would take more than
+//RECV_MEM_LIMIT bytes with it, or if it can't be mapped. Buffers of RECV_BUF_MIN bytes are
+//handed out regardless of the limit, so every connection can receive.
+void* bufpool_alloc(unsigned int size);
+
+//This function returns a buffer of size bytes taken with bufpool_alloc to the pool.
+void bufpool_free(void* buf, unsigned int size);
+
+//This function returns 1 if the buffers in use take more than three quarters of RECV_MEM_LIMIT,
+//0 otherwise.
+int bufpool_pressure();
+
+#endif
@@ -0,0 +1,232 @@
+//FILE: common/conntable.c
+//
+//Description: this file implements the connection table shared by the SRT client and server.
+//
+//Date: October 19, 2026
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include "constants.h"
+#include "conntable.h"
+
+//This function returns the hash of a connection key.
+unsigned int conntable_hashkey(unsigned int localPort, int remoteNode, unsigned int remotePort)
+{
+	unsigned int h = localPort * 0x9E3779B1u;
+	h ^= (unsigned int)remoteNode * 0x85EBCA6Bu;
+	h ^= remotePort * 0xC2B2AE35u;
+	h ^= h >> 16;
+	h *= 0x7FEB352Du;
+	h ^= h >> 15;
+	return h;
+}
+
+//returns the hash bucket of the key
+static int conn_hash(conntable_t* table, unsigned int localPort, int remoteNode, unsigned int remotePort)
+{
+	return conntable_hashkey(localPort, remoteNode, remotePort) & (table->numBuckets - 1);
+}
+
+//links slots first to last-1 into the free list in front of the current free slots
+static void conn_addfree(conntable_t* table, int first, int last)
+{
+	for (int i = last - 1; i >= first; i--) {
+		table->slots[i].conn = NULL;
+		table->slots[i].bound = 0;
+		table->slots[i].refs = 0;
+		table->slots[i].next = table->freeHead;
+		table->freeHead = i;
+	}
+}
+
+//puts the slot at the front of its key's bucket, table->mutex must be held
+static void conn_hashinsert(conntable_t* table, int sockfd)
+{
+	conn_key_t* key = &table->slots[sockfd].key;
+	int bucket = conn_hash(table, key->localPort, key->remoteNode, key->remotePort);
+	table->slots[sockfd].next = table->buckets[bucket];
+	table->buckets[bucket] = sockfd;
+	table->slots[sockfd].bound = 1;
+}
+
+//doubles the number of buckets and rehashes all bound slots, table->mutex must be held
+static void conn_rehash(conntable_t* table)
+{
+	free(table->buckets);
+	table->numBuckets *= 2;
+	table->buckets = malloc(sizeof(int) * table->numBuckets);
+	MALLOC_CHECK(table->buckets);
+	memset(table->buckets, 0xff, sizeof(int) * table->numBuckets);
+	for (int i = 0; i < table->numSlots; i++) {
+		if (table->slots[i].bound) {
+			conn_hashinsert(table, i);
+		}
+	}
+}
+
+//removes the slot from its bucket if it is bound, table->mutex must be held
+static void conn_hashremove(conntable_t* table, int sockfd)
+{
+	conn_slot_t* slot = &table->slots[sockfd];
+	if (!slot->bound) {
+		return;
+	}
+	int* link = &table->buckets[conn_hash(table, slot->key.localPort, slot->key.remoteNode, slot->key.remotePort)];
+	while (*link != sockfd) {
+		link = &table->slots[*link].next;
+	}
+	*link = slot->next;
+	slot->next = -1;
+	slot->bound = 0;
+	table->numBound--;
+}
+
+//returns the slot bound to exactly this key or -1, table->mutex must be held
+static int conn_find(conntable_t* table, unsigned int localPort, int remoteNode, unsigned int remotePort)
+{
+	int idx = table->buckets[conn_hash(table, localPort, remoteNode, remotePort)];
+	while (idx >= 0) {
+		conn_key_t* key = &table->slots[idx].key;
+		if (key->localPort == localPort && key->remoteNode == remoteNode && key->remotePort == remotePort) {
+			return idx;
+		}
+		idx = table->slots[idx].next;
+	}
+	return -1;
+}
+
+//This function sets up an empty connection table.
+void conntable_init(conntable_t* table)
+{
+	memset(table, 0, sizeof(conntable_t));
+	pthread_mutex_init(&table->mutex, NULL);
+	pthread_cond_init(&table->refCond, NULL);
+
+	table->numSlots = CONNTABLE_INIT_SIZE;
+	table->slots = malloc(sizeof(conn_slot_t) * table->numSlots);
+	MALLOC_CHECK(table->slots);
+	table->freeHead = -1;
+	conn_addfree(table, 0, table->numSlots);
+
+	table->numBuckets = CONNTABLE_INIT_SIZE;
+	table->buckets = malloc(sizeof(int) * table->numBuckets);
+	MALLOC_CHECK(table->buckets);
+	memset(table->buckets, 0xff, sizeof(int) * table->numBuckets);
+}
+
+//This function stores the TCB in a free slot and returns the slot index as the new socket
+//descriptor. It returns -1 if MAX_TRANSPORT_CONNECTIONS sockets are in use.
+int conntable_alloc(conntable_t* table, void* conn)
+{
+	pthread_mutex_lock(&table->mutex);
+	if (table->freeHead < 0) {
+		if (table->numSlots >= MAX_TRANSPORT_CONNECTIONS) {
+			pthread_mutex_unlock(&table->mutex);
+			return -1;
+		}
+		int oldSlots = table->numSlots;
+		table->numSlots = min(oldSlots * 2, MAX_TRANSPORT_CONNECTIONS);
+		table->slots = realloc(table->slots, sizeof(conn_slot_t) * table->numSlots);
+		MALLOC_CHECK(table->slots);
+		conn_addfree(table, oldSlots, table->numSlots);
+	}
+	int sockfd = table->freeHead;
+	table->freeHead = table->slots[sockfd].next;
+	table->slots[sockfd].conn = conn;
+	table->slots[sockfd].bound = 0;
+	table->slots[sockfd].next = -1;
+	pthread_mutex_unlock(&table->mutex);
+	return sockfd;
+}
+
+//This function returns the TCB of the socket descriptor, or NULL if it is not in use.
+void* conntable_get(conntable_t* table, int sockfd)
+{
+	void* conn = NULL;
+	pthread_mutex_lock(&table->mutex);
+	if (sockfd >= 0 && sockfd < table->numSlots) {
+		conn = table->slots[sockfd].conn;
+	}
+	pthread_mutex_unlock(&table->mutex);
+	return conn;
+}
+
+//This function unbinds the socket descriptor, waits until the references taken on it by
+//conntable_lookup are put back and puts its slot back on the free list. It must not be called
+//while holding a lock a thread holding a reference may wait for.
+//Once unbound, lookups don't find the socket anymore, so no new references are taken.
+void conntable_free(conntable_t* table, int sockfd)
+{
+	pthread_mutex_lock(&table->mutex);
+	if (sockfd >= 0 && sockfd < table->numSlots && table->slots[sockfd].conn != NULL) {
+		conn_hashremove(table, sockfd);
+		while (table->slots[sockfd].refs > 0) {
+			pthread_cond_wait(&table->refCond, &table->mutex);
+		}
+		conn_addfree(table, sockfd, sockfd + 1);
+	}
+	pthread_mutex_unlock(&table->mutex);
+}
+
+//This function binds the socket descriptor to the key, replacing any key it was bound to.
+//Incoming segments for the key are then found with conntable_lookup.
+void conntable_bind(conntable_t* table, int sockfd, unsigned int localPort, int remoteNode, unsigned int remotePort)
+{
+	pthread_mutex_lock(&table->mutex);
+	if (sockfd < 0 || sockfd >= table->numSlots || table->slots[sockfd].conn == NULL) {
+		pthread_mutex_unlock(&table->mutex);
+		return;
+	}
+	conn_hashremove(table, sockfd);
+	table->slots[sockfd].key.localPort = localPort;
+	table->slots[sockfd].key.remoteNode = remoteNode;
+	table->slots[sockfd].key.remotePort = remotePort;
+	if (++table->numBound > table->numBuckets) {
+		conn_rehash(table);
+	}
+	conn_hashinsert(table, sockfd);
+	pthread_mutex_unlock(&table->mutex);
+}
+
+//This function removes the socket descriptor from the hash index.
+void conntable_unbind(conntable_t* table, int sockfd)
+{
+	pthread_mutex_lock(&table->mutex);
+	if (sockfd >= 0 && sockfd < table->numSlots) {
+		conn_hashremove(table, sockfd);
+	}
+	pthread_mutex_unlock(&table->mutex);
+}
+
+//This function returns the TCB bound to (localPort, remoteNode, remotePort). If there is none,
+//it returns the TCB of a listening socket on localPort, or NULL if there is none either.
+//A reference is taken on the TCB found and its socket descriptor stored in *sockfd: the TCB
+//isn't freed until the reference is put back with conntable_put.
+void* conntable_lookup(conntable_t* table, unsigned int localPort, int remoteNode, unsigned int remotePort, int* sockfd)
+{
+	void* conn = NULL;
+	pthread_mutex_lock(&table->mutex);
+	int idx = conn_find(table, localPort, remoteNode, remotePort);
+	if (idx < 0) {
+		idx = conn_find(table, localPort, CONN_ANY_NODE, CONN_ANY_PORT);
+	}
+	if (idx >= 0) {
+		conn = table->slots[idx].conn;
+		table->slots[idx].refs++;
+	}
+	*sockfd = idx;
+	pthread_mutex_unlock(&table->mutex);
+	return conn;
+}
+
+//This function puts back a reference taken by conntable_lookup on the socket descriptor.
+void conntable_put(conntable_t* table, int sockfd)
+{
+	pthread_mutex_lock(&table->mutex);
+	if (--table->slots[sockfd].refs == 0) {
+		pthread_cond_broadcast(&table->refCond);
+	}
+	pthread_mutex_unlock(&table->mutex);
+}
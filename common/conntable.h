@@ -0,0 +1,84 @@
+//FILE: common/conntable.h
+//
+//Description: this file defines the connection table shared by the SRT client and server.
+//The table hands out socket descriptors and maps each one to its TCB. Descriptors come
+//from a free list and the descriptor array doubles when it runs out, so the number of
+//connections is only limited by MAX_TRANSPORT_CONNECTIONS. Incoming segments find their
+//TCB through a hash index keyed by (local port, remote node, remote port) in O(1).
+//A worker thread holds a reference on the TCB it found until it is done with the segment,
+//and freeing the descriptor waits for those references, so a TCB isn't freed under a worker.
+//
+//Date: October 19, 2026
+
+#ifndef CONNTABLE_H
+#define CONNTABLE_H
+
+#include <pthread.h>
+
+//remote node and port of a key that matches segments from any peer, used by listening sockets
+#define CONN_ANY_NODE -1
+#define CONN_ANY_PORT 0
+
+//the connection a socket descriptor is bound to
+typedef struct conn_key {
+	unsigned int localPort;		//port of this end
+	int remoteNode;			//node ID of the peer, CONN_ANY_NODE for a listening socket
+	unsigned int remotePort;	//port of the peer, CONN_ANY_PORT for a listening socket
+} conn_key_t;
+
+//one socket descriptor slot
+typedef struct conn_slot {
+	void* conn;			//TCB of the socket, NULL if the slot is free
+	conn_key_t key;			//key the socket is bound to
+	int bound;			//1 if the socket is in the hash index
+	int refs;			//references taken by conntable_lookup and not put back yet
+	int next;			//next slot in the same hash bucket, or next free slot; -1 ends the list
+} conn_slot_t;
+
+//a connection table
+typedef struct conntable {
+	pthread_mutex_t mutex;		//protects everything below
+	conn_slot_t* slots;		//indexed by socket descriptor
+	int numSlots;
+	int freeHead;			//first free slot, -1 if all slots are in use
+	int* buckets;			//hash buckets, each holds the first slot of its chain or -1
+	int numBuckets;			//always a power of two
+	int numBound;			//number of slots in the hash index
+	pthread_cond_t refCond;		//signaled when the last reference to a slot is put back
+} conntable_t;
+
+//This function returns the hash of a connection key.
+unsigned int conntable_hashkey(unsigned int localPort, int remoteNode, unsigned int remotePort);
+
+//This function sets up an empty connection table.
+void conntable_init(conntable_t* table);
+
+//This function stores the TCB in a free slot and returns the slot index as the new socket
+//descriptor. It returns -1 if MAX_TRANSPORT_CONNECTIONS sockets are in use.
+int conntable_alloc(conntable_t* table, void* conn);
+
+//This function returns the TCB of the socket descriptor, or NULL if it is not in use.
+void* conntable_get(conntable_t* table, int sockfd);
+
+//This function unbinds the socket descriptor, waits until the references taken on it by
+//conntable_lookup are put back and puts its slot back on the free list. It must not be called
+//while holding a lock a thread holding a reference may wait for.
+void conntable_free(conntable_t* table, int sockfd);
+
+//This function binds the socket descriptor to the key, replacing any key it was bound to.
+//Incoming segments for the key are then found with conntable_lookup.
+void conntable_bind(conntable_t* table, int sockfd, unsigned int localPort, int remoteNode, unsigned int remotePort);
+
+//This function removes the socket descriptor from the hash index.
+void conntable_unbind(conntable_t* table, int sockfd);
+
+//This function returns the TCB bound to (localPort, remoteNode, remotePort). If there is none,
+//it returns the TCB of a listening socket on localPort, or NULL if there is none either.
+//A reference is taken on the TCB found and its socket descriptor stored in *sockfd: the TCB
+//isn't freed until the reference is put back with conntable_put.
+void* conntable_lookup(conntable_t* table, unsigned int localPort, int remoteNode, unsigned int remotePort, int* sockfd);
+
+//This function puts back a reference taken by conntable_lookup on the socket descriptor.
+void conntable_put(conntable_t* table, int sockfd);
+
+#endif
@@ -11,7 +11,6 @@
 #define min( a, b ) ( ((a) < (b)) ? (a) : (b) )
 
 #define NANOSECONDS_PER_SECOND 1000000000
-#define BUFTIMER_INIT_SLEEP 50000000
 #define NS_TO_MICROSECONDS 1000
 #define RECVBUF_POLLING_INTERVAL_NS 100000000
 
@@ -26,12 +25,26 @@
 //transport layer parameters
 /*******************************************************************/
 
-//this is the MAX connections can be supported by SRT. You TCB table should contain MAX_TRANSPORT_CONNECTIONS entries
-#define MAX_TRANSPORT_CONNECTIONS 10
+//this is the MAX connections can be supported by SRT in one process
+#define MAX_TRANSPORT_CONNECTIONS 65536
+//initial number of socket descriptors and hash buckets of a connection table, both double as needed
+#define CONNTABLE_INIT_SIZE 16
+//most worker threads handling incoming segments, there is one per online CPU up to this limit
+#define DISPATCH_MAX_WORKERS 8
+//segments queued to a worker thread before further segments for it are dropped
+#define DISPATCH_QUEUE_LEN 4096
+//fast open cookies a client caches, one per server node
+#define FASTOPEN_COOKIE_CACHE 64
+//number of transmit priorities, 0 is served first
+#define TXSCHED_PRIORITIES 4
+//transmit priority of new sockets
+#define TXSCHED_DEFAULT_PRIORITY 1
+//bytes a flow of weight 1 may send per round, at least one full segment
+#define TXSCHED_QUANTUM MAX_PKT_LEN
 //Maximum segment length
-//MAX_SEG_LEN = 1500 - sizeof(seg header) - sizeof(ip header)
-//#define MAX_SEG_LEN  1464
-#define MAX_SEG_LEN 200
+//MAX_SEG_LEN = MAX_PKT_LEN - sizeof(seg header), it is defined in seg.h next to the segment header
+//segment length used with a peer that does not announce its MSS in the SYN/SYNACK
+#define DEFAULT_MSS 200
 //The packet loss rate is 10%
 #define PKT_LOSS_RATE 0.1
 //SYN_TIMEOUT value in nano seconds
@@ -44,20 +57,77 @@
 #define FIN_MAX_RETRY 5
 //server close wait timeout value in seconds
 #define CLOSEWAIT_TIMEOUT 5
-//sendBuf_timer thread's polling interval in nanoseconds
-#define SENDBUF_POLLING_INTERVAL 500000000
 //srt client polls the receive buffer with this time interval in order 
 //to check if requested data is available in srt_srv_recv() function
 //in seconds
 #define RECVBUF_POLLING_INTERVAL 1
 //srt_svr_accept() function uses this interval to busy wait on the tcb state
 #define ACCEPT_POLLING_INTERVAL 500000000
-//size of receive buffer
-#define RECEIVE_BUF_SIZE 1000000
+//connections a listening socket queues for srt_server_accept if srt_server_listen is given no backlog
+#define LISTEN_BACKLOG 16
+//largest size of a receive buffer, a ring indexed by masking, so it must be a power of two
+#define RECEIVE_BUF_SIZE 1048576
+//receive buffers start out with this size when the connection opens, and are autotuned between
+//it and RECEIVE_BUF_SIZE. A power of two, at least MAX_SEG_LEN
+#define RECV_BUF_MIN 16384
+//the receive buffers of all connections of a process grow only while they take less than this many bytes
+#define RECV_MEM_LIMIT 67108864
+//a receive buffer that was mostly empty for this long (in nanoseconds) is halved
+#define RECV_TUNE_INTERVAL 1000000000UL
+//freed receive buffers of each size kept mapped for reuse by other connections
+#define BUFPOOL_KEEP 4
+//the receive window in the 16-bit rcv_win header field is counted in units of 1 << RCV_WIN_SHIFT bytes,
+//so it covers the whole receive buffer
+#define RCV_WIN_SHIFT 5
 //DATA segment timeout value in microseconds
 #define DATA_TIMEOUT 500000
 //GBN window size
 #define GBN_WINDOW 10
+//the oldest unAcked segment is retransmitted at once after this many duplicate ACKs
+#define DUPACK_THRESHOLD 3
+//most separate ranges of out-of-order data the receiver keeps for reassembly, more are dropped
+#define REASM_MAX_RANGES 16
+//the server sends a DATAACK after this many in-order DATA segments...
+#define DELAYED_ACK_SEGMENTS 2
+//...or when the oldest unAcked in-order segment has waited this long (in nanoseconds).
+//srt_server_setdelack() can change both per socket. It must stay well below DATA_TIMEOUT
+#define DELAYED_ACK_TIMEOUT 40000000
+//the pacer spaces transmissions at PACING_GAIN_PERCENT percent of GBN_WINDOW segments per smoothed RTT...
+#define PACING_GAIN_PERCENT 125
+//...releasing this many segments back-to-back per pacing slot.
+//srt_client_setpacing() can set a fixed rate and burst per socket
+#define PACING_BURST 2
+//in coalescing or corked mode, a partial segment is held back at most this long (in nanoseconds)
+//before it is sent anyway. srt_client_setcoalesce() can change it per socket
+#define COALESCE_FLUSH_TIMEOUT 200000000
+//closing a socket waits at most this long (in nanoseconds) for its data to be Acked and for the
+//peer to finish the connection. srt_client_setlinger() and srt_server_setlinger() can change it per socket
+#define LINGER_TIMEOUT 30000000000UL
+//srt_client_sendfile() maps the file in chunks of this many bytes...
+#define SENDFILE_CHUNK 262144
+//...and maps the next one only while fewer than this many chunks have unAcked segments
+#define SENDFILE_CHUNKS 4
+//srt_client_sendfile() fails if the server Acks no chunk for this long, in nanoseconds
+#define SENDFILE_TIMEOUT 30000000000UL
+//with forward error correction, a DATAFEC parity segment covers at most a block of this many
+//segments of MSS bytes, and rebuilds one segment of it lost. A power of two, at least 4
+#define FEC_BLOCK_SEGS 8
+//the receiver keeps the XOR of the data of this many blocks, parity for older ones is dropped
+#define FEC_RECV_BLOCKS 4
+//the sender measures the share of its segments it retransmits over epochs of this many segments...
+#define FEC_LOSS_EPOCH 64
+//...and sends a parity segment every half block above FEC_LOSS_LOW percent and every quarter
+//block above FEC_LOSS_HIGH percent, once per block otherwise
+#define FEC_LOSS_LOW 3
+#define FEC_LOSS_HIGH 10
+//in multipath mode, a socket stripes its segments over at most this many overlay paths...
+#define MULTIPATH_MAX_PATHS 3
+//...and measures the share of the segments sent on each path it retransmits over epochs of this many segments
+#define MULTIPATH_LOSS_EPOCH 32
+//datagrams a SRT_DGRAM socket queues for reading, further ones are dropped until the app reads
+#define DGRAM_QUEUE_LEN 256
+//peers a SRT_DGRAM socket counts lost datagrams of, the one heard from the longest ago is forgotten for a new one
+#define DGRAM_PEERS 16
 
 /*******************************************************************/
 //overlay parameters
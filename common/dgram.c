@@ -0,0 +1,247 @@
+//FILE: common/dgram.c
+//
+//Description: this file implements the datagram transfer of SRT_DGRAM sockets, shared by the SRT
+//client and server.
+//
+//Date: October 19, 2026
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include "constants.h"
+#include "timer.h"
+#include "dgram.h"
+
+//number of sequence numbers before expectSeq a peer remembers as missing, the bits of missing
+#define DGRAM_MISSING_BITS 64
+
+//counts the numbered datagram seq from the peer srcPort on srcNode: the sequence numbers it
+//skips are lost, until they arrive late. Only a datagram that fills one of the last
+//DGRAM_MISSING_BITS gaps of the peer is late, any other older one is a duplicate, or came from
+//before the peer took its slot. The peer takes the slot of the peer heard from the longest ago
+//if it has none, the datagrams lost of that peer stay counted. dgram->mutex must be held
+static void dgram_count(dgram_t* dgram, int srcNode, unsigned int srcPort, unsigned int seq)
+{
+	unsigned long now = timer_now_ns();
+	dgram_peer_t* peer = NULL;
+	dgram_peer_t* oldest = NULL;
+	for (int i = 0; i < DGRAM_PEERS; i++) {
+		dgram_peer_t* slot = &dgram->peers[i];
+		if (slot->used && slot->node == srcNode && slot->port == srcPort) {
+			peer = slot;
+			break;
+		}
+		if (oldest == NULL || !slot->used || (oldest->used && slot->lastTime < oldest->lastTime)) {
+			oldest = slot;
+		}
+	}
+	if (peer == NULL) {
+		//the first datagram heard from the peer, nothing before it is known to be lost
+		peer = oldest;
+		peer->used = 1;
+		peer->node = srcNode;
+		peer->port = srcPort;
+		peer->expectSeq = seq;
+		peer->missing = 0;
+		peer->lost = 0;
+	}
+	peer->lastTime = now;
+
+	if (SEQ_GEQ(seq, peer->expectSeq)) {
+		unsigned int skipped = seq - peer->expectSeq;
+		if (skipped > 0) {
+			printf("%u datagrams from port %u lost before seq_num %u.\n", skipped, srcPort, seq);
+		}
+		//seq takes bit 0, the skipped sequence numbers the bits above it
+		unsigned int shift = skipped + 1;
+		if (shift >= DGRAM_MISSING_BITS) {
+			peer->missing = ~(uint64_t)1;
+		} else {
+			peer->missing = (peer->missing << shift) | (((uint64_t)1 << shift) - 2);
+		}
+		peer->lost += skipped;
+		dgram->stats.lost += skipped;
+		peer->expectSeq = seq + 1;
+		return;
+	}
+
+	unsigned int age = peer->expectSeq - 1 - seq;
+	if (age < DGRAM_MISSING_BITS && (peer->missing & ((uint64_t)1 << age))) {
+		//it was counted as lost when a later one arrived
+		peer->missing &= ~((uint64_t)1 << age);
+		peer->lost--;
+		dgram->stats.lost--;
+		dgram->stats.late++;
+	} else {
+		printf("Datagram seq_num %u from port %u arrived before, or too late to tell.\n", seq, srcPort);
+		dgram->stats.duplicate++;
+	}
+}
+
+//This function creates the datagram state of a socket on localPort, locked by the TCB's mutex
+//and sending on its flow of the scheduler.
+dgram_t* dgram_create(pthread_mutex_t* mutex, txsched_t* sched, txsched_flow_t* txFlow, unsigned int localPort)
+{
+	dgram_t* dgram = malloc(sizeof(dgram_t));
+	MALLOC_CHECK(dgram);
+	memset(dgram, 0, sizeof(dgram_t));
+	dgram->mutex = mutex;
+	dgram->sched = sched;
+	dgram->txFlow = txFlow;
+	dgram->localPort = localPort;
+	timer_condinit(&dgram->recvCond);
+	return dgram;
+}
+
+//This function frees the datagram state and the datagrams not read.
+void dgram_destroy(dgram_t* dgram)
+{
+	while (dgram->recvHead != NULL) {
+		dgram_item_t* item = dgram->recvHead;
+		dgram->recvHead = item->next;
+		free(item);
+	}
+	pthread_cond_destroy(&dgram->recvCond);
+	free(dgram);
+}
+
+//This function sends length bytes of data, at most MAX_SEG_LEN, as one datagram to destPort on
+//destNode. Returns 1, or -1 if the data doesn't fit in a segment.
+//The segment goes straight to the transmit scheduler, nothing is kept to send it again.
+int dgram_send(dgram_t* dgram, int destNode, unsigned int destPort, void* data, unsigned int length)
+{
+	if (length > MAX_SEG_LEN) {
+		printf("Datagram of %u bytes doesn't fit in a segment of %d bytes.\n", length, MAX_SEG_LEN);
+		return -1;
+	}
+	srt_hdr_t header;
+	memset(&header, 0, sizeof(srt_hdr_t));
+	header.src_port = dgram->localPort;
+	header.dest_port = destPort;
+	header.type = DGRAM;
+	header.length = length;
+
+	pthread_mutex_lock(dgram->mutex);
+	if (dgram->numbered) {
+		header.seq_num = dgram->nextSeq++;
+		header.flags |= SEG_SEQ;
+	}
+	dgram->stats.sent++;
+	pthread_mutex_unlock(dgram->mutex);
+
+	printf("Sending datagram of %u bytes to port %u.\n", length, destPort);
+	return (txsched_senddata(dgram->sched, dgram->txFlow, destNode, 0, &header, data) < 0) ? -1 : 1;
+}
+
+//This function queues the data of a DGRAM segment from srcNode for reading, and counts the
+//datagrams lost before it if it is numbered.
+//A datagram arriving while DGRAM_QUEUE_LEN are waiting is dropped: the reader is behind, and
+//newer data is coming.
+void dgram_input(dgram_t* dgram, seg_t* segPtr, int srcNode)
+{
+	pthread_mutex_lock(dgram->mutex);
+	if (segPtr->header.flags & SEG_SEQ) {
+		dgram_count(dgram, srcNode, segPtr->header.src_port, segPtr->header.seq_num);
+	}
+	if (dgram->recvShut || dgram->recvLen >= DGRAM_QUEUE_LEN) {
+		dgram->stats.dropped++;
+		pthread_mutex_unlock(dgram->mutex);
+		printf("Port %u doesn't take more datagrams. Dropping datagram.\n", dgram->localPort);
+		return;
+	}
+	unsigned int length = min(segPtr->header.length, MAX_SEG_LEN);
+	dgram_item_t* item = malloc(sizeof(dgram_item_t) + length);
+	MALLOC_CHECK(item);
+	item->next = NULL;
+	item->srcNode = srcNode;
+	item->srcPort = segPtr->header.src_port;
+	item->length = length;
+	memcpy(item->data, segPtr->data, length);
+
+	if (dgram->recvTail == NULL) {
+		dgram->recvHead = item;
+	} else {
+		dgram->recvTail->next = item;
+	}
+	dgram->recvTail = item;
+	dgram->recvLen++;
+	dgram->stats.received++;
+	printf("Queued datagram of %u bytes from port %u.\n", length, item->srcPort);
+	pthread_cond_signal(&dgram->recvCond);
+	pthread_mutex_unlock(dgram->mutex);
+}
+
+//This function waits until a datagram is received and takes it out into buf, cut to length bytes.
+//The sender is stored in *srcNode and *srcPort unless they are NULL. A read waits at most timeout
+//nanoseconds, or forever if 0. Returns the number of bytes stored, 0 if the socket was stopped
+//and all datagrams were read, or -1 if the timeout expired first.
+int dgram_recv(dgram_t* dgram, void* buf, unsigned int length, int* srcNode, unsigned int* srcPort, unsigned long timeout)
+{
+	unsigned long deadline = 0;
+	if (timeout > 0) {
+		deadline = timer_now_ns() + timeout;
+	}
+
+	pthread_mutex_lock(dgram->mutex);
+	while (dgram->recvHead == NULL && !dgram->recvShut) {
+		if (deadline == 0) {
+			pthread_cond_wait(&dgram->recvCond, dgram->mutex);
+		} else if (timer_condwait(&dgram->recvCond, dgram->mutex, deadline) == ETIMEDOUT && dgram->recvHead == NULL) {
+			pthread_mutex_unlock(dgram->mutex);
+			printf("Receive timeout, no datagram.\n");
+			return -1;
+		}
+	}
+	dgram_item_t* item = dgram->recvHead;
+	if (item == NULL) {
+		pthread_mutex_unlock(dgram->mutex);
+		printf("Socket stopped, no datagram.\n");
+		return 0;
+	}
+	dgram->recvHead = item->next;
+	if (dgram->recvHead == NULL) {
+		dgram->recvTail = NULL;
+	}
+	dgram->recvLen--;
+	pthread_mutex_unlock(dgram->mutex);
+
+	unsigned int readLen = min(length, item->length);
+	memcpy(buf, item->data, readLen);
+	if (srcNode != NULL) {
+		*srcNode = item->srcNode;
+	}
+	if (srcPort != NULL) {
+		*srcPort = item->srcPort;
+	}
+	if (readLen < item->length) {
+		printf("Datagram of %u bytes cut to %u bytes.\n", item->length, readLen);
+	}
+	free(item);
+	return readLen;
+}
+
+//This function turns the sequence numbers of the datagrams sent on or off.
+void dgram_setnumbered(dgram_t* dgram, int on)
+{
+	pthread_mutex_lock(dgram->mutex);
+	dgram->numbered = on ? 1 : 0;
+	pthread_mutex_unlock(dgram->mutex);
+}
+
+//This function copies the statistics of the socket into stats.
+void dgram_getstats(dgram_t* dgram, srt_dgramstats_t* stats)
+{
+	pthread_mutex_lock(dgram->mutex);
+	*stats = dgram->stats;
+	pthread_mutex_unlock(dgram->mutex);
+}
+
+//This function stops the socket: reads waiting for a datagram return.
+void dgram_stop(dgram_t* dgram)
+{
+	pthread_mutex_lock(dgram->mutex);
+	dgram->recvShut = 1;
+	pthread_cond_broadcast(&dgram->recvCond);
+	pthread_mutex_unlock(dgram->mutex);
+}
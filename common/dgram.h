@@ -0,0 +1,97 @@
+//FILE: common/dgram.h
+//
+//Description: this file defines the datagram transfer of a SRT_DGRAM socket, shared by the SRT
+//client and server. A datagram is one DGRAM segment, sent through the transmit scheduler and
+//demultiplexed by port like any other segment, and checked against its checksum on arrival, but
+//there is no handshake, no send buffer, no ACK and no timer: a datagram lost is lost, and the
+//datagrams received are handed to the reader in the order they arrive. If asked to, the sender
+//numbers its datagrams, and the receiver counts the datagrams of each peer that went missing.
+//
+//Date: October 19, 2026
+
+#ifndef DGRAM_H
+#define DGRAM_H
+
+#include <pthread.h>
+#include <stdint.h>
+#include "seg.h"
+#include "txsched.h"
+
+//a datagram received, waiting to be read
+typedef struct dgram_item {
+	struct dgram_item* next;
+	int srcNode;			//node ID of the sender
+	unsigned int srcPort;		//port of the sender
+	unsigned int length;		//number of bytes of data
+	char data[];
+} dgram_item_t;
+
+//the sequence numbers received from a peer, to count the datagrams lost
+typedef struct dgram_peer {
+	int used;			//1 if the slot holds a peer
+	int node;			//node ID of the peer
+	unsigned int port;		//port of the peer
+	unsigned int expectSeq;		//sequence number of the next datagram expected from the peer
+	uint64_t missing;		//bit i is set if expectSeq - 1 - i was skipped and counted lost
+	unsigned long lost;		//datagrams of the peer counted lost that haven't arrived
+	unsigned long lastTime;		//monotonic time in nanoseconds the peer's last datagram arrived
+} dgram_peer_t;
+
+//the statistics of a datagram socket
+typedef struct srt_dgramstats {
+	unsigned long sent;		//datagrams sent
+	unsigned long received;		//datagrams received and queued for reading
+	unsigned long lost;		//numbered datagrams of the peers that haven't arrived, as far as known
+	unsigned long late;		//numbered datagrams counted lost that arrived after all
+	unsigned long duplicate;	//numbered datagrams that arrived again, or too late to tell if they were lost
+	unsigned long dropped;		//datagrams dropped because DGRAM_QUEUE_LEN were waiting to be read
+} srt_dgramstats_t;
+
+//the datagram state of a SRT_DGRAM socket
+typedef struct dgram {
+	pthread_mutex_t* mutex;		//the TCB's bufMutex, protects everything below
+	txsched_t* sched;		//transmit scheduler the datagrams are sent through
+	txsched_flow_t* txFlow;		//the TCB's flow on the scheduler
+	unsigned int localPort;		//port of this end
+	int numbered;			//1 if the datagrams sent carry sequence numbers
+	unsigned int nextSeq;		//sequence number of the next datagram sent
+	dgram_item_t* recvHead;		//oldest datagram waiting to be read
+	dgram_item_t* recvTail;		//newest datagram waiting to be read
+	unsigned int recvLen;		//number of datagrams waiting to be read
+	pthread_cond_t recvCond;	//signaled when a datagram arrives or the socket is stopped
+	int recvShut;			//1 once the socket is stopped, reads return instead of waiting
+	dgram_peer_t peers[DGRAM_PEERS];	//the peers whose datagrams were received lately
+	srt_dgramstats_t stats;
+} dgram_t;
+
+//This function creates the datagram state of a socket on localPort, locked by the TCB's mutex
+//and sending on its flow of the scheduler.
+dgram_t* dgram_create(pthread_mutex_t* mutex, txsched_t* sched, txsched_flow_t* txFlow, unsigned int localPort);
+
+//This function frees the datagram state and the datagrams not read.
+void dgram_destroy(dgram_t* dgram);
+
+//This function sends length bytes of data, at most MAX_SEG_LEN, as one datagram to destPort on
+//destNode. Returns 1, or -1 if the data doesn't fit in a segment.
+int dgram_send(dgram_t* dgram, int destNode, unsigned int destPort, void* data, unsigned int length);
+
+//This function queues the data of a DGRAM segment from srcNode for reading, and counts the
+//datagrams lost before it if it is numbered.
+void dgram_input(dgram_t* dgram, seg_t* segPtr, int srcNode);
+
+//This function waits until a datagram is received and takes it out into buf, cut to length bytes.
+//The sender is stored in *srcNode and *srcPort unless they are NULL. A read waits at most timeout
+//nanoseconds, or forever if 0. Returns the number of bytes stored, 0 if the socket was stopped
+//and all datagrams were read, or -1 if the timeout expired first.
+int dgram_recv(dgram_t* dgram, void* buf, unsigned int length, int* srcNode, unsigned int* srcPort, unsigned long timeout);
+
+//This function turns the sequence numbers of the datagrams sent on or off.
+void dgram_setnumbered(dgram_t* dgram, int on);
+
+//This function copies the statistics of the socket into stats.
+void dgram_getstats(dgram_t* dgram, srt_dgramstats_t* stats);
+
+//This function stops the socket: reads waiting for a datagram return.
+void dgram_stop(dgram_t* dgram);
+
+#endif
@@ -0,0 +1,139 @@
+//FILE: common/dispatch.c
+//
+//Description: this file implements the segment dispatcher shared by the SRT client and server.
+//
+//Date: October 19, 2026
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "constants.h"
+#include "conntable.h"
+#include "dispatch.h"
+
+//This thread runs the handler for the segments queued to its worker, in the order they
+//were received. It exits when the queue is empty and the dispatcher has stopped.
+static void* dispatch_workerthread(void* arg)
+{
+	dispatch_worker_t* worker = (dispatch_worker_t*)arg;
+
+	pthread_mutex_lock(&worker->mutex);
+	while (1) {
+		while (worker->head == NULL && !worker->closed) {
+			pthread_cond_wait(&worker->cond, &worker->mutex);
+		}
+		if (worker->head == NULL) {
+			break;
+		}
+		dispatch_item_t* item = worker->head;
+		worker->head = item->next;
+		if (worker->head == NULL) {
+			worker->tail = NULL;
+		}
+		worker->len--;
+		pthread_mutex_unlock(&worker->mutex);
+
+		worker->handler(&item->seg, item->src_nodeID);
+		free(item);
+
+		pthread_mutex_lock(&worker->mutex);
+	}
+	pthread_mutex_unlock(&worker->mutex);
+	return NULL;
+}
+
+//queues the item to the worker. If the worker is DISPATCH_QUEUE_LEN segments behind, the
+//segment is dropped like a segment lost in the network, and the sender retransmits it.
+static void dispatch_queue(dispatch_worker_t* worker, dispatch_item_t* item)
+{
+	pthread_mutex_lock(&worker->mutex);
+	if (worker->len >= DISPATCH_QUEUE_LEN) {
+		pthread_mutex_unlock(&worker->mutex);
+		printf("Worker queue is full. Dropping seq_num %u.\n", item->seg.header.seq_num);
+		free(item);
+		return;
+	}
+	item->next = NULL;
+	if (worker->tail == NULL) {
+		worker->head = item;
+	} else {
+		worker->tail->next = item;
+	}
+	worker->tail = item;
+	worker->len++;
+	pthread_cond_signal(&worker->cond);
+	pthread_mutex_unlock(&worker->mutex);
+}
+
+//This thread receives segments from the SNP connection and queues each one to the worker
+//of its connection: the hash of (destination port, source node, source port) is the
+//receiving TCB's connection key.
+static void* dispatch_thread(void* arg)
+{
+	dispatcher_t* dispatcher = (dispatcher_t*)arg;
+
+	while (1) {
+		dispatch_item_t* item = malloc(sizeof(dispatch_item_t));
+		MALLOC_CHECK(item);
+		if (snp_recvseg(dispatcher->conn, &item->src_nodeID, &item->seg) <= 0) {
+			free(item);
+			break;
+		}
+		unsigned int hash = conntable_hashkey(item->seg.header.dest_port, item->src_nodeID, item->seg.header.src_port);
+		dispatch_queue(&dispatcher->workers[hash % dispatcher->numWorkers], item);
+	}
+
+	//let the workers finish the segments already received
+	for (int i = 0; i < dispatcher->numWorkers; i++) {
+		pthread_mutex_lock(&dispatcher->workers[i].mutex);
+		dispatcher->workers[i].closed = 1;
+		pthread_cond_signal(&dispatcher->workers[i].cond);
+		pthread_mutex_unlock(&dispatcher->workers[i].mutex);
+	}
+	for (int i = 0; i < dispatcher->numWorkers; i++) {
+		pthread_join(dispatcher->workers[i].thread, NULL);
+	}
+
+	printf("seghandler is closing the overlay connection.\n");
+	close(dispatcher->conn);
+	return NULL;
+}
+
+//This function starts a dispatcher thread receiving segments from the SNP connection conn and
+//one worker per online CPU (at most DISPATCH_MAX_WORKERS) that call handler for each segment.
+//When snp_recvseg fails, the workers finish their queues and exit, and the dispatcher closes conn.
+//Returns the dispatcher, or NULL if the threads couldn't be started.
+dispatcher_t* dispatch_start(int conn, dispatch_fn handler)
+{
+	dispatcher_t* dispatcher = malloc(sizeof(dispatcher_t));
+	MALLOC_CHECK(dispatcher);
+	memset(dispatcher, 0, sizeof(dispatcher_t));
+	dispatcher->conn = conn;
+
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	dispatcher->numWorkers = (cpus < 1) ? 1 : min(cpus, DISPATCH_MAX_WORKERS);
+	dispatcher->workers = malloc(sizeof(dispatch_worker_t) * dispatcher->numWorkers);
+	MALLOC_CHECK(dispatcher->workers);
+	memset(dispatcher->workers, 0, sizeof(dispatch_worker_t) * dispatcher->numWorkers);
+
+	for (int i = 0; i < dispatcher->numWorkers; i++) {
+		dispatch_worker_t* worker = &dispatcher->workers[i];
+		pthread_mutex_init(&worker->mutex, NULL);
+		pthread_cond_init(&worker->cond, NULL);
+		worker->handler = handler;
+		if (pthread_create(&worker->thread, NULL, dispatch_workerthread, worker)) {
+			printf("Error creating worker thread.\n");
+			return NULL;
+		}
+	}
+
+	if (pthread_create(&dispatcher->thread, NULL, dispatch_thread, dispatcher)) {
+		printf("Error creating dispatcher thread.\n");
+		return NULL;
+	}
+	pthread_detach(dispatcher->thread);
+	printf("Started dispatcher with %d workers.\n", dispatcher->numWorkers);
+	return dispatcher;
+}
@@ -0,0 +1,53 @@
+//FILE: common/dispatch.h
+//
+//Description: this file defines the segment dispatcher shared by the SRT client and server.
+//A dispatcher thread receives the segments from the SNP connection and hands them to a pool
+//of worker threads. Segments are sharded over the workers by the hash of their connection,
+//so the segments of one connection are handled in order by the same worker, while different
+//connections are handled in parallel.
+//
+//Date: October 19, 2026
+
+#ifndef DISPATCH_H
+#define DISPATCH_H
+
+#include <pthread.h>
+#include "seg.h"
+
+//handles one incoming segment, called by a worker thread
+typedef void (*dispatch_fn)(seg_t* segPtr, int src_nodeID);
+
+//a received segment waiting in a worker's queue
+typedef struct dispatch_item {
+	seg_t seg;
+	int src_nodeID;
+	struct dispatch_item* next;
+} dispatch_item_t;
+
+//a worker thread and its queue
+typedef struct dispatch_worker {
+	pthread_t thread;
+	pthread_mutex_t mutex;		//protects the queue
+	pthread_cond_t cond;		//signaled when an item is queued or the dispatcher stops
+	dispatch_item_t* head;
+	dispatch_item_t* tail;
+	int len;			//number of queued items
+	int closed;			//1 once the SNP connection is closed
+	dispatch_fn handler;
+} dispatch_worker_t;
+
+//a dispatcher
+typedef struct dispatcher {
+	int conn;			//SNP connection the segments are received from
+	pthread_t thread;
+	int numWorkers;
+	dispatch_worker_t* workers;
+} dispatcher_t;
+
+//This function starts a dispatcher thread receiving segments from the SNP connection conn and
+//one worker per online CPU (at most DISPATCH_MAX_WORKERS) that call handler for each segment.
+//When snp_recvseg fails, the workers finish their queues and exit, and the dispatcher closes conn.
+//Returns the dispatcher, or NULL if the threads couldn't be started.
+dispatcher_t* dispatch_start(int conn, dispatch_fn handler);
+
+#endif
@@ -0,0 +1,235 @@
+//FILE: common/fec.c
+//
+//Description: this file implements the forward error correction shared by the SRT client and server.
+//
+//Date: October 19, 2026
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "constants.h"
+#include "fec.h"
+
+//returns the first sequence number of the block of seq, in blocks of blockLen counted from base
+static unsigned int fec_blockstart(unsigned int base, unsigned int blockLen, unsigned int seq)
+{
+	return seq - (seq - base) % blockLen;
+}
+
+//XORs length bytes of data, which start offset bytes into their block, into the rows of acc
+static void fec_xor(char* acc, unsigned int width, unsigned int offset, const char* data, unsigned int length)
+{
+	unsigned int col = offset % width;
+	while (length > 0) {
+		unsigned int n = min(length, width - col);
+		for (unsigned int i = 0; i < n; i++) {
+			acc[col + i] ^= data[i];
+		}
+		data += n;
+		length -= n;
+		col = 0;
+	}
+}
+
+//puts the parity segment of the data sent since the start of the block in paritySeg. Returns 1
+static int fec_parity(fec_t* fec, seg_t* paritySeg)
+{
+	memset(&paritySeg->header, 0, sizeof(srt_hdr_t));
+	paritySeg->header.type = DATAFEC;
+	paritySeg->header.seq_num = fec->sndFirst;
+	paritySeg->header.ack_num = fec->sndEnd;
+	paritySeg->header.length = fec->width;
+	memcpy(paritySeg->data, fec->sndAcc, fec->width);
+	fec->sndPending = 0;
+	fec->sndSegs = 0;
+	return 1;
+}
+
+//returns the slot of the received block starting at start, and takes the slot of the oldest
+//block for it if it has none. Returns NULL if the block is older than all blocks kept
+static fec_block_t* fec_block(fec_t* fec, unsigned int start)
+{
+	fec_block_t* oldest = NULL;
+	for (int i = 0; i < FEC_RECV_BLOCKS; i++) {
+		fec_block_t* block = &fec->rcv[i];
+		if (!block->used) {
+			oldest = block;
+			break;
+		}
+		if (block->start == start) {
+			return block;
+		}
+		if (oldest == NULL || SEQ_LT(block->start, oldest->start)) {
+			oldest = block;
+		}
+	}
+	if (oldest->used && SEQ_LT(start, oldest->start)) {
+		return NULL;
+	}
+	memset(oldest, 0, sizeof(fec_block_t));
+	oldest->used = 1;
+	oldest->start = start;
+	return oldest;
+}
+
+//This function creates the FEC state of a stream whose sent data starts at sequence number
+//sndBase and received data at rcvBase, with rows of width bytes.
+fec_t* fec_create(unsigned int sndBase, unsigned int rcvBase, unsigned int width)
+{
+	fec_t* fec = malloc(sizeof(fec_t));
+	MALLOC_CHECK(fec);
+	memset(fec, 0, sizeof(fec_t));
+	fec->width = width;
+	fec->blockLen = FEC_BLOCK_SEGS * width;
+	fec->sndBase = sndBase;
+	fec->sndStart = sndBase;
+	fec->sndFirst = sndBase;
+	fec->sndEnd = sndBase;
+	fec->parityEvery = FEC_BLOCK_SEGS / 2;
+	fec->rcvBase = rcvBase;
+	return fec;
+}
+
+//This function frees the FEC state.
+void fec_destroy(fec_t* fec)
+{
+	free(fec);
+}
+
+//This function XORs length bytes of data sent for the first time at sequence number seq into
+//the block being sent. Data must be sent in sequence order.
+//Returns 1 if a parity segment is due and was put in paritySeg, 0 otherwise.
+int fec_sent(fec_t* fec, unsigned int seq, const char* data, unsigned int length, seg_t* paritySeg)
+{
+	int due = 0;
+	fec->sndSegs++;
+	while (length > 0) {
+		unsigned int start = fec_blockstart(fec->sndBase, fec->blockLen, seq);
+		//the data starts a new block, or the first one
+		if (start != fec->sndStart || fec->sndFirst == fec->sndEnd) {
+			memset(fec->sndAcc, 0, fec->width);
+			fec->sndStart = start;
+			fec->sndFirst = seq;
+			fec->sndPending = 0;
+		}
+		unsigned int n = min(length, start + fec->blockLen - seq);
+		fec_xor(fec->sndAcc, fec->width, seq - start, data, n);
+		seq += n;
+		data += n;
+		length -= n;
+		fec->sndEnd = seq;
+		fec->sndPending = 1;
+		//a complete block is always covered, a segment that also starts the next one waits for its next parity
+		if (seq == start + fec->blockLen && !due) {
+			due = fec_parity(fec, paritySeg);
+		}
+	}
+	if (!due && fec->sndSegs >= fec->parityEvery) {
+		due = fec_parity(fec, paritySeg);
+	}
+	return due;
+}
+
+//This function puts a parity segment for the data sent since the last one in paritySeg, when
+//the sender has nothing more to send. Returns 1, or 0 if all data sent is covered already.
+int fec_flush(fec_t* fec, seg_t* paritySeg)
+{
+	if (!fec->sndPending) {
+		return 0;
+	}
+	return fec_parity(fec, paritySeg);
+}
+
+//This function counts a segment sent, or retransmitted if rtx is 1, to measure the loss rate,
+//and sets how often parity segments are sent from it.
+//The retransmissions of an epoch of FEC_LOSS_EPOCH segments are smoothed into lossPct, which
+//picks a parity segment every FEC_BLOCK_SEGS segments on a clean path, every half block above
+//FEC_LOSS_LOW percent and every quarter block above FEC_LOSS_HIGH percent.
+void fec_count(fec_t* fec, int rtx)
+{
+	fec->epochSegs++;
+	fec->epochRtx += rtx ? 1 : 0;
+	if (fec->epochSegs < FEC_LOSS_EPOCH) {
+		return;
+	}
+	fec->lossPct = (3 * fec->lossPct + fec->epochRtx * 100 / fec->epochSegs) / 4;
+	fec->epochSegs = 0;
+	fec->epochRtx = 0;
+
+	unsigned int parityEvery = FEC_BLOCK_SEGS;
+	if (fec->lossPct >= FEC_LOSS_HIGH) {
+		parityEvery = FEC_BLOCK_SEGS / 4;
+	} else if (fec->lossPct >= FEC_LOSS_LOW) {
+		parityEvery = FEC_BLOCK_SEGS / 2;
+	}
+	if (parityEvery != fec->parityEvery) {
+		printf("FEC: %u%% of the segments retransmitted, sending parity every %u segments.\n", fec->lossPct, parityEvery);
+		fec->parityEvery = parityEvery;
+	}
+}
+
+//This function XORs length bytes of data received for the first time at sequence number seq
+//into their blocks.
+void fec_received(fec_t* fec, unsigned int seq, const char* data, unsigned int length)
+{
+	while (length > 0) {
+		unsigned int start = fec_blockstart(fec->rcvBase, fec->blockLen, seq);
+		unsigned int n = min(length, start + fec->blockLen - seq);
+		fec_block_t* block = fec_block(fec, start);
+		if (block != NULL) {
+			if (block->received == 0) {
+				block->first = seq;
+				block->end = seq + n;
+			}
+			if (SEQ_LT(seq, block->first)) {
+				block->first = seq;
+			}
+			if (SEQ_GT(seq + n, block->end)) {
+				block->end = seq + n;
+			}
+			fec_xor(block->acc, fec->width, seq - start, data, n);
+			block->received += n;
+		}
+		seq += n;
+		data += n;
+		length -= n;
+	}
+}
+
+//This function rebuilds the data [missStart, missEnd) from the parity segment, if it is the only
+//data of the segment's range not received yet. Returns 1 with the data in buf, or 0 if the
+//parity segment can't rebuild it.
+//Each byte of the parity is the XOR of one column of the rows sent, so a missing range of at most
+//one row has one byte in each column, the XOR of the parity and of the bytes received in its column.
+int fec_rebuild(fec_t* fec, seg_t* paritySeg, unsigned int missStart, unsigned int missEnd, char* buf)
+{
+	unsigned int first = paritySeg->header.seq_num;
+	unsigned int end = paritySeg->header.ack_num;
+	unsigned int missLen = missEnd - missStart;
+	unsigned int start = fec_blockstart(fec->rcvBase, fec->blockLen, first);
+
+	if (paritySeg->header.length != fec->width || missLen > fec->width || SEQ_LEQ(end, first)
+		|| SEQ_GT(end, start + fec->blockLen)) {
+		return 0;
+	}
+	//the block may not have a slot if nothing of it arrived
+	fec_block_t* block = NULL;
+	for (int i = 0; i < FEC_RECV_BLOCKS; i++) {
+		if (fec->rcv[i].used && fec->rcv[i].start == start) {
+			block = &fec->rcv[i];
+		}
+	}
+	unsigned int received = (block != NULL) ? block->received : 0;
+	//everything else the parity covers must be in acc, and nothing it doesn't
+	if (received != (end - first) - missLen) {
+		return 0;
+	}
+	if (received > 0 && (SEQ_LT(block->first, first) || SEQ_GT(block->end, end))) {
+		return 0;
+	}
+	for (unsigned int i = 0; i < missLen; i++) {
+		unsigned int col = (missStart - start + i) % fec->width;
+		buf[i] = paritySeg->data[col] ^ ((block != NULL) ? block->acc[col] : 0);
+	}
+	return 1;
+}
@@ -0,0 +1,81 @@
+//FILE: common/fec.h
+//
+//Description: this file defines the forward error correction of a SRT stream, shared by the SRT
+//client and server. The data of each direction is cut into blocks of FEC_BLOCK_SEGS segments of
+//MSS bytes, counted in sequence numbers from the first byte of the stream. The sender XORs the
+//data of a block, in rows of MSS bytes, into the data of a DATAFEC parity segment. The receiver
+//XORs the data it receives the same way, so when one range of at most MSS bytes of the data a
+//parity segment covers is missing, it is rebuilt without waiting for the retransmission.
+//The sender sends a parity segment for the block so far every few segments, more often the more
+//of its segments it has to retransmit, and when it has nothing more to send.
+//
+//Date: October 19, 2026
+
+#ifndef FEC_H
+#define FEC_H
+
+#include "seg.h"
+
+//the XOR of the data received of a block
+typedef struct fec_block {
+	int used;			//1 if the slot holds a block
+	unsigned int start;		//first sequence number of the block
+	unsigned int first;		//first sequence number XORed into acc
+	unsigned int end;		//sequence number after the last byte XORed into acc
+	unsigned int received;		//bytes XORed into acc
+	char acc[MAX_SEG_LEN];		//byte i of a row is XORed into acc[i]
+} fec_block_t;
+
+//the forward error correction state of a stream
+typedef struct fec {
+	unsigned int width;		//length of a row and of the parity data, the MSS
+	unsigned int blockLen;		//FEC_BLOCK_SEGS rows
+
+	//send side
+	unsigned int sndBase;		//blocks of sent data are counted from here
+	unsigned int sndStart;		//first sequence number of the block being sent
+	unsigned int sndFirst;		//first sequence number XORed into sndAcc
+	unsigned int sndEnd;		//sequence number after the last byte XORed into sndAcc
+	int sndPending;			//1 if data was XORed into sndAcc since the last parity segment
+	unsigned int sndSegs;		//segments sent since the last parity segment
+	unsigned int parityEvery;	//a parity segment is sent after this many segments
+	unsigned int epochSegs;		//segments sent in this loss measurement epoch
+	unsigned int epochRtx;		//of them, retransmissions
+	unsigned int lossPct;		//smoothed percentage of segments retransmitted
+	char sndAcc[MAX_SEG_LEN];	//XOR of the block sent so far
+
+	//receive side
+	unsigned int rcvBase;		//blocks of received data are counted from here
+	fec_block_t rcv[FEC_RECV_BLOCKS];	//the newest blocks received
+} fec_t;
+
+//This function creates the FEC state of a stream whose sent data starts at sequence number
+//sndBase and received data at rcvBase, with rows of width bytes.
+fec_t* fec_create(unsigned int sndBase, unsigned int rcvBase, unsigned int width);
+
+//This function frees the FEC state.
+void fec_destroy(fec_t* fec);
+
+//This function XORs length bytes of data sent for the first time at sequence number seq into
+//the block being sent. Data must be sent in sequence order.
+//Returns 1 if a parity segment is due and was put in paritySeg, 0 otherwise.
+int fec_sent(fec_t* fec, unsigned int seq, const char* data, unsigned int length, seg_t* paritySeg);
+
+//This function puts a parity segment for the data sent since the last one in paritySeg, when
+//the sender has nothing more to send. Returns 1, or 0 if all data sent is covered already.
+int fec_flush(fec_t* fec, seg_t* paritySeg);
+
+//This function counts a segment sent, or retransmitted if rtx is 1, to measure the loss rate,
+//and sets how often parity segments are sent from it.
+void fec_count(fec_t* fec, int rtx);
+
+//This function XORs length bytes of data received for the first time at sequence number seq
+//into their blocks.
+void fec_received(fec_t* fec, unsigned int seq, const char* data, unsigned int length);
+
+//This function rebuilds the data [missStart, missEnd) from the parity segment, if it is the only
+//data of the segment's range not received yet. Returns 1 with the data in buf, or 0 if the
+//parity segment can't rebuild it.
+int fec_rebuild(fec_t* fec, seg_t* paritySeg, unsigned int missStart, unsigned int missEnd, char* buf);
+
+#endif
@@ -5,38 +5,129 @@
 #include <stdlib.h>
 #include <stdio.h>
 #include <sys/socket.h>
+#include <pthread.h>
+
+//length of a frame's nodeID, path and segment header, the part of a frame that is always sent
+#define SEGFRAME_HDR_LEN (2 * sizeof(int) + sizeof(srt_hdr_t))
+
+//serializes frames sent by different threads so they don't interleave on the connection
+static pthread_mutex_t sendMutex = PTHREAD_MUTEX_INITIALIZER;
+
+//sends !& nodeID path segment !# in a single send(). Only the used bytes of the segment data are sent.
+//returns 1 on success, -1 on failure
+static int sendsegframe(int conn, int nodeID, int path, seg_t* segPtr)
+{
+	char frame[2 + sizeof(sendseg_arg_t) + 2];
+	int len = 0;
+
+	frame[len++] = '!';
+	frame[len++] = '&';
+	memcpy(frame + len, &nodeID, sizeof(int));
+	len += sizeof(int);
+	memcpy(frame + len, &path, sizeof(int));
+	len += sizeof(int);
+	memcpy(frame + len, segPtr, sizeof(srt_hdr_t) + segPtr->header.length);
+	len += sizeof(srt_hdr_t) + segPtr->header.length;
+	frame[len++] = '!';
+	frame[len++] = '#';
+
+	char *bufPtr = frame;
+	pthread_mutex_lock(&sendMutex);
+	while (len > 0) {
+		int sent = send(conn, bufPtr, len, 0);
+		if (sent < 0) {
+			pthread_mutex_unlock(&sendMutex);
+			return -1;
+		}
+		bufPtr += sent;
+		len -= sent;
+	}
+	pthread_mutex_unlock(&sendMutex);
+	return 1;
+}
+
+//receives exactly len bytes from conn
+//returns 1 on success, -1 if the connection is closed
+static int recvn(int conn, void* buf, int len)
+{
+	char *bufPtr = (char *)buf;
+	while (len > 0) {
+		int received = recv(conn, bufPtr, len, 0);
+		if (received <= 0) {
+			return -1;
+		}
+		bufPtr += received;
+		len -= received;
+	}
+	return 1;
+}
+
+//receives one !& nodeID path segment !# frame sent by sendsegframe.
+//the header tells how many data bytes follow, so the frame is read with a few recv() calls
+//instead of one per byte. Frames that don't end in !# are dropped and we resync on the next !&.
+//returns 1 on success, -1 if the connection is closed
+static int recvsegframe(int conn, int* nodeID, int* path, seg_t* segPtr)
+{
+	char c;
+	char bufend[2];
+	// state can be 0,1
+	// 0 starting point
+	// 1 '!' received, a '&' starts a frame
+	int state = 0;
+	while (recv(conn, &c, 1, 0) > 0) {
+		if (state == 0) {
+			if (c == '!')
+				state = 1;
+			continue;
+		}
+		if (c != '&') {
+			state = (c == '!') ? 1 : 0;
+			continue;
+		}
+		state = 0;
+
+		char buf[SEGFRAME_HDR_LEN];
+		if (recvn(conn, buf, SEGFRAME_HDR_LEN) < 0) {
+			return -1;
+		}
+		memcpy(nodeID, buf, sizeof(int));
+		memcpy(path, buf + sizeof(int), sizeof(int));
+		memcpy(&segPtr->header, buf + 2 * sizeof(int), sizeof(srt_hdr_t));
+		if (segPtr->header.length > MAX_SEG_LEN) {
+			printf("Segment length %u too large. Dropping frame.\n", segPtr->header.length);
+			continue;
+		}
+		if (recvn(conn, segPtr->data, segPtr->header.length) < 0 || recvn(conn, bufend, 2) < 0) {
+			return -1;
+		}
+		if (bufend[0] != '!' || bufend[1] != '#') {
+			printf("Frame not terminated by !#. Dropping frame.\n");
+			continue;
+		}
+		return 1;
+	}
+	return -1;
+}
 
 //SRT process uses this function to send a segment and its destination node ID in a sendseg_arg_t structure
 // to SNP process to send out. 
 //Parameter network_conn is the TCP descriptor of the connection between the SRT process and the SNP process. 
 //Return 1 if a sendseg_arg_t is succefully sent, otherwise return -1.
 int snp_sendseg(int network_conn, int dest_nodeID, seg_t* segPtr)
+{
+	return snp_sendsegpath(network_conn, dest_nodeID, 0, segPtr);
+}
+
+//SRT process uses this function to send a segment like snp_sendseg, with a path hint: the SNP process
+//sends it on path number path to the destination, see getPathNextNode. Path 0 is the routing table's route.
+//Return 1 if a sendseg_arg_t is succefully sent, otherwise return -1.
+int snp_sendsegpath(int network_conn, int dest_nodeID, int path, seg_t* segPtr)
 {
 	//set checksum
   	segPtr->header.checksum = checksum(segPtr);
 
-  	//package into sendseg_arg_t
-  	sendseg_arg_t temp;
-  	temp.nodeID = dest_nodeID;
-  	temp.seg = *segPtr;
-
   	//send to SNP on network conn
-	char bufstart[2];
-	char bufend[2];
-	bufstart[0] = '!';
-	bufstart[1] = '&';
-	bufend[0] = '!';
-	bufend[1] = '#';
-	if (send(network_conn, bufstart, 2, 0) < 0) {
-		return -1;
-	}
-	if(send(network_conn,&temp,sizeof(sendseg_arg_t),0)<0) {
-		return -1;
-	}
-	if(send(network_conn,bufend,2,0)<0) {
-		return -1;
-	}
-	return 1;
+	return sendsegframe(network_conn, dest_nodeID, path, segPtr);
 }
 
 //SRT process uses this function to receive a  sendseg_arg_t structure which contains a segment and its 
@@ -46,137 +137,27 @@ int snp_sendseg(int network_conn, int dest_nodeID, seg_t* segPtr)
 //Return 1 if a sendseg_arg_t is succefully received, otherwise return -1.
 int snp_recvseg(int network_conn, int* src_nodeID, seg_t* segPtr)
 {
-	char buf[sizeof(sendseg_arg_t)+2];
-	char c;
-	int idx = 0;
-	// state can be 0,1,2,3; 
-	// 0 starting point 
-	// 1 '!' received
-	// 2 '&' received, start receiving segment
-	// 3 '!' received,
-	// 4 '#' received, finish receiving segment 
-	int state = 0;
-	while(recv(network_conn,&c,1,0)>0) {
-		if (state == 0) {
-		        if(c=='!')
-				state = 1;
+	int path;
+	while (recvsegframe(network_conn, src_nodeID, &path, segPtr) > 0) {
+		if (seglost(segPtr) > 0) {
+			continue;
 		}
-		else if(state == 1) {
-			if(c=='&') 
-				state = 2;
-			else
-				state = 0;
-		}
-		else if(state == 2) {
-			if(c=='!') {
-				buf[idx]=c;
-				idx++;
-				state = 3;
-			}
-			else {
-				buf[idx]=c;
-				idx++;
-			}
-		}
-		else if(state == 3) {
-			if(c=='#') {
-				buf[idx]=c;
-				idx++;
-				state = 0;
-				idx = 0;
-				sendseg_arg_t tempSendSegArgT;
-				memcpy(&tempSendSegArgT,buf,sizeof(sendseg_arg_t));
-				seg_t tempSeg = tempSendSegArgT.seg;
-
-				if(seglost(&tempSeg) > 0) {
-                	continue;
-                } else {
-                	if (checkchecksum(&tempSeg) < 0) {
-                		printf("Checksum failed! Dropping packet.\n");
-                		continue;
-                	}
-                }
-                memcpy(src_nodeID, &tempSendSegArgT.nodeID, sizeof(int));
-				memcpy(segPtr,&tempSeg,sizeof(seg_t));
-				return 1;
-			}
-			else if(c=='!') {
-				buf[idx]=c;
-				idx++;
-			}
-			else {
-				buf[idx]=c;
-				idx++;
-				state = 2;
-			}
+		if (checkchecksum(segPtr) < 0) {
+			printf("Checksum failed! Dropping packet.\n");
+			continue;
 		}
+		return 1;
 	}
 	return -1;
 }
 
-//SNP process uses this function to receive a sendseg_arg_t structure which contains a segment and its
-// destination node ID from the SRT process.
+//SNP process uses this function to receive a sendseg_arg_t structure which contains a segment, its
+// destination node ID and its path hint from the SRT process.
 //Parameter tran_conn is the TCP descriptor of the connection between the SRT process and the SNP process. 
 //Return 1 if a sendseg_arg_t is succefully received, otherwise return -1.
-int getsegToSend(int tran_conn, int* dest_nodeID, seg_t* segPtr)
+int getsegToSend(int tran_conn, int* dest_nodeID, int* path, seg_t* segPtr)
 {
-	char buf[sizeof(sendseg_arg_t)+2];
-	char c;
-	int idx = 0;
-	// state can be 0,1,2,3; 
-	// 0 starting point 
-	// 1 '!' received
-	// 2 '&' received, start receiving segment
-	// 3 '!' received,
-	// 4 '#' received, finish receiving segment 
-	int state = 0;
-	while(recv(tran_conn,&c,1,0)>0) {
-		if (state == 0) {
-		        if(c=='!')
-				state = 1;
-		}
-		else if(state == 1) {
-			if(c=='&') 
-				state = 2;
-			else
-				state = 0;
-		}
-		else if(state == 2) {
-			if(c=='!') {
-				buf[idx]=c;
-				idx++;
-				state = 3;
-			}
-			else {
-				buf[idx]=c;
-				idx++;
-			}
-		}
-		else if(state == 3) {
-			if(c=='#') {
-				buf[idx]=c;
-				idx++;
-				state = 0;
-				idx = 0;
-				sendseg_arg_t tempSendSegArgT;
-				memcpy(&tempSendSegArgT,buf,sizeof(sendseg_arg_t));
-				seg_t tempSeg = tempSendSegArgT.seg;
-                memcpy(dest_nodeID, &tempSendSegArgT.nodeID, sizeof(int));
-				memcpy(segPtr,&tempSeg,sizeof(seg_t));
-				return 1;
-			}
-			else if(c=='!') {
-				buf[idx]=c;
-				idx++;
-			}
-			else {
-				buf[idx]=c;
-				idx++;
-				state = 2;
-			}
-		}
-	}
-	return -1;
+	return recvsegframe(tran_conn, dest_nodeID, path, segPtr);
 }
 
 //SNP process uses this function to send a sendseg_arg_t structure which contains a segment and 
@@ -185,28 +166,7 @@ int getsegToSend(int tran_conn, int* dest_nodeID, seg_t* segPtr)
 //Return 1 if a sendseg_arg_t is succefully sent, otherwise return -1.
 int forwardsegToSRT(int tran_conn, int src_nodeID, seg_t* segPtr)
 {
-	//package into sendseg_arg_t
-  	sendseg_arg_t temp;
-  	temp.nodeID = src_nodeID;
-  	temp.seg = *segPtr;
-
-  	//send to SNP on network conn
-	char bufstart[2];
-	char bufend[2];
-	bufstart[0] = '!';
-	bufstart[1] = '&';
-	bufend[0] = '!';
-	bufend[1] = '#';
-	if (send(tran_conn, bufstart, 2, 0) < 0) {
-		return -1;
-	}
-	if(send(tran_conn,&temp,sizeof(sendseg_arg_t),0)<0) {
-		return -1;
-	}
-	if(send(tran_conn,bufend,2,0)<0) {
-		return -1;
-	}
-	return 1;
+	return sendsegframe(tran_conn, src_nodeID, 0, segPtr);
 }
 
 // for seglost(seg_t* segment):
@@ -240,20 +200,65 @@ int seglost(seg_t* segPtr) {
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
-//This function calculates checksum over the given segment.
-//The checksum is calculated over the segment header and segment data.
-//You should first clear the checksum field in segment header to be 0.
-//If the data has odd number of octets, add an 0 octets to calculate checksum.
-//Use 1s complement for checksum calculation.
-unsigned short checksum(seg_t* segment)
+//Copies the SYN options into the data field of a SYN or SYNACK segment and sets the segment length.
+void seg_putsynopt(seg_t* segPtr, srt_synopt_t* opt)
 {
-	segment->header.checksum = 0;
-	int count;
-	if (segment->header.type == DATA) {
-		count = sizeof(seg_t);
-	} else {
-		count = sizeof(srt_hdr_t);
+	memcpy(segPtr->data, opt, sizeof(srt_synopt_t));
+	segPtr->header.length = sizeof(srt_synopt_t);
+}
+
+//Reads the SYN options from a SYN or SYNACK segment.
+//Options the peer didn't send are filled in with their defaults.
+void seg_getsynopt(seg_t* segPtr, srt_synopt_t* opt)
+{
+	memset(opt, 0, sizeof(srt_synopt_t));
+	opt->mss = DEFAULT_MSS;
+	//peers that send fewer options send a prefix of srt_synopt_t
+	if (segPtr->header.length > 0) {
+		memcpy(opt, segPtr->data, min(segPtr->header.length, sizeof(srt_synopt_t)));
 	}
+	if (opt->mss == 0)
+		opt->mss = DEFAULT_MSS;
+	if (opt->mss > MAX_SEG_LEN)
+		opt->mss = MAX_SEG_LEN;
+}
+
+//Appends fast open data after the SYN options of a SYN segment and sets SYNOPT_DATA.
+//seg_putsynopt must be called first. Returns the number of bytes that fit into the segment.
+unsigned int seg_putsyndata(seg_t* segPtr, void* data, unsigned int length)
+{
+	srt_synopt_t* opt = (srt_synopt_t*)segPtr->data;
+	unsigned int room = MAX_SEG_LEN - sizeof(srt_synopt_t);
+	if (length > room)
+		length = room;
+	if (length == 0)
+		return 0;
+	memcpy(segPtr->data + sizeof(srt_synopt_t), data, length);
+	segPtr->header.length = sizeof(srt_synopt_t) + length;
+	opt->flags |= SYNOPT_DATA;
+	return length;
+}
+
+//Returns the fast open data of a SYN segment and stores its length in *length,
+//or returns NULL if the SYN carries no data.
+char* seg_getsyndata(seg_t* segPtr, unsigned int* length)
+{
+	srt_synopt_t opt;
+	*length = 0;
+	if (segPtr->header.length <= sizeof(srt_synopt_t))
+		return NULL;
+	memcpy(&opt, segPtr->data, sizeof(srt_synopt_t));
+	if (!(opt.flags & SYNOPT_DATA))
+		return NULL;
+	*length = segPtr->header.length - sizeof(srt_synopt_t);
+	return segPtr->data + sizeof(srt_synopt_t);
+}
+
+//1s complement sum over the segment header and the header.length bytes of segment data.
+//If the data has odd number of octets, the last octet is padded with a 0 octet.
+static unsigned short segsum(seg_t* segment)
+{
+	int count = sizeof(srt_hdr_t) + min(segment->header.length, MAX_SEG_LEN);
 	/* Compute Internet Checksum for "count" bytes
 	*         beginning at location "addr". From the RFC the assignment page linked to
 	*/
@@ -268,14 +273,23 @@ unsigned short checksum(seg_t* segment)
 
 	   /*  Add left-over byte, if any */
 	if( count > 0 )
-	       sum += *(unsigned int *)buf;
+	       sum += *(unsigned char *)buf;
 
 	   /*  Fold 32-bit sum to 16 bits */
 	   sum = (sum & 0xFFFF) + (sum >> 16);
 	   sum += sum >> 16;
-	
-	//printf("checksum: %hu for data %s\n", (unsigned short)~sum, segment->data);
-	return (unsigned short)~sum;
+	return (unsigned short)sum;
+}
+
+//This function calculates checksum over the given segment.
+//The checksum is calculated over the segment header and the header.length bytes of segment data.
+//You should first clear the checksum field in segment header to be 0.
+//If the data has odd number of octets, add an 0 octets to calculate checksum.
+//Use 1s complement for checksum calculation.
+unsigned short checksum(seg_t* segment)
+{
+	segment->header.checksum = 0;
+	return (unsigned short)~segsum(segment);
 }
 
 //Check the checksum in the segment,
@@ -283,33 +297,10 @@ unsigned short checksum(seg_t* segment)
 //return -1 if the checksum is invalid
 int checkchecksum(seg_t* segment)
 {
-		int count;
-	if (segment->header.type == DATA) {
-		count = sizeof(seg_t);
-	} else {
-		count = sizeof(srt_hdr_t);
-	}
-	/* Compute Internet Checksum for "count" bytes
-	*         beginning at location "addr". From the RFC the assignment page linked to
-	*/
-	unsigned short *buf = (unsigned short *)segment;
-	unsigned long sum = 0;
-
-	while( count > 1 )  {
-	   /*  This is the inner loop */
-	       sum += *(buf++);
-	       count -= 2;
+	if (segment->header.length > MAX_SEG_LEN) {
+		return -1;
 	}
-
-	   /*  Add left-over byte, if any */
-	if( count > 0 )
-	       sum += *(unsigned int *)buf<<8;
-
-	   /*  Fold 32-bit sum to 16 bits */
-	   sum = (sum & 0xFFFF) + (sum >> 16);
-	   sum += sum >> 16;
-	printf("\nChecksum: %s for data: %s\n",((unsigned short)~sum == 0) ? "valid" : "NOT valid", segment->data);
-	if ((unsigned short)~sum == 0){
+	if ((unsigned short)~segsum(segment) == 0){
 		return 1;
 	} else {
 		return -1;
@@ -21,6 +21,8 @@
 #define	FINACK 3
 #define	DATA 4
 #define	DATAACK 5
+#define	DATAFEC 6
+#define	DGRAM 7
 
 //segment header definition. 
 
@@ -29,25 +31,70 @@ typedef struct srt_hdr {
 	unsigned int dest_port;       //destination port number
 	unsigned int seq_num;         //sequence number
 	unsigned int ack_num;         //ack number
+	unsigned int tsval;           //timestamp of the sender in milliseconds, if SYNOPT_TIMESTAMP was agreed
+	unsigned int tsecr;           //latest tsval received from the peer, echoed back
 	unsigned short int length;    //segment data length
 	unsigned short int  type;     //segment type
-	unsigned short int  rcv_win;  //currently not used
+	unsigned short int  rcv_win;  //free space in the sender's receive buffer, in units of 1 << RCV_WIN_SHIFT bytes
 	unsigned short int checksum;  //checksum for this segment
+	unsigned short int flags;     //SEG_ flags
 } srt_hdr_t;
 
+//flags of the segment header
+#define SEG_EOR 0x1	//DATA: the segment ends a message of a SRT_SEQPACKET connection
+#define SEG_SEQ 0x2	//DGRAM: seq_num numbers the datagrams of the sender, see dgram.h
+
+//serial number arithmetic for sequence numbers and timestamps: a is before b if b is less
+//than half the 32-bit number space ahead of a, so comparisons keep working when they wrap around
+#define SEQ_LT(a, b) ((int)((unsigned int)(a) - (unsigned int)(b)) < 0)
+#define SEQ_LEQ(a, b) ((int)((unsigned int)(a) - (unsigned int)(b)) <= 0)
+#define SEQ_GT(a, b) SEQ_LT(b, a)
+#define SEQ_GEQ(a, b) SEQ_LEQ(b, a)
+
+//Maximum segment length. A segment header plus MAX_SEG_LEN bytes of data fill one SNP packet.
+#define MAX_SEG_LEN (MAX_PKT_LEN - (int)sizeof(srt_hdr_t))
+
 //segment definition
+//the data field is sized for the largest segment, but only header.length bytes of it are sent
 
 typedef struct segment {
 	srt_hdr_t header;
 	char data[MAX_SEG_LEN];
 } seg_t;
 
+//flags of the SYN options
+#define SYNOPT_COOKIE_REQ 0x1	//SYN: the client asks for a fast open cookie
+#define SYNOPT_COOKIE 0x2	//SYN, SYNACK: the cookie field holds a fast open cookie
+#define SYNOPT_DATA 0x4		//SYN: fast open data follows the options. SYNACK: the server accepted it
+#define SYNOPT_TIMESTAMP 0x8	//SYN: the client stamps its segments. SYNACK: both ends stamp them
+#define SYNOPT_FEC 0x10	//SYN: the client wants forward error correction. SYNACK: both ends send parity segments
+#define SYNOPT_SEQPACKET 0x20	//SYN, SYNACK: the socket is SRT_SEQPACKET, only a socket of the same type accepts the SYN
+
+//options carried in the data field of SYN and SYNACK segments.
+//the client announces the largest segment it wants to use, the server answers with the
+//MSS both ends agreed on. A peer that sends no options is treated as using DEFAULT_MSS.
+//With fast open, a SYN carrying the cookie the server handed out in an earlier SYNACK
+//may carry data after the options, which the server delivers without waiting for a round trip.
+//With timestamps, DATA and DATAACK segments carry tsval and tsecr, and segments stamped
+//before the newest one received are dropped as left over from an earlier wrap of the sequence space.
+//With FEC, each end also sends DATAFEC parity segments of its data, see fec.h.
+//On SRT_SEQPACKET connections, the last DATA segment of each message is flagged SEG_EOR, and fast
+//open data is only sent if the whole message fits in the SYN.
+typedef struct srt_synopt {
+	unsigned short int mss;       //maximum segment data length
+	unsigned short int flags;     //SYNOPT_ flags
+	unsigned int cookie;          //fast open cookie, valid if SYNOPT_COOKIE is set
+} srt_synopt_t;
+
 //This is the data structure exchanged between the SNP process and the SRT process.
 //It contains a node ID and a segment. 
 //For snp_sendseg(), the node ID is the destination node ID of the segment.
 //For snp_recvseg(), the node ID is the source node ID of the segment.
+//On the TCP connection a sendseg_arg_t is sent as !& nodeID path segment-header data !#,
+//where only the header.length used bytes of the data field are sent.
 typedef struct sendsegargument {
 	int nodeID;		//node ID 
+	int path;		//path hint of a segment sent, 0 for the routing table's route; 0 for a segment received
 	seg_t seg;		//a segment 
 } sendseg_arg_t;
 
@@ -56,16 +103,21 @@ typedef struct sendsegargument {
 //Return 1 if a sendseg_arg_t is succefully sent, otherwise return -1.
 int snp_sendseg(int network_conn, int dest_nodeID, seg_t* segPtr);
 
+//SRT process uses this function to send a segment like snp_sendseg, with a path hint: the SNP process
+//sends it on path number path to the destination, see getPathNextNode. Path 0 is the routing table's route.
+//Return 1 if a sendseg_arg_t is succefully sent, otherwise return -1.
+int snp_sendsegpath(int network_conn, int dest_nodeID, int path, seg_t* segPtr);
+
 //SRT process uses this function to receive a  sendseg_arg_t structure which contains a segment and its src node ID from the SNP process. 
 //Parameter network_conn is the TCP descriptor of the connection between the SRT process and the SNP process. 
 //When a segment is received, use seglost to determine if the segment should be discarded, also check the checksum.  
 //Return 1 if a sendseg_arg_t is succefully received, otherwise return -1.
 int snp_recvseg(int network_conn, int* src_nodeID, seg_t* segPtr);
 
-//SNP process uses this function to receive a sendseg_arg_t structure which contains a segment and its destination node ID from the SRT process.
+//SNP process uses this function to receive a sendseg_arg_t structure which contains a segment, its destination node ID and its path hint from the SRT process.
 //Parameter tran_conn is the TCP descriptor of the connection between the SRT process and the SNP process. 
 //Return 1 if a sendseg_arg_t is succefully received, otherwise return -1.
-int getsegToSend(int tran_conn, int* dest_nodeID, seg_t* segPtr); 
+int getsegToSend(int tran_conn, int* dest_nodeID, int* path, seg_t* segPtr); 
 
 //SNP process uses this function to send a sendseg_arg_t structure which contains a segment and its src node ID to the SRT process.
 //Parameter tran_conn is the TCP descriptor of the connection between the SRT process and the SNP process. 
@@ -79,11 +131,26 @@ int forwardsegToSRT(int tran_conn, int src_nodeID, seg_t* segPtr);
 // Even the segment is not lost, the packet has PKT_LOST_RATE/2 probability to have invalid checksum
 // We flip  a random bit in the segment to create invalid checksum
 int seglost(seg_t* segPtr); 
+
+//Copies the SYN options into the data field of a SYN or SYNACK segment and sets the segment length.
+void seg_putsynopt(seg_t* segPtr, srt_synopt_t* opt);
+
+//Reads the SYN options from a SYN or SYNACK segment.
+//Options the peer didn't send are filled in with their defaults.
+void seg_getsynopt(seg_t* segPtr, srt_synopt_t* opt);
+
+//Appends fast open data after the SYN options of a SYN segment and sets SYNOPT_DATA.
+//seg_putsynopt must be called first. Returns the number of bytes that fit into the segment.
+unsigned int seg_putsyndata(seg_t* segPtr, void* data, unsigned int length);
+
+//Returns the fast open data of a SYN segment and stores its length in *length,
+//or returns NULL if the SYN carries no data.
+char* seg_getsyndata(seg_t* segPtr, unsigned int* length);
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 
 //This function calculates checksum over the given segment.
-//The checksum is calculated over the segment header and segment data.
+//The checksum is calculated over the segment header and the header.length bytes of segment data.
 //You should first clear the checksum field in segment header to be 0.
 //If the data has odd number of octets, add an 0 octets to calculate checksum.
 //Use 1s complement for checksum calculation.
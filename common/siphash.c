@@ -0,0 +1,89 @@
+//FILE: common/siphash.c
+//
+//Description: this file implements the keyed hash shared by the SRT client and server.
+//
+//Date: October 19, 2026
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include "timer.h"
+#include "siphash.h"
+
+#define ROTL(x, b) (uint64_t)(((x) << (b)) | ((x) >> (64 - (b))))
+
+//one SipRound over the state v[4]
+static void sipround(uint64_t v[4])
+{
+	v[0] += v[1]; v[1] = ROTL(v[1], 13); v[1] ^= v[0]; v[0] = ROTL(v[0], 32);
+	v[2] += v[3]; v[3] = ROTL(v[3], 16); v[3] ^= v[2];
+	v[0] += v[3]; v[3] = ROTL(v[3], 21); v[3] ^= v[0];
+	v[2] += v[1]; v[1] = ROTL(v[1], 17); v[1] ^= v[2]; v[2] = ROTL(v[2], 32);
+}
+
+//reads 8 bytes of data as a little-endian word
+static uint64_t sipload(const unsigned char* p)
+{
+	uint64_t word = 0;
+	for (int i = 7; i >= 0; i--) {
+		word = (word << 8) | p[i];
+	}
+	return word;
+}
+
+//This function fills the key with random bits from /dev/urandom. If it can't be read, the
+//key is derived from the time and the process ID, which is guessable, and a warning is printed.
+void siphash_keygen(siphash_key_t* key)
+{
+	int fd = open("/dev/urandom", O_RDONLY);
+	if (fd >= 0) {
+		ssize_t got = read(fd, key, sizeof(siphash_key_t));
+		close(fd);
+		if (got == sizeof(siphash_key_t)) {
+			return;
+		}
+	}
+	printf("Couldn't read /dev/urandom. Keying the hash with the time, it can be guessed.\n");
+	key->k0 = timer_now_ns();
+	key->k1 = ((uint64_t)getpid() << 32) ^ (uint64_t)(size_t)key;
+}
+
+//This function returns the SipHash-2-4 of length bytes of data under the key.
+uint64_t siphash(const siphash_key_t* key, const void* data, size_t length)
+{
+	const unsigned char* p = (const unsigned char*)data;
+	uint64_t v[4];
+	v[0] = key->k0 ^ 0x736f6d6570736575ULL;
+	v[1] = key->k1 ^ 0x646f72616e646f6dULL;
+	v[2] = key->k0 ^ 0x6c7967656e657261ULL;
+	v[3] = key->k1 ^ 0x7465646279746573ULL;
+
+	//the whole words
+	size_t end = length - length % 8;
+	for (size_t i = 0; i < end; i += 8) {
+		uint64_t m = sipload(p + i);
+		v[3] ^= m;
+		sipround(v);
+		sipround(v);
+		v[0] ^= m;
+	}
+
+	//the last bytes, padded, with the length in the top byte
+	unsigned char last[8];
+	memset(last, 0, sizeof(last));
+	memcpy(last, p + end, length % 8);
+	last[7] = (unsigned char)length;
+	uint64_t m = sipload(last);
+	v[3] ^= m;
+	sipround(v);
+	sipround(v);
+	v[0] ^= m;
+
+	v[2] ^= 0xff;
+	sipround(v);
+	sipround(v);
+	sipround(v);
+	sipround(v);
+	return v[0] ^ v[1] ^ v[2] ^ v[3];
+}
@@ -0,0 +1,28 @@
+//FILE: common/siphash.h
+//
+//Description: this file defines the keyed hash shared by the SRT client and server for the
+//values a peer must not be able to guess: initial sequence numbers and fast open cookies.
+//It is SipHash-2-4, keyed with 128 random bits read from /dev/urandom.
+//
+//Date: October 19, 2026
+
+#ifndef SIPHASH_H
+#define SIPHASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+//a secret key of the hash
+typedef struct siphash_key {
+	uint64_t k0;
+	uint64_t k1;
+} siphash_key_t;
+
+//This function fills the key with random bits from /dev/urandom. If it can't be read, the
+//key is derived from the time and the process ID, which is guessable, and a warning is printed.
+void siphash_keygen(siphash_key_t* key);
+
+//This function returns the SipHash-2-4 of length bytes of data under the key.
+uint64_t siphash(const siphash_key_t* key, const void* data, size_t length);
+
+#endif
@@ -0,0 +1,1709 @@
+//FILE: common/stream.c
+//
+//Description: this file implements the data transfer of SRT connections, shared by the SRT client and server.
+//
+//Date: October 19, 2026
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "constants.h"
+#include "bufpool.h"
+#include "siphash.h"
+#include "stream.h"
+
+static int stream_sendmax(stream_t* stream);
+
+static pthread_once_t isnOnce = PTHREAD_ONCE_INIT;
+static siphash_key_t isnKey;		//secret key the initial sequence numbers are derived from
+
+//chooses isnKey, called once
+static void stream_isninit()
+{
+	siphash_keygen(&isnKey);
+}
+
+//returns the current time of the timestamp clock, which ticks every millisecond
+static unsigned int stream_tsnow()
+{
+	return (unsigned int)(timer_now_ns() / 1000000);
+}
+
+//returns the pacing rate of the stream in bytes per second, 0 if transmissions are not paced.
+//stream->mutex must be held
+static unsigned long stream_pacingrate(stream_t* stream)
+{
+	if (!stream->pacing) {
+		return 0;
+	}
+	if (stream->pacingRate > 0) {
+		return stream->pacingRate;
+	}
+	if (stream->srtt == 0) {
+		return 0;
+	}
+	//a full window per round trip, with some headroom so the pacer doesn't limit the window
+	unsigned long windowBytes = (unsigned long)GBN_WINDOW * (stream->mss + sizeof(srt_hdr_t));
+	return windowBytes * PACING_GAIN_PERCENT * 10000 / stream->srtt;
+}
+
+//returns 1 if the unsent segBuf must be held back to be coalesced with later writes: it is a
+//partial tail segment that wasn't pushed, and the stream is corked or in coalescing mode with
+//unAcked data outstanding. stream->mutex must be held
+static int stream_held(stream_t* stream, segBuf_t* segBuf)
+{
+	if (segBuf != stream->sendBufTail || segBuf->seg.header.length >= stream->mss) {
+		return 0;
+	}
+	//a segment going out again after a timeout was pushed already
+	if (segBuf->sentTime != 0) {
+		return 0;
+	}
+	if (SEQ_LT(segBuf->seg.header.seq_num, stream->pushSeq)) {
+		return 0;
+	}
+	//a segment ending a message doesn't take later writes, only the cork holds it back
+	if (segBuf->seg.header.flags & SEG_EOR) {
+		return stream->corked;
+	}
+	return stream->corked || (stream->coalesce && stream->unAck_segNum > 0);
+}
+
+static unsigned int stream_recvlen(stream_t* stream);
+
+//returns the free space of the receive buffer as advertised in rcv_win, rounded down to whole
+//units. Only recvBufTarget bytes of the buffer are offered, and half of them under memory
+//pressure, so a buffer can shrink once the peer used up the window it was offered before.
+//stream->mutex must be held
+static unsigned int stream_rcvwin(stream_t* stream)
+{
+	unsigned int bufLen = stream->recvBufTarget;
+	if (bufLen > RECV_BUF_MIN && bufpool_pressure()) {
+		bufLen /= 2;
+	}
+	unsigned int usedLen = stream_recvlen(stream);
+	unsigned int freeLen = (bufLen > usedLen) ? bufLen - usedLen : 0;
+	return min(freeLen >> RCV_WIN_SHIFT, 0xffff) << RCV_WIN_SHIFT;
+}
+
+//puts the cumulative ACK of the receive side, its window and the timestamps in the segment. The segment
+//acknowledges everything received so far, so the delayed-ACK state is reset. stream->mutex must be held
+static void stream_putack(stream_t* stream, seg_t* segPtr)
+{
+	segPtr->header.ack_num = stream->expect_seqNum;
+	stream->advWin = stream_rcvwin(stream);
+	segPtr->header.rcv_win = stream->advWin >> RCV_WIN_SHIFT;
+	//the peer keeps the furthest edge it was told about
+	if (SEQ_GT(stream->expect_seqNum + stream->advWin, stream->rcvWndEdge)) {
+		stream->rcvWndEdge = stream->expect_seqNum + stream->advWin;
+	}
+	if (stream->timestamps) {
+		segPtr->header.tsval = stream_tsnow();
+		segPtr->header.tsecr = stream->tsRecent;
+	}
+	stream->unAckedSegs = 0;
+	stream->gapPending = 0;
+	timer_cancel(&stream->delAckTimer);
+}
+
+//sends a DATAACK for everything received in order so far. stream->mutex must be held
+//returns 1 for success or -1 for failure
+static int stream_sendack(stream_t* stream)
+{
+	//create DATAACK seg_t
+	seg_t dataAckSeg;
+	memset(&dataAckSeg, 0, sizeof(srt_hdr_t));
+	dataAckSeg.header.src_port = stream->localPort;
+	dataAckSeg.header.dest_port = stream->remotePort;
+	dataAckSeg.header.type = DATAACK;
+	dataAckSeg.header.seq_num = stream->next_seqNum;
+	stream_putack(stream, &dataAckSeg);
+
+	//send DATAACK seg_t
+	printf("Sending DATAACK with expect_seqNum %u.\n", dataAckSeg.header.ack_num);
+	return (txsched_send(stream->sched, stream->txFlow, stream->remoteNode, &dataAckSeg) < 0) ? -1 : 1;
+}
+
+//frees a segment taken out of the send buffer, and unmaps the file chunk it was sent from once
+//no other segment needs it. stream->mutex must be held
+static void stream_freesegbuf(stream_t* stream, segBuf_t* segBuf)
+{
+	filechunk_t *chunk = segBuf->chunk;
+	if (chunk != NULL && --chunk->segs == 0) {
+		munmap(chunk->addr, chunk->mapLen);
+		free(chunk);
+		stream->fileChunks--;
+		pthread_cond_broadcast(&stream->drainCond);
+	}
+	free(segBuf);
+}
+
+//sends the DATAFEC segment the FEC layer filled in paritySeg. It carries no ACK, ack_num holds
+//the end of the data it covers. stream->mutex must be held
+//returns 1 for success or -1 for failure
+static int stream_sendparity(stream_t* stream, seg_t* paritySeg)
+{
+	paritySeg->header.src_port = stream->localPort;
+	paritySeg->header.dest_port = stream->remotePort;
+	if (stream->timestamps) {
+		paritySeg->header.tsval = stream_tsnow();
+		paritySeg->header.tsecr = stream->tsRecent;
+	}
+	printf("Sending DATAFEC for seq_nums %u to %u.\n", paritySeg->header.seq_num, paritySeg->header.ack_num);
+	return (txsched_send(stream->sched, stream->txFlow, stream->remoteNode, paritySeg) < 0) ? -1 : 1;
+}
+
+//returns the cost of sending a segment on path p: its smoothed RTT, or the stream's until it has
+//one, raised by two percent for every percent of its segments lost. stream->mutex must be held
+static unsigned long stream_pathcost(stream_t* stream, unsigned int p)
+{
+	srt_path_t *path = &stream->path[p];
+	unsigned long rtt = path->srtt ? path->srtt : stream->srtt;
+	if (rtt == 0) {
+		rtt = DATA_TIMEOUT;
+	}
+	return rtt * (100 + 2 * path->lossPct) / 100;
+}
+
+//picks the path segBuf is sent on. New segments are spread over the paths in inverse proportion
+//to their cost: each goes to the path it would be done on first in virtual time. A retransmission
+//goes to the cheapest path other than the one it was lost on, which is charged with the loss.
+//stream->mutex must be held
+static unsigned int stream_pickpath(stream_t* stream, segBuf_t* segBuf)
+{
+	if (stream->paths <= 1) {
+		return 0;
+	}
+	int rtx = segBuf->retransmitted;
+	if (rtx && segBuf->path < stream->paths) {
+		stream->path[segBuf->path].lost++;
+	}
+	unsigned int best = 0;
+	unsigned long bestKey = 0;
+	for (unsigned int p = 0; p < stream->paths; p++) {
+		if (rtx && p == segBuf->path) {
+			continue;
+		}
+		unsigned long key = stream_pathcost(stream, p) + (rtx ? 0 : stream->path[p].vtime);
+		if (key < bestKey || bestKey == 0) {
+			best = p;
+			bestKey = key;
+		}
+	}
+
+	srt_path_t *path = &stream->path[best];
+	if (!rtx) {
+		path->vtime = bestKey;
+	}
+	if (++path->sent >= MULTIPATH_LOSS_EPOCH) {
+		path->lossPct = (3 * path->lossPct + min(path->lost, path->sent) * 100 / path->sent) / 4;
+		printf("Path %u: srtt %lu us, %u%% of its segments lost.\n", best, path->srtt, path->lossPct);
+		path->sent = 0;
+		path->lost = 0;
+	}
+	return best;
+}
+
+//sends the segment of segBuf, carrying the ACK of the receive side. With FEC, a segment sent for
+//the first time goes into the parity, which follows it when due. stream->mutex must be held
+//returns 1 for success or -1 for failure
+static int stream_xmit(stream_t* stream, segBuf_t* segBuf)
+{
+	stream_putack(stream, &segBuf->seg);
+	const char *data = (segBuf->chunk != NULL) ? segBuf->fileData : segBuf->seg.data;
+	segBuf->path = stream_pickpath(stream, segBuf);
+	if (txsched_senddata(stream->sched, stream->txFlow, stream->remoteNode, segBuf->path, &segBuf->seg.header, data) < 0) {
+		return -1;
+	}
+	if (stream->fec != NULL) {
+		seg_t paritySeg;
+		fec_count(stream->fec, segBuf->retransmitted);
+		if (!segBuf->retransmitted
+			&& fec_sent(stream->fec, segBuf->seg.header.seq_num, data, segBuf->seg.header.length, &paritySeg)
+			&& stream_sendparity(stream, &paritySeg) < 0) {
+			printf("Error sending DATAFEC seg_t.\n");
+		}
+	}
+	return 1;
+}
+
+//frees the segments in the send buffer below the peer's cumulative ACK, takes an RTT sample
+//and restarts the retransmission timer for the oldest unAcked segment. stream->mutex must be held
+//returns 1 if the ACK freed any segments, 0 if it Acked nothing new
+static int stream_ack(stream_t* stream, unsigned int ack)
+{
+	segBuf_t *tempSegBuf;
+	unsigned long now = timer_now_ns() / NS_TO_MICROSECONDS;
+	unsigned long rttSample = 0;
+	int acked = 0;
+
+	//free acked segBufs from send buffer
+	while (stream->sendBufHead != NULL && SEQ_LEQ(stream->sendBufHead->seg.header.seq_num + stream->sendBufHead->seg.header.length, ack)) {
+		tempSegBuf = stream->sendBufHead;
+		stream->sendBufHead = stream->sendBufHead->next;
+		//keep sendBufunSent valid if the peer Acks data we haven't counted as sent
+		if (tempSegBuf == stream->sendBufunSent) {
+			stream->sendBufunSent = stream->sendBufHead;
+		} else {
+			stream->unAck_segNum--;
+		}
+		//only segments sent once tell which transmission was acked
+		if (!tempSegBuf->retransmitted && tempSegBuf->sentTime != 0) {
+			rttSample = now - tempSegBuf->sentTime;
+			srt_path_t *path = &stream->path[tempSegBuf->path];
+			path->srtt = path->srtt ? (7 * path->srtt + rttSample) / 8 : rttSample;
+		}
+		printf("Freed seq_num %u\n", tempSegBuf->seg.header.seq_num);
+		stream_freesegbuf(stream, tempSegBuf);
+		acked = 1;
+	}
+	if (stream->sendBufHead == NULL) {
+		stream->sendBufTail = NULL;
+		pthread_cond_broadcast(&stream->drainCond);
+	}
+	if (rttSample > 0) {
+		stream->srtt = stream->srtt ? (7 * stream->srtt + rttSample) / 8 : rttSample;
+	}
+
+	//restart the retransmission timer for the oldest unAcked segment
+	if (stream->unAck_segNum > 0) {
+		unsigned long deadline = stream->sendBufHead->sentTime + DATA_TIMEOUT;
+		timer_arm(&stream->sendBufTimer, (deadline > now) ? (deadline - now) * NS_TO_MICROSECONDS : 0);
+	} else {
+		timer_cancel(&stream->sendBufTimer);
+	}
+	return acked;
+}
+
+//resends the oldest unAcked segment, which the peer is missing while it keeps the ones after it
+//for reassembly, and restarts the retransmission timer for it. stream->mutex must be held
+static void stream_rtxhead(stream_t* stream)
+{
+	segBuf_t *segBuf = stream->sendBufHead;
+	segBuf->retransmitted = 1;
+	segBuf->sentTime = timer_now_ns() / NS_TO_MICROSECONDS;
+	if (stream_xmit(stream, segBuf) < 0) {
+		printf("Error sending seg_t with seq_num %u.\n", segBuf->seg.header.seq_num);
+	}
+	timer_arm(&stream->sendBufTimer, (unsigned long)DATA_TIMEOUT * NS_TO_MICROSECONDS);
+}
+
+//starts recovering from the loss of the oldest unAcked segment: resends it, and until the peer
+//Acks everything sent so far, resends the next missing one on each partial ACK. stream->mutex must be held
+static void stream_recover(stream_t* stream)
+{
+	stream->recovering = 1;
+	stream->recoverSeq = (stream->sendBufunSent != NULL) ? stream->sendBufunSent->seg.header.seq_num : stream->next_seqNum;
+	stream->dupAcks = 0;
+	stream_rtxhead(stream);
+}
+
+//detects lost segments from the ACKs: DUPACK_THRESHOLD DATAACKs that Ack nothing new and don't
+//move the window mean later segments arrived without the oldest unAcked one, which is fast
+//retransmitted. acked tells if the segment's ACK freed any segments, windowMoved if it moved
+//the peer's window. stream->mutex must be held
+static void stream_lossdetect(stream_t* stream, seg_t* segPtr, int acked, int windowMoved)
+{
+	if (acked) {
+		stream->dupAcks = 0;
+		if (stream->recovering) {
+			if (stream->unAck_segNum == 0 || SEQ_GEQ(segPtr->header.ack_num, stream->recoverSeq)) {
+				stream->recovering = 0;
+			} else {
+				//a partial ACK: the peer is missing the next segment, too
+				printf("Partial ACK. Retransmitting seq_num %u.\n", stream->sendBufHead->seg.header.seq_num);
+				stream_rtxhead(stream);
+			}
+		}
+		return;
+	}
+	if (segPtr->header.type != DATAACK || windowMoved || stream->unAck_segNum == 0) {
+		return;
+	}
+	stream->dupAcks++;
+	//segments striped over several paths arrive out of order without being lost
+	if (stream->dupAcks == DUPACK_THRESHOLD + stream->paths - 1 && !stream->recovering) {
+		printf("%u duplicate ACKs. Fast retransmitting seq_num %u.\n", stream->dupAcks, stream->sendBufHead->seg.header.seq_num);
+		stream_recover(stream);
+	}
+}
+
+//copies length bytes of data received at sequence number seq, inside the receive window, to
+//their place in the ring, after the in-order data. stream->mutex must be held
+static void stream_ringput(stream_t* stream, unsigned int seq, char* data, unsigned int length)
+{
+	unsigned int tail = atomic_load_explicit(&stream->recvTail, memory_order_relaxed);
+	unsigned int offset = (tail + (seq - stream->expect_seqNum)) & (stream->recvBufSize - 1);
+	unsigned int firstLen = min(length, stream->recvBufSize - offset);
+
+	//the data may wrap around the end of the ring
+	memcpy(stream->recvBuf + offset, data, firstLen);
+	memcpy(stream->recvBuf, data + firstLen, length - firstLen);
+}
+
+//marks the byte of the ring at counter as the last one of a message. stream->mutex must be held
+static void stream_eorset(stream_t* stream, unsigned int counter)
+{
+	unsigned int offset = counter & (stream->recvBufSize - 1);
+	atomic_fetch_or_explicit(&stream->recvEor[offset >> 3], 1 << (offset & 7), memory_order_relaxed);
+}
+
+//clears the marks of the length bytes of the ring from counter on, a whole byte of the bitmap at
+//a time where they cover it. The writer only marks bytes beyond them meanwhile
+static void stream_eorclear(stream_t* stream, unsigned int counter, unsigned int length)
+{
+	while (length > 0) {
+		unsigned int offset = counter & (stream->recvBufSize - 1);
+		unsigned int bit = offset & 7;
+		unsigned int n = min(length, 8 - bit);
+		if (n == 8) {
+			atomic_store_explicit(&stream->recvEor[offset >> 3], 0, memory_order_relaxed);
+		} else {
+			atomic_fetch_and_explicit(&stream->recvEor[offset >> 3], (unsigned char)~(((1u << n) - 1) << bit), memory_order_relaxed);
+		}
+		counter += n;
+		length -= n;
+	}
+}
+
+//returns the counter of the first byte of the ring in [from, to) that ends a message, or to if
+//none does. Bytes below recvTail were marked before it was stored with release
+static unsigned int stream_eorfind(stream_t* stream, unsigned int from, unsigned int to)
+{
+	while (from != to) {
+		unsigned int offset = from & (stream->recvBufSize - 1);
+		unsigned int bits = atomic_load_explicit(&stream->recvEor[offset >> 3], memory_order_relaxed) >> (offset & 7);
+		if (bits != 0) {
+			unsigned int skip = __builtin_ctz(bits);
+			return (skip < to - from) ? from + skip : to;
+		}
+		unsigned int skip = 8 - (offset & 7);
+		if (skip >= to - from) {
+			return to;
+		}
+		from += skip;
+	}
+	return to;
+}
+
+//records [start, end) as received out of order, merged with the ranges it overlaps or touches.
+//returns 1, or 0 if it would take more than REASM_MAX_RANGES ranges. stream->mutex must be held
+static int stream_reasmadd(stream_t* stream, unsigned int start, unsigned int end)
+{
+	reasm_range_t *reasm = stream->reasm;
+	unsigned int first = 0;
+	while (first < stream->reasmCount && SEQ_LT(reasm[first].end, start)) {
+		first++;
+	}
+	unsigned int last = first;
+	while (last < stream->reasmCount && SEQ_LEQ(reasm[last].start, end)) {
+		if (SEQ_LT(reasm[last].start, start)) {
+			start = reasm[last].start;
+		}
+		if (SEQ_GT(reasm[last].end, end)) {
+			end = reasm[last].end;
+		}
+		last++;
+	}
+
+	//ranges first to last - 1 become one, or a new one is inserted at first
+	if (last == first) {
+		if (stream->reasmCount == REASM_MAX_RANGES) {
+			return 0;
+		}
+		memmove(&reasm[first + 1], &reasm[first], (stream->reasmCount - first) * sizeof(reasm_range_t));
+		stream->reasmCount++;
+	} else if (last > first + 1) {
+		memmove(&reasm[first + 1], &reasm[last], (stream->reasmCount - last) * sizeof(reasm_range_t));
+		stream->reasmCount -= last - first - 1;
+	}
+	reasm[first].start = start;
+	reasm[first].end = end;
+	return 1;
+}
+
+//XORs the bytes of [seq, end) not received before, those the reassembly ranges don't hold yet,
+//into the FEC blocks. seq is at or after expect_seqNum. stream->mutex must be held
+static void stream_fecadd(stream_t* stream, unsigned int seq, char* data, unsigned int end)
+{
+	unsigned int cur = seq;
+	for (unsigned int i = 0; i < stream->reasmCount && SEQ_LT(cur, end); i++) {
+		reasm_range_t *range = &stream->reasm[i];
+		if (SEQ_LEQ(range->end, cur)) {
+			continue;
+		}
+		if (SEQ_GEQ(range->start, end)) {
+			break;
+		}
+		if (SEQ_LT(cur, range->start)) {
+			fec_received(stream->fec, cur, data + (cur - seq), range->start - cur);
+		}
+		cur = range->end;
+	}
+	if (SEQ_LT(cur, end)) {
+		fec_received(stream->fec, cur, data + (cur - seq), end - cur);
+	}
+}
+
+//stores length bytes of data received at sequence number seq. Data before expect_seqNum was
+//received before and is skipped; data after it is kept for reassembly. When the data fills the
+//gap at expect_seqNum, it and the ranges it joins up with are handed to the reader: recvTail is
+//stored with release after the data is in place, so the reader only sees complete data.
+//If eor is 1 and the stream is SRT_SEQPACKET, the last byte is marked as the end of a message.
+//stream->mutex must be held
+//returns the number of bytes the in-order data grew by, 0 if the data was out of order or
+//received before, -1 if it doesn't fit in the receive window or the reassembly ranges
+static int stream_store(stream_t* stream, unsigned int seq, char* data, unsigned int length, int eor)
+{
+	unsigned int end = seq + length;
+	unsigned int usedLen = stream_recvlen(stream);
+	unsigned int windowEnd = stream->expect_seqNum + (stream->recvBufSize - usedLen);
+
+	if (SEQ_LT(seq, stream->expect_seqNum)) {
+		if (SEQ_LEQ(end, stream->expect_seqNum)) {
+			return 0;
+		}
+		data += stream->expect_seqNum - seq;
+		seq = stream->expect_seqNum;
+	}
+	if (SEQ_GT(end, windowEnd)) {
+		return -1;
+	}
+	if (usedLen + (end - stream->expect_seqNum) > stream->recvPeak) {
+		stream->recvPeak = usedLen + (end - stream->expect_seqNum);
+	}
+	if (stream->fec != NULL) {
+		stream_fecadd(stream, seq, data, end);
+	}
+	if (seq != stream->expect_seqNum && !stream_reasmadd(stream, seq, end)) {
+		return -1;
+	}
+	stream_ringput(stream, seq, data, end - seq);
+	if (eor && stream->recvEor != NULL) {
+		unsigned int tail = atomic_load_explicit(&stream->recvTail, memory_order_relaxed);
+		stream_eorset(stream, tail + (end - 1 - stream->expect_seqNum));
+	}
+	if (seq != stream->expect_seqNum) {
+		return 0;
+	}
+
+	//the ranges the data reaches are in order now
+	while (stream->reasmCount > 0 && SEQ_LEQ(stream->reasm[0].start, end)) {
+		if (SEQ_GT(stream->reasm[0].end, end)) {
+			end = stream->reasm[0].end;
+		}
+		stream->reasmCount--;
+		memmove(&stream->reasm[0], &stream->reasm[1], stream->reasmCount * sizeof(reasm_range_t));
+	}
+	unsigned int grown = end - stream->expect_seqNum;
+	unsigned int tail = atomic_load_explicit(&stream->recvTail, memory_order_relaxed);
+	atomic_store_explicit(&stream->recvTail, tail + grown, memory_order_release);
+	stream->expect_seqNum = end;
+	pthread_cond_broadcast(&stream->recvCond);
+	return grown;
+}
+
+//stores the data of the DATA segment, in order or for reassembly. In-order data is Acked every
+//ackEvery segments or after ackDelay, anything unexpected, and data filling a gap, is Acked at
+//once so the peer learns about it quickly. stream->mutex must be held
+//returns 1 if the ACK must go out at once, 0 if it is delayed
+static int stream_data(stream_t* stream, seg_t* segPtr)
+{
+	stream->unAckedSegs++;
+	int gapFilled = (stream->reasmCount > 0);
+	int grown = stream_store(stream, segPtr->header.seq_num, segPtr->data, segPtr->header.length, segPtr->header.flags & SEG_EOR);
+	if (SEQ_GEQ(segPtr->header.seq_num + segPtr->header.length + stream->mss, stream->rcvWndEdge)) {
+		stream->rcvLimited = 1;
+	}
+	if (grown > 0) {
+		printf("Seq_nums match (%u)! Adding %d bytes to buffer.\n", segPtr->header.seq_num, grown);
+		if (gapFilled || stream->gapPending || stream->unAckedSegs >= stream->ackEvery) {
+			return 1;
+		}
+		printf("Delaying DATAACK, %u segments unAcked.\n", stream->unAckedSegs);
+		timer_arm_before(&stream->delAckTimer, stream->ackDelay);
+		return 0;
+	}
+	if (grown < 0) {
+		printf("No room for seq_num %u in recv Buf. Dropping data and sending DATAACK.\n", segPtr->header.seq_num);
+		return 1;
+	}
+	if (SEQ_GT(segPtr->header.seq_num, stream->expect_seqNum)) {
+		printf("Out of order packet (%u). Keeping it for reassembly.\n", segPtr->header.seq_num);
+		stream->gapPending = 1;
+	} else {
+		printf("Duplicate packet (%u).\n", segPtr->header.seq_num);
+	}
+	return 1;
+}
+
+//rebuilds the data lost from the range the DATAFEC segment covers, if it is one range of at most
+//a row, and stores it like received data. stream->mutex must be held
+//returns 1 if data was rebuilt, so it is Acked at once, 0 otherwise
+static int stream_parity(stream_t* stream, seg_t* segPtr)
+{
+	unsigned int first = segPtr->header.seq_num;
+	unsigned int end = segPtr->header.ack_num;
+	if (stream->fec == NULL || SEQ_LEQ(end, stream->expect_seqNum)) {
+		return 0;
+	}
+
+	//find what the reassembly ranges leave missing of the data after expect_seqNum
+	unsigned int cur = SEQ_GT(first, stream->expect_seqNum) ? first : stream->expect_seqNum;
+	unsigned int missStart = 0;
+	unsigned int missEnd = 0;
+	int gaps = 0;
+	for (unsigned int i = 0; i < stream->reasmCount && SEQ_LT(cur, end); i++) {
+		reasm_range_t *range = &stream->reasm[i];
+		if (SEQ_LEQ(range->end, cur)) {
+			continue;
+		}
+		if (SEQ_GEQ(range->start, end)) {
+			break;
+		}
+		if (SEQ_LT(cur, range->start)) {
+			missStart = cur;
+			missEnd = range->start;
+			gaps++;
+		}
+		cur = range->end;
+	}
+	if (SEQ_LT(cur, end)) {
+		missStart = cur;
+		missEnd = end;
+		gaps++;
+	}
+	if (gaps != 1) {
+		if (gaps > 1) {
+			printf("FEC: %d ranges of seq_nums %u to %u lost, waiting for retransmission.\n", gaps, first, end);
+		}
+		return 0;
+	}
+
+	char rebuilt[MAX_SEG_LEN];
+	if (!fec_rebuild(stream->fec, segPtr, missStart, missEnd, rebuilt)) {
+		return 0;
+	}
+	printf("FEC: rebuilt %u bytes at seq_num %u.\n", missEnd - missStart, missStart);
+	stream->unAckedSegs++;
+	stream_store(stream, missStart, rebuilt, missEnd - missStart, 0);
+	return 1;
+}
+
+//sends segments until GBN_WINDOW or end of queue, each carrying the ACK of the receive side.
+//With pacing on, stops at the next pacing slot and arms pacingTimer to continue there.
+//returns 1 for success or -1 for failure
+static int stream_sendmax(stream_t* stream)
+{
+	pthread_mutex_lock(stream->mutex);
+	segBuf_t *currentSegBuf = stream->sendBufunSent;
+	unsigned long rate = stream_pacingrate(stream);
+	unsigned long now = timer_now_ns();
+	unsigned int burstSegs = 0;
+	unsigned long burstBytes = 0;
+	int paced = 0;
+	int closed = 0;
+
+	//send segBufs
+	while (stream->unAck_segNum < GBN_WINDOW && currentSegBuf != NULL) {
+		//a partial segment held back for coalescing goes out after flushTimeout at the latest
+		if (stream_held(stream, currentSegBuf)) {
+			timer_arm_before(&stream->flushTimer, stream->flushTimeout);
+			break;
+		}
+		//the rest waits for the next pacing slot
+		if (rate > 0 && (now < stream->nextSendTime || burstSegs == stream->pacingBurst)) {
+			paced = 1;
+			break;
+		}
+		//the rest waits for the peer's receive window to open
+		if (!stream->windowProbe && SEQ_GT(currentSegBuf->seg.header.seq_num + currentSegBuf->seg.header.length, stream->sndWndEdge)) {
+			closed = 1;
+			break;
+		}
+		stream->windowProbe = 0;
+		if (currentSegBuf->sentTime != 0) {
+			currentSegBuf->retransmitted = 1;
+		}
+		currentSegBuf->sentTime = now / NS_TO_MICROSECONDS;
+		if (stream_xmit(stream, currentSegBuf) < 0) {
+			printf("Error sending seg_t with seq_num %u.\n", currentSegBuf->seg.header.seq_num);
+			stream->sendBufunSent = currentSegBuf;
+			pthread_mutex_unlock(stream->mutex);
+			return -1;
+		} else {
+			printf("Sent seq_num %u. src_port: %u, dest_port: %u\n", currentSegBuf->seg.header.seq_num,
+				currentSegBuf->seg.header.src_port, currentSegBuf->seg.header.dest_port);
+		}
+		burstSegs++;
+		burstBytes += currentSegBuf->seg.header.length + sizeof(srt_hdr_t);
+		stream->unAck_segNum++;
+		currentSegBuf = currentSegBuf->next;
+	}
+
+	stream->sendBufunSent = currentSegBuf;
+
+	//the parity of the last segments goes out at once, so a loss at the tail is rebuilt as well
+	seg_t paritySeg;
+	if (stream->fec != NULL && currentSegBuf == NULL && fec_flush(stream->fec, &paritySeg)
+		&& stream_sendparity(stream, &paritySeg) < 0) {
+		printf("Error sending DATAFEC seg_t.\n");
+	}
+
+	//the next burst may go out once this one has drained at the pacing rate
+	if (rate > 0 && burstSegs > 0) {
+		stream->nextSendTime = now + burstBytes * NANOSECONDS_PER_SECOND / rate;
+	}
+	if (paced) {
+		timer_arm_before(&stream->pacingTimer, stream->nextSendTime - now);
+	}
+	//with the window closed and nothing in flight no ACK is coming, the timer probes the window
+	if (stream->unAck_segNum > 0 || closed) {
+		timer_arm_before(&stream->sendBufTimer, (unsigned long)DATA_TIMEOUT * NS_TO_MICROSECONDS);
+	}
+
+	pthread_mutex_unlock(stream->mutex);
+	return 1;
+}
+
+//timer callback of sendBufTimer. The timer is armed whenever there are sent-but-unAcked segments,
+//to expire DATA_TIMEOUT after the first of them was sent. When it expires, only that segment
+//is resent: the peer keeps the segments after it for reassembly, and the partial ACKs of the
+//recovery tell which ones it is missing as well. It is also armed while the peer's receive window is closed with
+//nothing in flight; then it sends the next segment anyway, and the ACK of this window probe
+//carries the window, in case the update sent when the peer's app read data was lost.
+static void stream_rtxtimer(void* arg)
+{
+	stream_t* stream = (stream_t*)arg;
+
+	pthread_mutex_lock(stream->mutex);
+	if (stream->sendBufHead == NULL) {
+		pthread_mutex_unlock(stream->mutex);
+		return;
+	}
+	if (stream->unAck_segNum == 0) {
+		segBuf_t *unSent = stream->sendBufunSent;
+		if (unSent == NULL || !SEQ_GT(unSent->seg.header.seq_num + unSent->seg.header.length, stream->sndWndEdge)) {
+			pthread_mutex_unlock(stream->mutex);
+			return;
+		}
+		printf("Peer window closed. Probing with seq_num %u.\n", unSent->seg.header.seq_num);
+		stream->windowProbe = 1;
+		pthread_mutex_unlock(stream->mutex);
+		if (stream_sendmax(stream) < 0) {
+			printf("Error sending window probe.\n");
+		}
+		return;
+	}
+
+	//the head may have been Acked and the timer re-armed late, wait for the rest of its timeout
+	unsigned long now = timer_now_ns() / NS_TO_MICROSECONDS;
+	unsigned long deadline = stream->sendBufHead->sentTime + DATA_TIMEOUT;
+	if (now < deadline) {
+		timer_arm(&stream->sendBufTimer, (deadline - now) * NS_TO_MICROSECONDS);
+		pthread_mutex_unlock(stream->mutex);
+		return;
+	}
+
+	printf("Buftimer timed out! Resending seq_num %u.\n", stream->sendBufHead->seg.header.seq_num);
+	stream_recover(stream);
+	pthread_mutex_unlock(stream->mutex);
+}
+
+//timer callback that sends a partial segment held back for longer than flushTimeout
+static void stream_flushtimer(void* arg)
+{
+	stream_t* stream = (stream_t*)arg;
+
+	pthread_mutex_lock(stream->mutex);
+	stream->pushSeq = stream->next_seqNum;
+	pthread_mutex_unlock(stream->mutex);
+	printf("Flush timeout! Sending held segments for port %u.\n", stream->localPort);
+	if (stream_sendmax(stream) < 0) {
+		printf("Error sending held segments from flush timer.\n");
+	}
+}
+
+//timer callback that releases the next paced burst
+static void stream_pacingtimer(void* arg)
+{
+	stream_t* stream = (stream_t*)arg;
+
+	if (stream_sendmax(stream) < 0) {
+		printf("Error sending paced segments from pacing timer.\n");
+	}
+}
+
+//timer callback that sends a DATAACK delayed for ackDelay, if no reverse data took the ACK along
+static void stream_delacktimer(void* arg)
+{
+	stream_t* stream = (stream_t*)arg;
+
+	pthread_mutex_lock(stream->mutex);
+	if (stream->unAckedSegs > 0) {
+		printf("Delayed ACK timer expired.\n");
+		if (stream_sendack(stream) < 0) {
+			printf("Error sending delayed DATAACK seg_t.\n");
+		}
+	}
+	pthread_mutex_unlock(stream->mutex);
+}
+
+//frees the segments in the send buffer. stream->mutex must be held
+static void stream_freesendbuf(stream_t* stream)
+{
+	segBuf_t *currentSegBuf = stream->sendBufHead;
+	segBuf_t *tempSegBuf;
+	while (currentSegBuf != NULL) {
+		tempSegBuf = currentSegBuf;
+		currentSegBuf = currentSegBuf->next;
+		stream_freesegbuf(stream, tempSegBuf);
+	}
+	stream->sendBufHead = NULL;
+	stream->sendBufTail = NULL;
+	stream->sendBufunSent = NULL;
+	stream->unAck_segNum = 0;
+	pthread_cond_broadcast(&stream->drainCond);
+}
+
+//This function sets up an empty stream of a TCB, locked by the TCB's mutex and sending on
+//its flow of the scheduler, and allocates the receive buffer.
+void stream_init(stream_t* stream, pthread_mutex_t* mutex, txsched_t* sched, txsched_flow_t* txFlow)
+{
+	memset(stream, 0, sizeof(stream_t));
+	stream->mutex = mutex;
+	stream->sched = sched;
+	stream->txFlow = txFlow;
+	stream->mss = MAX_SEG_LEN;
+
+	stream->flushTimeout = COALESCE_FLUSH_TIMEOUT;
+	timer_init(&stream->flushTimer, stream_flushtimer, stream);
+	timer_init(&stream->sendBufTimer, stream_rtxtimer, stream);
+	stream->pacing = 1;
+	stream->pacingBurst = PACING_BURST;
+	timer_init(&stream->pacingTimer, stream_pacingtimer, stream);
+	timer_condinit(&stream->drainCond);
+	stream->linger = LINGER_TIMEOUT;
+	stream->paths = 1;
+
+	atomic_init(&stream->recvHead, 0);
+	atomic_init(&stream->recvTail, 0);
+	timer_condinit(&stream->recvCond);
+	stream->ackEvery = DELAYED_ACK_SEGMENTS;
+	stream->ackDelay = DELAYED_ACK_TIMEOUT;
+	timer_init(&stream->delAckTimer, stream_delacktimer, stream);
+}
+
+//This function copies the options set on parent, like linger and the delayed-ACK policy, to
+//the stream of a connection accepted on it. The mutex of parent must be held.
+void stream_inherit(stream_t* stream, stream_t* parent)
+{
+	stream->coalesce = parent->coalesce;
+	stream->flushTimeout = parent->flushTimeout;
+	stream->pacing = parent->pacing;
+	stream->pacingRate = parent->pacingRate;
+	stream->pacingBurst = parent->pacingBurst;
+	stream->linger = parent->linger;
+	stream->ackEvery = parent->ackEvery;
+	stream->ackDelay = parent->ackDelay;
+	stream->recvTimeout = parent->recvTimeout;
+	stream->fecWanted = parent->fecWanted;
+	stream->paths = parent->paths;
+	stream->seqpacket = parent->seqpacket;
+}
+
+//This function picks the initial sequence number of the send side for the connection from
+//localPort to remotePort on remoteNode. The mutex must be held.
+//Like TCP's (RFC 6528), it is a keyed hash of the connection plus a clock that ticks every
+//4 microseconds, so a new connection between the same ports starts beyond the sequence
+//numbers of the old one, and nobody who doesn't know isnKey can guess it.
+void stream_pickisn(stream_t* stream, unsigned int localPort, int remoteNode, unsigned int remotePort)
+{
+	pthread_once(&isnOnce, stream_isninit);
+	unsigned int conn[3] = { localPort, (unsigned int)remoteNode, remotePort };
+	unsigned int hash = (unsigned int)siphash(&isnKey, conn, sizeof(conn));
+	stream->next_seqNum = hash + (unsigned int)(timer_now_ns() / 4000);
+	stream->pushSeq = stream->next_seqNum;
+}
+
+//This function starts the stream of a connection being established with the peer remotePort
+//on remoteNode, whose data starts at sequence number expect_seqNum. The mutex must be held.
+void stream_open(stream_t* stream, unsigned int localPort, int remoteNode, unsigned int remotePort, unsigned int expect_seqNum, unsigned int mss)
+{
+	stream->localPort = localPort;
+	stream->remoteNode = remoteNode;
+	stream->remotePort = remotePort;
+	stream->mss = mss;
+	stream->initSeqNum = stream->next_seqNum;
+	stream->pushSeq = stream->next_seqNum;
+	//the peer's receive buffer starts out empty, with RECV_BUF_MIN bytes like ours
+	stream->sndWndEdge = stream->next_seqNum + RECV_BUF_MIN - 1;
+	stream->windowProbe = 0;
+	stream->srtt = 0;
+	memset(stream->path, 0, sizeof(stream->path));
+	stream->nextSendTime = 0;
+	stream->expect_seqNum = expect_seqNum;
+	stream->unAckedSegs = 0;
+	stream->gapPending = 0;
+	stream->timestamps = 0;
+	stream->tsRecentValid = 0;
+	stream->recvShut = 0;
+	stream->reasmCount = 0;
+	stream->dupAcks = 0;
+	stream->recovering = 0;
+	if (stream->recvBuf == NULL) {
+		stream->recvBuf = bufpool_alloc(RECV_BUF_MIN);
+		MALLOC_CHECK(stream->recvBuf);
+		stream->recvBufSize = RECV_BUF_MIN;
+	}
+	if (stream->seqpacket) {
+		if (stream->recvEor == NULL) {
+			stream->recvEor = calloc(stream->recvBufSize / 8, 1);
+			MALLOC_CHECK(stream->recvEor);
+		} else {
+			memset(stream->recvEor, 0, stream->recvBufSize / 8);
+		}
+	}
+	stream->recvBufTarget = stream->recvBufSize;
+	stream->rcvWndEdge = expect_seqNum + RECV_BUF_MIN - 1;
+	stream->rcvLimited = 0;
+	stream->recvPeak = 0;
+	stream->tuneTime = timer_now_ns();
+	if (stream->fec != NULL) {
+		fec_destroy(stream->fec);
+		stream->fec = NULL;
+	}
+}
+
+//This function starts forward error correction on the opened stream, when both ends agreed to
+//it in SYN/SYNACK. The mutex must be held.
+//The blocks of each direction are counted from the first sequence number of its data, which both
+//ends know from SYN/SYNACK, with rows of the agreed MSS.
+void stream_startfec(stream_t* stream)
+{
+	stream->fec = fec_create(stream->initSeqNum, stream->expect_seqNum, stream->mss);
+	printf("FEC: sending parity for blocks of %u segments.\n", FEC_BLOCK_SEGS);
+}
+
+//adds the segBuf to the end of the send buffer. stream->mutex must be held
+static void stream_append(stream_t* stream, segBuf_t* segBuf)
+{
+	if (stream->sendBufHead == NULL) { //this is the first segment
+		stream->sendBufHead = segBuf;
+		stream->sendBufTail = segBuf;
+		stream->sendBufunSent = segBuf;
+	} else { //there's already stuff in the buffer
+		stream->sendBufTail->next = segBuf;
+		stream->sendBufTail = segBuf;
+		if (stream->sendBufunSent == NULL) {
+			stream->sendBufunSent = segBuf;
+		}
+	}
+}
+
+//This function queues length bytes of data in the send buffer, in segments of up to mss
+//bytes, and sends as many as the GBN window allows. Returns 1.
+//If the stream is coalescing or corked, the data is first appended to the partial
+//segment at the tail of the send buffer if that segment hasn't been sent yet.
+//On a SRT_SEQPACKET stream the data is a message: it starts a segment of its own and its
+//last segment is flagged SEG_EOR.
+int stream_send(stream_t* stream, void* data, unsigned int length)
+{
+	char *dataToTransmit = (char *)data;
+	unsigned int dataLength = length;
+
+	pthread_mutex_lock(stream->mutex);
+	unsigned int mss = stream->mss;
+
+	//fill up the unsent partial segment at the tail of the send buffer first
+	if ((stream->coalesce || stream->corked) && !stream->seqpacket) {
+		segBuf_t *tailSegBuf = stream->sendBufTail;
+		if (stream->sendBufunSent != NULL && tailSegBuf->sentTime == 0 && tailSegBuf->chunk == NULL && tailSegBuf->seg.header.length < mss) {
+			unsigned int room = min(mss - tailSegBuf->seg.header.length, dataLength);
+			memcpy(tailSegBuf->seg.data + tailSegBuf->seg.header.length, dataToTransmit, room);
+			tailSegBuf->seg.header.length += room;
+			stream->next_seqNum += room;
+			dataToTransmit += room;
+			dataLength -= room;
+			printf("Coalesced %u bytes into unsent seq_num %u.\n", room, tailSegBuf->seg.header.seq_num);
+		}
+	}
+
+	//create segBuf structs and append to sendBuffer
+	while (dataLength > 0) {
+		unsigned int segLength = min(dataLength, mss);
+		segBuf_t *currentSegBuf = malloc(sizeof(segBuf_t));
+		MALLOC_CHECK(currentSegBuf);
+		memset(currentSegBuf, 0, sizeof(segBuf_t));
+
+		//copy data and write header
+		memcpy(currentSegBuf->seg.data, dataToTransmit, segLength);
+		dataToTransmit += segLength;
+		dataLength -= segLength;
+		currentSegBuf->seg.header.length = segLength;
+		currentSegBuf->seg.header.src_port = stream->localPort;
+		currentSegBuf->seg.header.dest_port = stream->remotePort;
+		currentSegBuf->seg.header.type = DATA;
+		currentSegBuf->seg.header.seq_num = stream->next_seqNum;
+		stream->next_seqNum += segLength;
+		stream_append(stream, currentSegBuf);
+	}
+	if (stream->seqpacket && length > 0) {
+		stream->sendBufTail->seg.header.flags |= SEG_EOR;
+	}
+	pthread_mutex_unlock(stream->mutex);
+
+	//send segments until sent-but-not-Acked segments reaches GBN_WINDOW or segments are all sent
+	if (stream_sendmax(stream) < 0) {
+		printf("Error sending initial segments from stream_send.\n");
+	}
+	return 1;
+}
+
+//This function sends length bytes of the file fd, starting at offset, like stream_send but
+//without copying the file into the send buffer: the segments are cut from chunks of the file
+//mapped with mmap, and waits while SENDFILE_CHUNKS chunks are waiting for ACKs.
+//Returns 1 once all data is queued, -1 if offset + length is past the end of the file, the file
+//can't be mapped, the stream was stopped or the peer Acked no chunk for SENDFILE_TIMEOUT.
+//Only the header of a segment is allocated, its data is copied from the mapping when it is
+//sent. A chunk is unmapped once all its segments are Acked, so the memory taken stays bounded
+//by SENDFILE_CHUNKS chunks, however large the file. The file must not be truncated meanwhile.
+int stream_sendfile(stream_t* stream, int fd, off_t offset, unsigned long length)
+{
+	long pageSize = sysconf(_SC_PAGESIZE);
+	unsigned long queued = 0;
+
+	//pages mapped past the end of the file can't be read
+	struct stat fileStat;
+	if (fstat(fd, &fileStat) < 0) {
+		perror("Error reading the size of the file to send");
+		return -1;
+	}
+	if (offset < 0 || offset > fileStat.st_size || length > (unsigned long)(fileStat.st_size - offset)) {
+		printf("Can't send %lu bytes at offset %ld of a file of %ld bytes.\n", length, (long)offset, (long)fileStat.st_size);
+		return -1;
+	}
+
+	while (queued < length) {
+		//wait until the peer Acked the oldest chunk
+		unsigned long deadline = timer_now_ns() + SENDFILE_TIMEOUT;
+		pthread_mutex_lock(stream->mutex);
+		while (stream->fileChunks >= SENDFILE_CHUNKS && !stream->recvShut) {
+			if (timer_condwait(&stream->drainCond, stream->mutex, deadline) == ETIMEDOUT) {
+				break;
+			}
+		}
+		if (stream->fileChunks >= SENDFILE_CHUNKS && !stream->recvShut) {
+			pthread_mutex_unlock(stream->mutex);
+			printf("Peer Acked no chunk of the file in time, stopping after %lu bytes.\n", queued);
+			return -1;
+		}
+		pthread_mutex_unlock(stream->mutex);
+
+		//map the next chunk, from the page it starts in
+		off_t chunkStart = offset + queued;
+		unsigned long chunkLen = min(length - queued, SENDFILE_CHUNK);
+		off_t mapStart = chunkStart - chunkStart % pageSize;
+		filechunk_t *chunk = malloc(sizeof(filechunk_t));
+		MALLOC_CHECK(chunk);
+		chunk->mapLen = chunkLen + (chunkStart - mapStart);
+		chunk->addr = mmap(NULL, chunk->mapLen, PROT_READ, MAP_SHARED, fd, mapStart);
+		if (chunk->addr == MAP_FAILED) {
+			perror("Error mapping file to send");
+			free(chunk);
+			return -1;
+		}
+		madvise(chunk->addr, chunk->mapLen, MADV_SEQUENTIAL);
+		chunk->segs = 0;
+		const char *data = (char *)chunk->addr + (chunkStart - mapStart);
+
+		pthread_mutex_lock(stream->mutex);
+		if (stream->recvShut) {
+			pthread_mutex_unlock(stream->mutex);
+			printf("Stream stopped after %lu bytes of the file.\n", queued);
+			munmap(chunk->addr, chunk->mapLen);
+			free(chunk);
+			return -1;
+		}
+		stream->fileChunks++;
+		unsigned int mss = stream->mss;
+		for (unsigned long chunkOffset = 0; chunkOffset < chunkLen; chunkOffset += mss) {
+			unsigned int segLength = min(chunkLen - chunkOffset, mss);
+			segBuf_t *currentSegBuf = malloc(offsetof(segBuf_t, seg) + sizeof(srt_hdr_t));
+			MALLOC_CHECK(currentSegBuf);
+			memset(currentSegBuf, 0, offsetof(segBuf_t, seg) + sizeof(srt_hdr_t));
+
+			//point at the data and write header
+			currentSegBuf->chunk = chunk;
+			currentSegBuf->fileData = data + chunkOffset;
+			chunk->segs++;
+			currentSegBuf->seg.header.length = segLength;
+			currentSegBuf->seg.header.src_port = stream->localPort;
+			currentSegBuf->seg.header.dest_port = stream->remotePort;
+			currentSegBuf->seg.header.type = DATA;
+			currentSegBuf->seg.header.seq_num = stream->next_seqNum;
+			stream->next_seqNum += segLength;
+			stream_append(stream, currentSegBuf);
+		}
+		//the file is one message
+		if (stream->seqpacket && queued + chunkLen == length) {
+			stream->sendBufTail->seg.header.flags |= SEG_EOR;
+		}
+		//the short last segment of a chunk isn't held back for coalescing
+		stream->pushSeq = stream->next_seqNum;
+		pthread_mutex_unlock(stream->mutex);
+		queued += chunkLen;
+		printf("Queued %lu of %lu bytes of the file.\n", queued, length);
+
+		if (stream_sendmax(stream) < 0) {
+			printf("Error sending segments from stream_sendfile.\n");
+		}
+	}
+	return 1;
+}
+
+//returns the number of bytes in the receive buffer. recvHead and recvTail count bytes since
+//the stream was set up, their difference is right across wraparound of the counters
+static unsigned int stream_recvlen(stream_t* stream)
+{
+	unsigned int tail = atomic_load_explicit(&stream->recvTail, memory_order_acquire);
+	return tail - atomic_load_explicit(&stream->recvHead, memory_order_acquire);
+}
+
+//points views at the first length bytes, at most what is in the receive buffer, at the front of
+//the ring. The data may wrap around the end of the ring, then the second view holds the rest,
+//otherwise it is empty
+static void stream_views(stream_t* stream, unsigned int length, srt_view_t views[2])
+{
+	unsigned int head = atomic_load_explicit(&stream->recvHead, memory_order_relaxed);
+	unsigned int offset = head & (stream->recvBufSize - 1);
+	unsigned int firstLen = min(length, stream->recvBufSize - offset);
+
+	views[0].data = stream->recvBuf + offset;
+	views[0].length = firstLen;
+	views[1].data = stream->recvBuf;
+	views[1].length = length - firstLen;
+}
+
+//hands the first length bytes of the ring back to the writer, with their message ends cleared
+static void stream_advance(stream_t* stream, unsigned int length)
+{
+	unsigned int head = atomic_load_explicit(&stream->recvHead, memory_order_relaxed);
+	if (stream->recvEor != NULL) {
+		stream_eorclear(stream, head, length);
+	}
+	atomic_store_explicit(&stream->recvHead, head + length, memory_order_release);
+}
+
+//takes length bytes, at most what is in the receive buffer, from the front of the ring into buf.
+//The mutex isn't needed: loading recvTail with acquire makes the data stream_deliver stored
+//before it visible, and storing recvHead with release hands the space back only after the copy
+static void stream_take(stream_t* stream, char* buf, unsigned int length)
+{
+	srt_view_t views[2];
+	stream_views(stream, length, views);
+	memcpy(buf, views[0].data, views[0].length);
+	memcpy(buf + views[0].length, views[1].data, views[1].length);
+	stream_advance(stream, length);
+	printf("Took %u bytes from receive buffer. Returning data.\n", length);
+}
+
+//moves the data in the ring, in order and out of order, to a new ring of newSize bytes from the
+//buffer pool. Each byte keeps its counter, at a new offset. stream->mutex must be held, and only
+//the reader may resize, as it is the only one using the ring without the mutex.
+//returns 1, or 0 if the ring wouldn't hold the data and the room the peer was offered, or the
+//pool has no buffer to spare
+static int stream_resize(stream_t* stream, unsigned int newSize)
+{
+	unsigned int head = atomic_load_explicit(&stream->recvHead, memory_order_relaxed);
+	unsigned int tail = atomic_load_explicit(&stream->recvTail, memory_order_relaxed);
+	unsigned int dataEnd = stream->expect_seqNum;
+	if (stream->reasmCount > 0) {
+		dataEnd = stream->reasm[stream->reasmCount - 1].end;
+	}
+	unsigned int needEnd = SEQ_GT(stream->rcvWndEdge, dataEnd) ? stream->rcvWndEdge : dataEnd;
+	if (tail - head + (needEnd - stream->expect_seqNum) > newSize) {
+		return 0;
+	}
+	char *newBuf = bufpool_alloc(newSize);
+	if (newBuf == NULL) {
+		return 0;
+	}
+
+	unsigned int counter = head;
+	unsigned int copyLen = tail - head + (dataEnd - stream->expect_seqNum);
+	//the message ends move along with their bytes
+	if (stream->recvEor != NULL) {
+		atomic_uchar *newEor = calloc(newSize / 8, 1);
+		MALLOC_CHECK(newEor);
+		unsigned int copyEnd = head + copyLen;
+		for (unsigned int eor = stream_eorfind(stream, head, copyEnd); eor != copyEnd; eor = stream_eorfind(stream, eor + 1, copyEnd)) {
+			unsigned int newOffset = eor & (newSize - 1);
+			atomic_fetch_or_explicit(&newEor[newOffset >> 3], 1 << (newOffset & 7), memory_order_relaxed);
+		}
+		free(stream->recvEor);
+		stream->recvEor = newEor;
+	}
+	while (copyLen > 0) {
+		unsigned int oldOffset = counter & (stream->recvBufSize - 1);
+		unsigned int newOffset = counter & (newSize - 1);
+		unsigned int chunkLen = min(copyLen, min(stream->recvBufSize - oldOffset, newSize - newOffset));
+		memcpy(newBuf + newOffset, stream->recvBuf + oldOffset, chunkLen);
+		counter += chunkLen;
+		copyLen -= chunkLen;
+	}
+	bufpool_free(stream->recvBuf, stream->recvBufSize);
+	printf("Receive buffer resized from %u to %u bytes.\n", stream->recvBufSize, newSize);
+	stream->recvBuf = newBuf;
+	stream->recvBufSize = newSize;
+	return 1;
+}
+
+//sizes the receive buffer to the traffic after the reader took data out of the ring, leaving
+//leftLen bytes. The ring doubles if the peer filled the window while the reader kept up, as then
+//the window and not the reader limits the transfer, unless memory runs low. It halves if at most
+//a quarter of it, or half under memory pressure, was used for RECV_TUNE_INTERVAL: from then on
+//the window only offers half, and the ring is resized as soon as the data the peer may still
+//send fits. stream->mutex must be held
+static void stream_autotune(stream_t* stream, unsigned int leftLen)
+{
+	unsigned long now = timer_now_ns();
+	if (stream->rcvLimited) {
+		stream->rcvLimited = 0;
+		if (stream->recvBufTarget < stream->recvBufSize) {
+			//busy again before it shrank, offer the whole ring
+			stream->recvBufTarget = stream->recvBufSize;
+		} else if (leftLen <= stream->recvBufSize / 2 && stream->recvBufSize < RECEIVE_BUF_SIZE && !bufpool_pressure()
+			&& stream_resize(stream, stream->recvBufSize * 2)) {
+			stream->recvBufTarget = stream->recvBufSize;
+			stream->recvPeak = 0;
+			stream->tuneTime = now;
+		}
+	} else if (now - stream->tuneTime >= RECV_TUNE_INTERVAL) {
+		//the window offers less from now on, the ring shrinks when the peer used up what it was offered
+		unsigned int unusedLimit = bufpool_pressure() ? stream->recvBufSize / 2 : stream->recvBufSize / 4;
+		if (stream->recvBufSize > RECV_BUF_MIN && stream->recvPeak <= unusedLimit) {
+			stream->recvBufTarget = stream->recvBufSize / 2;
+		} else {
+			stream->recvBufTarget = stream->recvBufSize;
+		}
+		stream->recvPeak = 0;
+		stream->tuneTime = now;
+	}
+	if (stream->recvBufTarget < stream->recvBufSize) {
+		stream_resize(stream, stream->recvBufTarget);
+	}
+}
+
+//sizes the receive buffer, which holds leftLen bytes after the reader took data out, and tells
+//the peer right away when the window grew by two segments or half the buffer since it was last
+//advertised, as it may be waiting for room to send
+static void stream_windowupdate(stream_t* stream, unsigned int leftLen)
+{
+	pthread_mutex_lock(stream->mutex);
+	stream_autotune(stream, leftLen);
+	unsigned int rcvWin = stream_rcvwin(stream);
+	if (rcvWin > stream->advWin && rcvWin - stream->advWin >= min(2 * stream->mss, stream->recvBufSize / 2)) {
+		printf("Receive window opened to %u bytes. Sending window update.\n", rcvWin);
+		if (stream_sendack(stream) < 0) {
+			printf("Error sending window update DATAACK seg_t.\n");
+		}
+	}
+	pthread_mutex_unlock(stream->mutex);
+}
+
+//waits until data is in the receive buffer, the stream is stopped or the deadline in
+//nanoseconds passes (0 waits forever). Returns the number of bytes in the receive buffer,
+//0 if the stream was stopped with the buffer empty, or -1 on timeout.
+static int stream_waitdata(stream_t* stream, unsigned long deadline)
+{
+	int usedLen = stream_recvlen(stream);
+	if (usedLen > 0) {
+		return usedLen;
+	}
+
+	//stream_deliver signals recvCond with the mutex held, so no wakeup is lost in between
+	pthread_mutex_lock(stream->mutex);
+	while ((usedLen = stream_recvlen(stream)) == 0 && !stream->recvShut) {
+		if (deadline == 0) {
+			pthread_cond_wait(&stream->recvCond, stream->mutex);
+		} else if (timer_condwait(&stream->recvCond, stream->mutex, deadline) == ETIMEDOUT) {
+			usedLen = stream_recvlen(stream);
+			if (usedLen == 0) {
+				usedLen = -1;
+			}
+			break;
+		}
+	}
+	pthread_mutex_unlock(stream->mutex);
+	return usedLen;
+}
+
+//This function waits until data is in the receive buffer and takes out up to length bytes,
+//or with SRT_WAITALL keeps taking data out as it arrives until length bytes were read.
+//Returns the number of bytes read, which is less than length only if the stream was stopped,
+//or -1 if the receive timeout expired before any data was read.
+//Only one thread may read a stream at a time.
+//seghandler wakes the reader as soon as data arrives. As the data is taken out, the receive
+//window reopens, so length may be larger than the receive buffer.
+int stream_read(stream_t* stream, void* buf, unsigned int length, int flags)
+{
+	unsigned int readLen = 0;
+	unsigned long deadline = 0;
+	if (stream->recvTimeout > 0) {
+		deadline = timer_now_ns() + stream->recvTimeout;
+	}
+
+	while (readLen < length) {
+		//wait until some data has been transmitted
+		int usedLen = stream_waitdata(stream, deadline);
+		if (usedLen == 0) {
+			printf("Stream stopped after %u bytes.\n", readLen);
+			break;
+		}
+		if (usedLen < 0) {
+			printf("Receive timeout after %u bytes.\n", readLen);
+			return (readLen > 0) ? (int)readLen : -1;
+		}
+
+		//return the data
+		unsigned int takeLen = min(length - readLen, (unsigned int)usedLen);
+		stream_take(stream, (char *)buf + readLen, takeLen);
+		readLen += takeLen;
+		stream_windowupdate(stream, usedLen - takeLen);
+
+		if (!(flags & SRT_WAITALL)) {
+			break;
+		}
+	}
+	return readLen;
+}
+
+//This function waits until length bytes are received, like stream_read with SRT_WAITALL.
+//Returns 1, or -1 if they didn't arrive before the receive timeout or the stream was stopped.
+int stream_recv(stream_t* stream, void* buf, unsigned int length)
+{
+	return (stream_read(stream, buf, length, SRT_WAITALL) == (int)length) ? 1 : -1;
+}
+
+//waits until the end of the message at the front of the ring is received, the message fills
+//half the room the window offers, so its end might not fit, the stream is stopped or the deadline
+//in nanoseconds passes (0 waits forever). Returns the number of bytes of the message in the
+//receive buffer, with *whole set to 1 if its end is among them, 0 if the stream was stopped with
+//the buffer empty, or -1 on timeout. The ring is only searched beyond what was searched before
+static int stream_waitmsg(stream_t* stream, unsigned long deadline, int* whole)
+{
+	unsigned int head = atomic_load_explicit(&stream->recvHead, memory_order_relaxed);
+	unsigned int searched = head;
+	int msgLen;
+
+	//stream_deliver signals recvCond with the mutex held, so no wakeup is lost in between
+	pthread_mutex_lock(stream->mutex);
+	while (1) {
+		unsigned int tail = atomic_load_explicit(&stream->recvTail, memory_order_acquire);
+		unsigned int eor = stream_eorfind(stream, searched, tail);
+		if (eor != tail) {
+			*whole = 1;
+			msgLen = eor + 1 - head;
+			break;
+		}
+		searched = tail;
+		*whole = 0;
+		msgLen = tail - head;
+		if (msgLen >= (int)stream->recvBufTarget / 2 || stream->recvShut) {
+			break;
+		}
+		if (deadline == 0) {
+			pthread_cond_wait(&stream->recvCond, stream->mutex);
+		} else if (timer_condwait(&stream->recvCond, stream->mutex, deadline) == ETIMEDOUT) {
+			msgLen = -1;
+			break;
+		}
+	}
+	pthread_mutex_unlock(stream->mutex);
+	return msgLen;
+}
+
+//This function waits until a whole message is in the receive buffer of a SRT_SEQPACKET stream
+//and takes it out into buf. A message longer than length is cut short, the rest of it is dropped.
+//Returns the number of bytes read, 0 if the stream was stopped and all messages were read, or -1
+//if the receive timeout expired first. Only one thread may read a stream at a time.
+//A message too long to wait for whole in the receive buffer is taken out as it arrives, so the
+//peer can send the rest, until its end; the receive timeout or a stop may cut it short then.
+int stream_recvmsg(stream_t* stream, void* buf, unsigned int length)
+{
+	unsigned int readLen = 0;
+	unsigned int msgLen = 0;
+	unsigned long deadline = 0;
+	if (stream->recvTimeout > 0) {
+		deadline = timer_now_ns() + stream->recvTimeout;
+	}
+
+	while (1) {
+		int whole;
+		int usedLen = stream_waitmsg(stream, deadline, &whole);
+		if (usedLen == 0) {
+			printf("Stream stopped after %u bytes of the message.\n", msgLen);
+			break;
+		}
+		if (usedLen < 0) {
+			printf("Receive timeout after %u bytes of the message.\n", msgLen);
+			return (msgLen > 0) ? (int)readLen : -1;
+		}
+
+		//copy what fits in buf, the rest of the message is dropped
+		unsigned int takeLen = min(length - readLen, (unsigned int)usedLen);
+		srt_view_t views[2];
+		stream_views(stream, takeLen, views);
+		memcpy((char *)buf + readLen, views[0].data, views[0].length);
+		memcpy((char *)buf + readLen + views[0].length, views[1].data, views[1].length);
+		stream_advance(stream, usedLen);
+		readLen += takeLen;
+		msgLen += usedLen;
+		stream_windowupdate(stream, stream_recvlen(stream));
+
+		if (whole) {
+			break;
+		}
+	}
+	if (msgLen > readLen) {
+		printf("Message of %u bytes cut to %u bytes.\n", msgLen, readLen);
+	} else {
+		printf("Took a message of %u bytes from receive buffer.\n", msgLen);
+	}
+	return readLen;
+}
+
+//This function waits until data is in the receive buffer, like stream_read, and lends up to
+//length bytes of it in views, without copying: the first view is the data up to the end of the
+//ring, the second one the rest, or empty. Returns the number of bytes lent, 0 if the stream was
+//stopped and all data was read, or -1 if the receive timeout expired first.
+//The views stay valid until stream_release. Only one thread may read a stream at a time.
+//The lent data stays in the ring, the writer only stores beyond it, and only the reader
+//resizes the ring, in stream_release.
+int stream_lend(stream_t* stream, srt_view_t views[2], unsigned int length)
+{
+	unsigned long deadline = 0;
+	if (stream->recvTimeout > 0) {
+		deadline = timer_now_ns() + stream->recvTimeout;
+	}
+
+	views[0].length = 0;
+	views[1].length = 0;
+	int usedLen = stream_waitdata(stream, deadline);
+	if (usedLen <= 0) {
+		printf((usedLen == 0) ? "Stream stopped, nothing to lend.\n" : "Receive timeout, nothing to lend.\n");
+		return usedLen;
+	}
+	unsigned int lendLen = min(length, (unsigned int)usedLen);
+	stream_views(stream, lendLen, views);
+	printf("Lending %u bytes of receive buffer.\n", lendLen);
+	return lendLen;
+}
+
+//This function frees the first length bytes of the receive buffer, lent by stream_lend, and
+//reopens the window. Views of the rest of the data aren't valid afterwards.
+//Returns 1, or -1 if there are less than length bytes in the receive buffer.
+int stream_release(stream_t* stream, unsigned int length)
+{
+	unsigned int usedLen = stream_recvlen(stream);
+	if (length > usedLen) {
+		return -1;
+	}
+	stream_advance(stream, length);
+	stream_windowupdate(stream, usedLen - length);
+	return 1;
+}
+
+//This function adds data received in order outside a DATA segment, like fast open data on
+//a SYN, to the receive buffer. The mutex must be held. Returns 1, or 0 if it doesn't fit.
+//On a SRT_SEQPACKET stream the data is a whole message.
+int stream_deliver(stream_t* stream, char* data, unsigned int length)
+{
+	//the peer's parity doesn't cover data sent outside DATA segments
+	fec_t *fec = stream->fec;
+	stream->fec = NULL;
+	int ret = (stream_store(stream, stream->expect_seqNum, data, length, 1) >= 0) ? 1 : 0;
+	stream->fec = fec;
+	return ret;
+}
+
+//This function handles a DATA or DATAACK segment of the connection: it frees the segments
+//its ACK covers and stores its data, then sends what the window allows and the ACK.
+//The ACK of received data is taken along by the first segment sent, a DATAACK only goes
+//out if none was.
+void stream_input(stream_t* stream, seg_t* segPtr)
+{
+	pthread_mutex_lock(stream->mutex);
+	if (stream->timestamps) {
+		//PAWS: a segment stamped before the newest one received is left over from an
+		//earlier wrap of the sequence space, its sequence and ack numbers can't be trusted
+		if (stream->tsRecentValid && SEQ_LT(segPtr->header.tsval, stream->tsRecent)) {
+			printf("PAWS: dropping stale segment with seq_num %u.\n", segPtr->header.seq_num);
+			if (segPtr->header.type == DATA && stream_sendack(stream) < 0) {
+				printf("Error sending DATAACK seg_t.\n");
+			}
+			pthread_mutex_unlock(stream->mutex);
+			return;
+		}
+		//only segments up to the next expected byte move tsRecent, so a segment from the
+		//future can't make the ones in between look stale
+		if (SEQ_LEQ(segPtr->header.seq_num, stream->expect_seqNum)) {
+			stream->tsRecent = segPtr->header.tsval;
+			stream->tsRecentValid = 1;
+		}
+	}
+	//a parity segment carries no ACK
+	if (segPtr->header.type == DATAFEC) {
+		int ackNow = stream_parity(stream, segPtr);
+		if (ackNow && stream_sendack(stream) < 0) {
+			printf("Error sending DATAACK seg_t.\n");
+		}
+		pthread_mutex_unlock(stream->mutex);
+		return;
+	}
+	printf("Peer expects seq_num %u.\n", segPtr->header.ack_num);
+	int acked = stream_ack(stream, segPtr->header.ack_num);
+	//the right edge of the peer's window only moves back if segments were reordered, keep the newest
+	unsigned int edge = segPtr->header.ack_num + ((unsigned int)segPtr->header.rcv_win << RCV_WIN_SHIFT);
+	int windowMoved = SEQ_GT(edge, stream->sndWndEdge);
+	if (windowMoved) {
+		stream->sndWndEdge = edge;
+	}
+	stream_lossdetect(stream, segPtr, acked, windowMoved);
+	int ackNow = 0;
+	if (segPtr->header.type == DATA) {
+		ackNow = stream_data(stream, segPtr);
+	}
+	int unSent = (stream->sendBufunSent != NULL);
+	pthread_mutex_unlock(stream->mutex);
+
+	//send if there are unsent segments
+	if (unSent && stream_sendmax(stream) < 0) {
+		printf("Error sending segments after an ACK.\n");
+	}
+
+	if (ackNow) {
+		pthread_mutex_lock(stream->mutex);
+		if (stream->unAckedSegs > 0 && stream_sendack(stream) < 0) {
+			printf("Error sending DATAACK seg_t.\n");
+		}
+		pthread_mutex_unlock(stream->mutex);
+	}
+}
+
+//This function sends held back partial segments, as far as the GBN window allows.
+//Returns 1 for success or -1 for failure.
+int stream_flush(stream_t* stream)
+{
+	pthread_mutex_lock(stream->mutex);
+	stream->pushSeq = stream->next_seqNum;
+	timer_cancel(&stream->flushTimer);
+	pthread_mutex_unlock(stream->mutex);
+
+	return stream_sendmax(stream);
+}
+
+//This function sends held back partial segments and waits until all data in the send buffer
+//is Acked, at most timeout nanoseconds. Returns 1 if the send buffer drained, -1 otherwise.
+int stream_drain(stream_t* stream, unsigned long timeout)
+{
+	unsigned long deadline = timer_now_ns() + timeout;
+
+	if (stream_flush(stream) < 0) {
+		return -1;
+	}
+	pthread_mutex_lock(stream->mutex);
+	while (stream->sendBufHead != NULL) {
+		if (timer_condwait(&stream->drainCond, stream->mutex, deadline) == ETIMEDOUT) {
+			break;
+		}
+	}
+	int drained = (stream->sendBufHead == NULL);
+	pthread_mutex_unlock(stream->mutex);
+	return drained ? 1 : -1;
+}
+
+//This function turns small-write coalescing on or off, with a flush timeout of
+//flushTimeout_ms milliseconds (COALESCE_FLUSH_TIMEOUT if 0). Returns 1 for success or -1 for failure.
+int stream_setcoalesce(stream_t* stream, int on, unsigned int flushTimeout_ms)
+{
+	pthread_mutex_lock(stream->mutex);
+	stream->coalesce = on;
+	if (flushTimeout_ms > 0) {
+		stream->flushTimeout = (unsigned long)flushTimeout_ms * 1000000;
+	} else {
+		stream->flushTimeout = COALESCE_FLUSH_TIMEOUT;
+	}
+	pthread_mutex_unlock(stream->mutex);
+
+	//data held back so far must not wait any longer when coalescing is turned off
+	if (!on) {
+		return stream_flush(stream);
+	}
+	return 1;
+}
+
+//This function corks or uncorks the stream. Returns 1 for success or -1 for failure.
+int stream_cork(stream_t* stream, int corked)
+{
+	pthread_mutex_lock(stream->mutex);
+	stream->corked = corked;
+	pthread_mutex_unlock(stream->mutex);
+
+	//uncorking sends the data held back while corked
+	if (!corked) {
+		return stream_flush(stream);
+	}
+	return 1;
+}
+
+//This function sets the pacer, see srt_client_setpacing. Returns 1 for success or -1 for failure.
+int stream_setpacing(stream_t* stream, int on, unsigned int rate, unsigned int burst)
+{
+	pthread_mutex_lock(stream->mutex);
+	stream->pacing = on;
+	stream->pacingRate = rate;
+	stream->pacingBurst = (burst > 0) ? burst : PACING_BURST;
+	stream->nextSendTime = 0;
+	timer_cancel(&stream->pacingTimer);
+	pthread_mutex_unlock(stream->mutex);
+
+	//segments waiting for a pacing slot go out under the new setting
+	return stream_sendmax(stream);
+}
+
+//This function sets the delayed-ACK policy, see srt_server_setdelack.
+void stream_setdelack(stream_t* stream, unsigned int ackEvery, unsigned int ackDelay_ms)
+{
+	pthread_mutex_lock(stream->mutex);
+	stream->ackEvery = (ackEvery > 0) ? ackEvery : DELAYED_ACK_SEGMENTS;
+	stream->ackDelay = (ackDelay_ms > 0) ? (unsigned long)ackDelay_ms * 1000000 : DELAYED_ACK_TIMEOUT;
+	pthread_mutex_unlock(stream->mutex);
+}
+
+//This function sets how long closing waits for the send buffer to drain: linger_ms
+//milliseconds (LINGER_TIMEOUT if 0) if on, not at all if off.
+void stream_setlinger(stream_t* stream, int on, unsigned int linger_ms)
+{
+	pthread_mutex_lock(stream->mutex);
+	if (!on) {
+		stream->linger = 0;
+	} else {
+		stream->linger = (linger_ms > 0) ? (unsigned long)linger_ms * 1000000 : LINGER_TIMEOUT;
+	}
+	pthread_mutex_unlock(stream->mutex);
+}
+
+//This function sets the number of paths the segments are striped over, see srt_client_setmultipath.
+void stream_setmultipath(stream_t* stream, unsigned int paths)
+{
+	pthread_mutex_lock(stream->mutex);
+	stream->paths = min(paths, MULTIPATH_MAX_PATHS);
+	if (stream->paths == 0) {
+		stream->paths = 1;
+	}
+	//the paths start out even
+	for (unsigned int p = 0; p < MULTIPATH_MAX_PATHS; p++) {
+		stream->path[p].vtime = 0;
+	}
+	pthread_mutex_unlock(stream->mutex);
+}
+
+//This function makes the stream a SRT_SEQPACKET stream if on, a SRT_STREAM one otherwise. It
+//must be set before the stream is opened.
+void stream_setseqpacket(stream_t* stream, int on)
+{
+	pthread_mutex_lock(stream->mutex);
+	stream->seqpacket = on ? 1 : 0;
+	pthread_mutex_unlock(stream->mutex);
+}
+
+//This function turns forward error correction on or off for the next connection, see srt_client_setfec.
+void stream_setfec(stream_t* stream, int on)
+{
+	pthread_mutex_lock(stream->mutex);
+	stream->fecWanted = on ? 1 : 0;
+	pthread_mutex_unlock(stream->mutex);
+}
+
+//This function sets how long a read waits for data: timeout_ms milliseconds, or forever if 0.
+void stream_setrecvtimeout(stream_t* stream, unsigned int timeout_ms)
+{
+	pthread_mutex_lock(stream->mutex);
+	stream->recvTimeout = (unsigned long)timeout_ms * 1000000;
+	pthread_mutex_unlock(stream->mutex);
+}
+
+//This function returns 1 if data in the send buffer isn't Acked yet, otherwise 0.
+//The mutex must be held.
+int stream_sendpending(stream_t* stream)
+{
+	return (stream->sendBufHead != NULL);
+}
+
+//This function drops the data waiting in the send buffer and stops the send timers, when this
+//end is done sending. Timer callbacks still running find nothing to do. Data is still received.
+void stream_stopsend(stream_t* stream)
+{
+	pthread_mutex_lock(stream->mutex);
+	stream_freesendbuf(stream);
+	timer_cancel(&stream->flushTimer);
+	timer_cancel(&stream->sendBufTimer);
+	timer_cancel(&stream->pacingTimer);
+	pthread_mutex_unlock(stream->mutex);
+}
+
+//This function stops the receive side, when the peer is done sending: reads waiting for data
+//return what is left, and no more ACKs are sent.
+void stream_stoprecv(stream_t* stream)
+{
+	pthread_mutex_lock(stream->mutex);
+	stream->unAckedSegs = 0;
+	timer_cancel(&stream->delAckTimer);
+	stream->recvShut = 1;
+	pthread_cond_broadcast(&stream->recvCond);
+	pthread_mutex_unlock(stream->mutex);
+}
+
+//This function stops both sides, like stream_stopsend and stream_stoprecv, when the
+//connection is closed.
+void stream_stop(stream_t* stream)
+{
+	stream_stopsend(stream);
+	stream_stoprecv(stream);
+}
+
+//This function stops the timers, waiting for running callbacks, drops the segments queued
+//on the flow and frees the buffers. Call it before freeing the TCB holding the stream.
+void stream_destroy(stream_t* stream)
+{
+	timer_cancel_sync(&stream->flushTimer);
+	timer_cancel_sync(&stream->sendBufTimer);
+	timer_cancel_sync(&stream->pacingTimer);
+	timer_cancel_sync(&stream->delAckTimer);
+	txsched_flowclose(stream->sched, stream->txFlow);
+
+	pthread_mutex_lock(stream->mutex);
+	stream_freesendbuf(stream);
+	if (stream->recvBuf != NULL) {
+		bufpool_free(stream->recvBuf, stream->recvBufSize);
+		stream->recvBuf = NULL;
+	}
+	free(stream->recvEor);
+	stream->recvEor = NULL;
+	if (stream->fec != NULL) {
+		fec_destroy(stream->fec);
+		stream->fec = NULL;
+	}
+	pthread_mutex_unlock(stream->mutex);
+	pthread_cond_destroy(&stream->drainCond);
+	pthread_cond_destroy(&stream->recvCond);
+}
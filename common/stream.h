@@ -0,0 +1,275 @@
+//FILE: common/stream.h
+//
+//Description: this file defines the data transfer of a SRT connection, shared by the SRT client
+//and server. Each TCB embeds a stream, which carries data in both directions: the send side
+//keeps the GBN send buffer with its retransmission, pacing and coalescing state, the receive
+//side keeps the receive buffer, which grows and shrinks with the traffic and where segments
+//received out of order wait for the gap before them to be filled, and the delayed-ACK state.
+//Every DATA segment carries the cumulative ACK of the receive side in ack_num, so a DATAACK
+//is only sent when there is no reverse data to piggyback it on. With forward error correction,
+//DATAFEC parity segments let the receiver rebuild lost data without waiting for a retransmission.
+//A SRT_SEQPACKET stream carries messages: each send is flagged at its last segment, and the
+//receiver marks where each message ends in the receive buffer, so reads return whole messages.
+//
+//Date: October 19, 2026
+
+#ifndef STREAM_H
+#define STREAM_H
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+#include "seg.h"
+#include "fec.h"
+#include "timer.h"
+#include "txsched.h"
+
+//flags of stream_read, srt_client_read and srt_server_read
+#define SRT_WAITALL 0x1		//wait until all length bytes are received
+
+//socket types of srt_client_socktype and srt_server_socktype
+#define SRT_STREAM 0		//a byte stream, sends may be merged and split by the reader
+#define SRT_SEQPACKET 1		//reliable messages, each send is received whole by one read
+#define SRT_DGRAM 2		//unreliable datagrams without a connection, see dgram.h
+
+//a read-only view of data in the receive buffer, lent to the app without copying
+typedef struct srt_view {
+	const char* data;		//first byte of the data
+	unsigned int length;		//number of bytes
+} srt_view_t;
+
+//a piece of a file mapped by stream_sendfile. It stays mapped until the last segment sent from
+//it is Acked, retransmissions read the data from the mapping again.
+typedef struct filechunk {
+	void* addr;			//start of the mapping
+	size_t mapLen;			//length of the mapping
+	unsigned int segs;		//segments in the send buffer with their data in the mapping
+} filechunk_t;
+
+//unit to store segments in send buffer linked list.
+typedef struct segBuf {
+	unsigned long sentTime;		//monotonic time in microseconds the segment was last sent
+	int retransmitted;		//1 if the segment was sent more than once, its ACK gives no RTT sample
+	struct segBuf* next;
+	unsigned int path;		//path the segment was last sent on
+	filechunk_t* chunk;		//mapped file the data is sent from, NULL if the data is in seg
+	const char* fileData;		//first byte of the data in chunk
+	seg_t seg;			//a segment sent from a file has only its header allocated
+} segBuf_t;
+
+//an overlay path the segments of a stream are striped over in multipath mode
+typedef struct srt_path {
+	unsigned long srtt;		//smoothed round trip time in microseconds of the segments sent on it, 0 until the first sample
+	unsigned int sent;		//segments sent on it in this loss epoch
+	unsigned int lost;		//segments lost on it and retransmitted in this loss epoch
+	unsigned int lossPct;		//smoothed percentage of its segments lost
+	unsigned long vtime;		//advanced by the cost of the path for every new segment sent on it
+} srt_path_t;
+
+//a range of sequence numbers received out of order, kept in the receive buffer beyond the in-order data
+typedef struct reasm_range {
+	unsigned int start;		//first sequence number of the range
+	unsigned int end;		//sequence number after the range
+} reasm_range_t;
+
+//the data transfer state of a connection. It must be set up with stream_init() and
+//stream_open() before data is sent or received.
+typedef struct stream {
+	pthread_mutex_t* mutex;		//the TCB's bufMutex, protects everything below
+	txsched_t* sched;		//transmit scheduler the segments are sent through
+	txsched_flow_t* txFlow;		//the TCB's flow on the scheduler
+	unsigned int localPort;		//port of this end
+	int remoteNode;			//node ID of the peer
+	unsigned int remotePort;	//port of the peer
+	unsigned int mss;		//maximum segment data length, agreed in SYN/SYNACK
+	int timestamps;			//1 if both ends stamp their segments, agreed in SYN/SYNACK
+	unsigned int tsRecent;		//newest tsval received from the peer, echoed in tsecr
+	int tsRecentValid;		//1 once a stamped segment was received
+	int fecWanted;			//1 if forward error correction is asked for in SYN/SYNACK
+	fec_t* fec;			//parity state if both ends agreed to forward error correction, NULL otherwise
+	int seqpacket;			//1 for a SRT_SEQPACKET stream, which keeps the boundaries of the messages sent
+
+	//send side
+	unsigned int initSeqNum;	//sequence number the data of this end starts at, announced in SYN/SYNACK
+	unsigned int next_seqNum;	//next sequence number to be used by new segment
+	segBuf_t* sendBufHead;		//head of send buffer
+	segBuf_t* sendBufunSent;	//first unsent segment in send buffer
+	segBuf_t* sendBufTail;		//tail of send buffer
+	unsigned int unAck_segNum;	//number of sent-but-not-Acked segments
+	unsigned int sndWndEdge;	//the peer's receive window ends before this sequence number
+	int windowProbe;		//1 if the next segment is sent even beyond sndWndEdge, to learn the peer's window
+	unsigned int dupAcks;		//DATAACKs in a row that Acked nothing new
+	int recovering;			//1 while retransmitting the segments the peer is missing after a loss
+	unsigned int recoverSeq;	//recovery ends when everything sent before the loss, up to here, is Acked
+	int coalesce;			//1 if small writes are merged into a held partial tail segment while data is unAcked
+	int corked;			//1 while the app holds back partial segments
+	unsigned int pushSeq;		//data below this sequence number is never held back
+	unsigned long flushTimeout;	//longest time in nanoseconds a partial segment is held back
+	srt_timer_t flushTimer;		//sends a held partial segment after flushTimeout
+	srt_timer_t sendBufTimer;	//retransmission timer, armed while segments are unAcked
+	unsigned long srtt;		//smoothed round trip time in microseconds, 0 until the first sample
+	int pacing;			//1 if transmissions are spaced out by the pacer
+	unsigned long pacingRate;	//fixed pacing rate in bytes per second, 0 derives it from GBN_WINDOW and srtt
+	unsigned int pacingBurst;	//segments released back-to-back per pacing slot
+	unsigned long nextSendTime;	//monotonic time in nanoseconds of the next pacing slot
+	srt_timer_t pacingTimer;	//releases the next burst at nextSendTime
+	pthread_cond_t drainCond;	//signaled when the send buffer becomes empty or a file chunk was unmapped
+	unsigned int fileChunks;	//file chunks mapped for segments in the send buffer
+	unsigned long linger;		//longest time in nanoseconds closing waits for the send buffer to drain, 0 drops it at once
+	unsigned int paths;		//number of overlay paths the segments are striped over, 1 sends them all on the routing table's route
+	srt_path_t path[MULTIPATH_MAX_PATHS];	//the state of the paths
+
+	//receive side
+	unsigned int expect_seqNum;	//the expecting data sequence number
+	char* recvBuf;			//the receive buffer, a ring of recvBufSize bytes from the buffer pool, NULL until stream_open
+	unsigned int recvBufSize;	//size of recvBuf, a power of two, only the reader changes it
+	unsigned int recvBufTarget;	//size recvBuf is shrinking to, only this much is offered in the window
+	atomic_uint recvHead;		//bytes taken out by the reader so far, only stream_read moves it
+	atomic_uint recvTail;		//in-order bytes added so far, only moved with the mutex held
+	atomic_uchar* recvEor;		//SRT_SEQPACKET: one bit per byte of recvBuf, set at the last byte of each message
+	reasm_range_t reasm[REASM_MAX_RANGES];	//data received out of order, sorted and disjoint
+	unsigned int reasmCount;	//number of ranges in reasm
+	pthread_cond_t recvCond;	//signaled when data is added to the receive buffer or the stream is stopped
+	unsigned long recvTimeout;	//longest time in nanoseconds a read waits for data, 0 waits forever
+	int recvShut;			//1 once the stream is stopped, reads return what is left instead of waiting
+	unsigned int advWin;		//receive window in bytes last advertised in rcv_win
+	unsigned int rcvWndEdge;	//the peer may send data up to this sequence number
+	int rcvLimited;			//1 if the peer filled the window since the last read, the window limits its sending
+	unsigned int recvPeak;		//most bytes of the ring in use since tuneTime
+	unsigned long tuneTime;		//monotonic time in nanoseconds the use of the ring was last checked
+	unsigned int ackEvery;		//number of in-order DATA segments acknowledged by one DATAACK
+	unsigned long ackDelay;		//longest time in nanoseconds a DATAACK is delayed
+	unsigned int unAckedSegs;	//DATA segments received since the last ACK went out
+	int gapPending;			//1 after an out-of-order segment, the next in-order segment is Acked at once
+	srt_timer_t delAckTimer;	//sends the delayed DATAACK after ackDelay
+} stream_t;
+
+//This function sets up an empty stream of a TCB, locked by the TCB's mutex and sending on
+//its flow of the scheduler. The receive buffer is only taken when the stream is opened.
+void stream_init(stream_t* stream, pthread_mutex_t* mutex, txsched_t* sched, txsched_flow_t* txFlow);
+
+//This function copies the options set on parent, like linger and the delayed-ACK policy, to
+//the stream of a connection accepted on it. The mutex of parent must be held.
+void stream_inherit(stream_t* stream, stream_t* parent);
+
+//This function picks the initial sequence number of the send side for the connection from
+//localPort to remotePort on remoteNode. The mutex must be held.
+void stream_pickisn(stream_t* stream, unsigned int localPort, int remoteNode, unsigned int remotePort);
+
+//This function starts the stream of a connection being established with the peer remotePort
+//on remoteNode, whose data starts at sequence number expect_seqNum, and takes a receive
+//buffer of RECV_BUF_MIN bytes. The mutex must be held.
+void stream_open(stream_t* stream, unsigned int localPort, int remoteNode, unsigned int remotePort, unsigned int expect_seqNum, unsigned int mss);
+
+//This function starts forward error correction on the opened stream, when both ends agreed to
+//it in SYN/SYNACK. The mutex must be held.
+void stream_startfec(stream_t* stream);
+
+//This function queues length bytes of data in the send buffer, in segments of up to mss
+//bytes, and sends as many as the GBN window allows. Returns 1.
+int stream_send(stream_t* stream, void* data, unsigned int length);
+
+//This function waits until data is in the receive buffer and takes out up to length bytes,
+//or with SRT_WAITALL keeps taking data out as it arrives until length bytes were read.
+//Returns the number of bytes read, which is less than length only if the stream was stopped,
+//or -1 if the receive timeout expired before any data was read.
+//Only one thread may read a stream at a time.
+int stream_read(stream_t* stream, void* buf, unsigned int length, int flags);
+
+//This function waits until a whole message is in the receive buffer of a SRT_SEQPACKET stream
+//and takes it out into buf. A message longer than length is cut short, the rest of it is dropped.
+//Returns the number of bytes read, 0 if the stream was stopped and all messages were read, or -1
+//if the receive timeout expired first. Only one thread may read a stream at a time.
+int stream_recvmsg(stream_t* stream, void* buf, unsigned int length);
+
+//This function waits until length bytes are received, like stream_read with SRT_WAITALL.
+//Returns 1, or -1 if they didn't arrive before the receive timeout or the stream was stopped.
+int stream_recv(stream_t* stream, void* buf, unsigned int length);
+
+//This function waits until data is in the receive buffer, like stream_read, and lends up to
+//length bytes of it in views, without copying: the first view is the data up to the end of the
+//ring, the second one the rest, or empty. Returns the number of bytes lent, 0 if the stream was
+//stopped and all data was read, or -1 if the receive timeout expired first.
+//The views stay valid until stream_release. Only one thread may read a stream at a time.
+int stream_lend(stream_t* stream, srt_view_t views[2], unsigned int length);
+
+//This function frees the first length bytes of the receive buffer, lent by stream_lend, and
+//reopens the window. Views of the rest of the data aren't valid afterwards.
+//Returns 1, or -1 if there are less than length bytes in the receive buffer.
+int stream_release(stream_t* stream, unsigned int length);
+
+//This function adds data received in order outside a DATA segment, like fast open data on
+//a SYN, to the receive buffer. The mutex must be held. Returns 1, or 0 if it doesn't fit.
+int stream_deliver(stream_t* stream, char* data, unsigned int length);
+
+//This function handles a DATA or DATAACK segment of the connection: it frees the segments
+//its ACK covers, takes the peer's receive window and stores its data, then sends what the
+//windows allow and the ACK. A DATAFEC segment rebuilds data lost from the parity it carries.
+void stream_input(stream_t* stream, seg_t* segPtr);
+
+//This function sends length bytes of the file fd, starting at offset, like stream_send but
+//without copying the file into the send buffer: the segments are cut from chunks of the file
+//mapped with mmap, and waits while SENDFILE_CHUNKS chunks are waiting for ACKs.
+//Returns 1 once all data is queued, -1 if offset + length is past the end of the file, the file
+//can't be mapped, the stream was stopped or the peer Acked no chunk for SENDFILE_TIMEOUT.
+int stream_sendfile(stream_t* stream, int fd, off_t offset, unsigned long length);
+
+//This function sends held back partial segments, as far as the GBN window allows.
+//Returns 1 for success or -1 for failure.
+int stream_flush(stream_t* stream);
+
+//This function sends held back partial segments and waits until all data in the send buffer
+//is Acked, at most timeout nanoseconds. Returns 1 if the send buffer drained, -1 otherwise.
+int stream_drain(stream_t* stream, unsigned long timeout);
+
+//This function turns small-write coalescing on or off, with a flush timeout of
+//flushTimeout_ms milliseconds (COALESCE_FLUSH_TIMEOUT if 0). Returns 1 for success or -1 for failure.
+int stream_setcoalesce(stream_t* stream, int on, unsigned int flushTimeout_ms);
+
+//This function corks or uncorks the stream. Returns 1 for success or -1 for failure.
+int stream_cork(stream_t* stream, int corked);
+
+//This function sets the pacer, see srt_client_setpacing. Returns 1 for success or -1 for failure.
+int stream_setpacing(stream_t* stream, int on, unsigned int rate, unsigned int burst);
+
+//This function sets the delayed-ACK policy, see srt_server_setdelack.
+void stream_setdelack(stream_t* stream, unsigned int ackEvery, unsigned int ackDelay_ms);
+
+//This function sets how long closing waits for the send buffer to drain: linger_ms
+//milliseconds (LINGER_TIMEOUT if 0) if on, not at all if off.
+void stream_setlinger(stream_t* stream, int on, unsigned int linger_ms);
+
+//This function sets the number of paths the segments are striped over, see srt_client_setmultipath.
+void stream_setmultipath(stream_t* stream, unsigned int paths);
+
+//This function makes the stream a SRT_SEQPACKET stream if on, a SRT_STREAM one otherwise. It
+//must be set before the stream is opened.
+void stream_setseqpacket(stream_t* stream, int on);
+
+//This function turns forward error correction on or off for the next connection, see srt_client_setfec.
+void stream_setfec(stream_t* stream, int on);
+
+//This function sets how long a read waits for data: timeout_ms milliseconds, or forever if 0.
+void stream_setrecvtimeout(stream_t* stream, unsigned int timeout_ms);
+
+//This function returns 1 if data in the send buffer isn't Acked yet, otherwise 0.
+//The mutex must be held.
+int stream_sendpending(stream_t* stream);
+
+//This function drops the data waiting in the send buffer and stops the send timers, when this
+//end is done sending. Timer callbacks still running find nothing to do. Data is still received.
+void stream_stopsend(stream_t* stream);
+
+//This function stops the receive side, when the peer is done sending: reads waiting for data
+//return what is left, and no more ACKs are sent.
+void stream_stoprecv(stream_t* stream);
+
+//This function stops both sides, like stream_stopsend and stream_stoprecv, when the
+//connection is closed.
+void stream_stop(stream_t* stream);
+
+//This function stops the timers, waiting for running callbacks, drops the segments queued
+//on the flow and frees the buffers. Call it before freeing the TCB holding the stream.
+void stream_destroy(stream_t* stream);
+
+#endif
@@ -0,0 +1,269 @@
+//FILE: common/timer.c
+//
+//Description: this file implements the timer service shared by the SRT client and server.
+//
+//Date: October 19, 2026
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/time.h>
+#include <pthread.h>
+#include "constants.h"
+#include "timer.h"
+
+#ifdef __MACH__
+#include <mach/clock.h>
+#include <mach/mach.h>
+#endif
+
+//initial number of slots in the timer heap, the heap doubles when it is full
+#define TIMER_HEAP_INIT_SIZE 64
+
+static pthread_mutex_t timerMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t timerCond;		//signaled when the earliest deadline changes
+static pthread_cond_t timerDoneCond;		//signaled when a callback returns
+static pthread_once_t timerOnce = PTHREAD_ONCE_INIT;
+static pthread_t timerThread;
+static srt_timer_t** timerHeap = NULL;		//armed timers, min-heap ordered by deadline
+static int timerHeapLen = 0;
+static int timerHeapSize = 0;
+static srt_timer_t* runningTimer = NULL;	//timer whose callback is running
+
+//This function returns the current monotonic time in nanoseconds.
+unsigned long timer_now_ns()
+{
+#ifdef __MACH__ // OS X does not have clock_gettime, use clock_get_time
+	clock_serv_t cclock;
+	mach_timespec_t mts;
+	host_get_clock_service(mach_host_self(), SYSTEM_CLOCK, &cclock);
+	clock_get_time(cclock, &mts);
+	mach_port_deallocate(mach_task_self(), cclock);
+	return mts.tv_nsec + (unsigned long)mts.tv_sec*NANOSECONDS_PER_SECOND;
+#else
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_nsec + (unsigned long)ts.tv_sec*NANOSECONDS_PER_SECOND;
+#endif
+}
+
+//swaps heap slots i and j and updates the timers' heap indexes
+static void heap_swap(int i, int j)
+{
+	srt_timer_t* temp = timerHeap[i];
+	timerHeap[i] = timerHeap[j];
+	timerHeap[j] = temp;
+	timerHeap[i]->heapIdx = i;
+	timerHeap[j]->heapIdx = j;
+}
+
+//moves the timer in slot idx up or down until the heap is ordered again
+static void heap_fix(int idx)
+{
+	while (idx > 0 && timerHeap[(idx - 1) / 2]->deadline > timerHeap[idx]->deadline) {
+		heap_swap(idx, (idx - 1) / 2);
+		idx = (idx - 1) / 2;
+	}
+	while (1) {
+		int smallest = idx;
+		int left = 2 * idx + 1;
+		int right = 2 * idx + 2;
+		if (left < timerHeapLen && timerHeap[left]->deadline < timerHeap[smallest]->deadline)
+			smallest = left;
+		if (right < timerHeapLen && timerHeap[right]->deadline < timerHeap[smallest]->deadline)
+			smallest = right;
+		if (smallest == idx)
+			break;
+		heap_swap(idx, smallest);
+		idx = smallest;
+	}
+}
+
+//removes the timer from the heap, timerMutex must be held
+static void heap_remove(srt_timer_t* timer)
+{
+	int idx = timer->heapIdx;
+	timerHeapLen--;
+	if (idx != timerHeapLen) {
+		timerHeap[idx] = timerHeap[timerHeapLen];
+		timerHeap[idx]->heapIdx = idx;
+		heap_fix(idx);
+	}
+	timer->heapIdx = -1;
+}
+
+//This function sets up a condition variable whose timed waits use the monotonic clock,
+//for use with timer_condwait().
+void timer_condinit(pthread_cond_t* cond)
+{
+	pthread_condattr_t attr;
+	pthread_condattr_init(&attr);
+#ifndef __MACH__
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+#endif
+	pthread_cond_init(cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+//This function waits on the condition variable until it is signaled or the monotonic time
+//reaches deadline (in nanoseconds, as returned by timer_now_ns). The mutex must be held.
+//Returns 0 if signaled, ETIMEDOUT if the deadline passed.
+int timer_condwait(pthread_cond_t* cond, pthread_mutex_t* mutex, unsigned long deadline)
+{
+	struct timespec ts;
+#ifdef __MACH__
+	//condition variables wait on the wall clock here, convert the deadline
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	unsigned long now = timer_now_ns();
+	unsigned long abs = tv.tv_sec*(unsigned long)NANOSECONDS_PER_SECOND + tv.tv_usec*1000UL;
+	abs += (deadline > now) ? deadline - now : 0;
+	ts.tv_sec = abs / NANOSECONDS_PER_SECOND;
+	ts.tv_nsec = abs % NANOSECONDS_PER_SECOND;
+#else
+	ts.tv_sec = deadline / NANOSECONDS_PER_SECOND;
+	ts.tv_nsec = deadline % NANOSECONDS_PER_SECOND;
+#endif
+	return pthread_cond_timedwait(cond, mutex, &ts);
+}
+
+//This thread sleeps until the earliest deadline and runs the callbacks of expired timers.
+//Callbacks run without timerMutex held, so they can arm and cancel timers.
+static void* timer_thread(void* arg)
+{
+	pthread_mutex_lock(&timerMutex);
+	while (1) {
+		if (timerHeapLen == 0) {
+			pthread_cond_wait(&timerCond, &timerMutex);
+			continue;
+		}
+		srt_timer_t* timer = timerHeap[0];
+		if (timer->deadline > timer_now_ns()) {
+			timer_condwait(&timerCond, &timerMutex, timer->deadline);
+			continue;
+		}
+		heap_remove(timer);
+		runningTimer = timer;
+		pthread_mutex_unlock(&timerMutex);
+
+		timer->fn(timer->arg);
+
+		pthread_mutex_lock(&timerMutex);
+		runningTimer = NULL;
+		pthread_cond_broadcast(&timerDoneCond);
+	}
+	return NULL;
+}
+
+//sets up the condition variables and starts the timer thread, called once
+static void timer_start()
+{
+	timer_condinit(&timerCond);
+	pthread_cond_init(&timerDoneCond, NULL);
+
+	timerHeapSize = TIMER_HEAP_INIT_SIZE;
+	timerHeap = malloc(sizeof(srt_timer_t*) * timerHeapSize);
+	MALLOC_CHECK(timerHeap);
+
+	if (pthread_create(&timerThread, NULL, timer_thread, NULL)) {
+		printf("Error creating timer thread.\n");
+	}
+}
+
+//This function sets up a timer that calls fn(arg) when it expires. The timer is not armed.
+void timer_init(srt_timer_t* timer, srt_timer_fn fn, void* arg)
+{
+	memset(timer, 0, sizeof(srt_timer_t));
+	timer->fn = fn;
+	timer->arg = arg;
+	timer->heapIdx = -1;
+}
+
+//arms the timer at the given deadline unless it is dead, timerMutex must be held
+static void timer_arm_locked(srt_timer_t* timer, unsigned long deadline)
+{
+	if (timer->dead) {
+		return;
+	}
+	timer->deadline = deadline;
+	if (timer->heapIdx < 0) {
+		if (timerHeapLen == timerHeapSize) {
+			timerHeapSize *= 2;
+			timerHeap = realloc(timerHeap, sizeof(srt_timer_t*) * timerHeapSize);
+			MALLOC_CHECK(timerHeap);
+		}
+		timer->heapIdx = timerHeapLen;
+		timerHeap[timerHeapLen++] = timer;
+	}
+	heap_fix(timer->heapIdx);
+	//wake the timer thread if this is the new earliest deadline
+	if (timerHeap[0] == timer) {
+		pthread_cond_signal(&timerCond);
+	}
+}
+
+//This function arms the timer to expire delay_ns nanoseconds from now.
+//If the timer is already armed, its deadline is moved.
+//The timer thread is started the first time a timer is armed.
+//Nothing is done once timer_cancel_sync() was called on the timer.
+void timer_arm(srt_timer_t* timer, unsigned long delay_ns)
+{
+	pthread_once(&timerOnce, timer_start);
+	pthread_mutex_lock(&timerMutex);
+	timer_arm_locked(timer, timer_now_ns() + delay_ns);
+	pthread_mutex_unlock(&timerMutex);
+}
+
+//This function arms the timer to expire delay_ns nanoseconds from now, unless it is already
+//armed to expire earlier.
+void timer_arm_before(srt_timer_t* timer, unsigned long delay_ns)
+{
+	pthread_once(&timerOnce, timer_start);
+	pthread_mutex_lock(&timerMutex);
+	unsigned long deadline = timer_now_ns() + delay_ns;
+	if (timer->heapIdx < 0 || deadline < timer->deadline) {
+		timer_arm_locked(timer, deadline);
+	}
+	pthread_mutex_unlock(&timerMutex);
+}
+
+//This function returns 1 if the timer is armed, otherwise 0.
+int timer_armed(srt_timer_t* timer)
+{
+	pthread_mutex_lock(&timerMutex);
+	int armed = (timer->heapIdx >= 0);
+	pthread_mutex_unlock(&timerMutex);
+	return armed;
+}
+
+//This function disarms the timer if it is armed. It doesn't wait for a callback that is
+//already running, so it can be called while holding a lock the callback takes.
+void timer_cancel(srt_timer_t* timer)
+{
+	pthread_mutex_lock(&timerMutex);
+	if (timer->heapIdx >= 0) {
+		heap_remove(timer);
+	}
+	pthread_mutex_unlock(&timerMutex);
+}
+
+//This function disarms the timer and waits until its callback is no longer running.
+//Use it before freeing the memory holding the timer. It must not be called while
+//holding a lock the callback takes. The timer can't be armed again, so a callback that
+//re-arms it while this function waits doesn't leave it in the heap; timer_init() revives it.
+void timer_cancel_sync(srt_timer_t* timer)
+{
+	pthread_mutex_lock(&timerMutex);
+	timer->dead = 1;
+	if (timer->heapIdx >= 0) {
+		heap_remove(timer);
+	}
+	//a callback that cancels its own timer must not wait for itself
+	if (timerHeap != NULL && !pthread_equal(pthread_self(), timerThread)) {
+		while (runningTimer == timer) {
+			pthread_cond_wait(&timerDoneCond, &timerMutex);
+		}
+	}
+	pthread_mutex_unlock(&timerMutex);
+}
@@ -0,0 +1,66 @@
+//FILE: common/timer.h
+//
+//Description: this file defines the timer service shared by the SRT client and server.
+//One thread per process keeps all armed timers in a min-heap ordered by deadline and
+//sleeps until the earliest one expires, so idle timers cost no CPU. Deadlines are taken
+//from the monotonic clock, so they are not affected by changes of the wall clock.
+//
+//Date: October 19, 2026
+
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <pthread.h>
+
+//callback run by the timer thread when a timer expires
+typedef void (*srt_timer_fn)(void* arg);
+
+//a timer. It is usually embedded in the structure it works on (e.g. a TCB)
+//and must be set up with timer_init() before it is armed.
+typedef struct srt_timer {
+	unsigned long deadline;		//monotonic time in nanoseconds at which the timer expires
+	srt_timer_fn fn;		//callback run when the timer expires
+	void* arg;			//argument passed to fn
+	int heapIdx;			//position in the timer heap, -1 if the timer is not armed
+	int dead;			//set by timer_cancel_sync(), arming the timer is then a no-op
+} srt_timer_t;
+
+//This function returns the current monotonic time in nanoseconds.
+unsigned long timer_now_ns();
+
+//This function sets up a timer that calls fn(arg) when it expires. The timer is not armed.
+void timer_init(srt_timer_t* timer, srt_timer_fn fn, void* arg);
+
+//This function arms the timer to expire delay_ns nanoseconds from now.
+//If the timer is already armed, its deadline is moved.
+//The timer thread is started the first time a timer is armed.
+//Nothing is done once timer_cancel_sync() was called on the timer.
+void timer_arm(srt_timer_t* timer, unsigned long delay_ns);
+
+//This function arms the timer to expire delay_ns nanoseconds from now, unless it is already
+//armed to expire earlier.
+void timer_arm_before(srt_timer_t* timer, unsigned long delay_ns);
+
+//This function returns 1 if the timer is armed, otherwise 0.
+int timer_armed(srt_timer_t* timer);
+
+//This function disarms the timer if it is armed. It doesn't wait for a callback that is
+//already running, so it can be called while holding a lock the callback takes.
+void timer_cancel(srt_timer_t* timer);
+
+//This function disarms the timer and waits until its callback is no longer running.
+//Use it before freeing the memory holding the timer. It must not be called while
+//holding a lock the callback takes. The timer can't be armed again, so a callback that
+//re-arms it while this function waits doesn't leave it in the heap; timer_init() revives it.
+void timer_cancel_sync(srt_timer_t* timer);
+
+//This function sets up a condition variable whose timed waits use the monotonic clock,
+//for use with timer_condwait().
+void timer_condinit(pthread_cond_t* cond);
+
+//This function waits on the condition variable until it is signaled or the monotonic time
+//reaches deadline (in nanoseconds, as returned by timer_now_ns). The mutex must be held.
+//Returns 0 if signaled, ETIMEDOUT if the deadline passed.
+int timer_condwait(pthread_cond_t* cond, pthread_mutex_t* mutex, unsigned long deadline);
+
+#endif
@@ -0,0 +1,222 @@
+//FILE: common/txsched.c
+//
+//Description: this file implements the transmit scheduler shared by the SRT client and server.
+//
+//Date: October 19, 2026
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <errno.h>
+#include <pthread.h>
+#include "constants.h"
+#include "timer.h"
+#include "txsched.h"
+
+//appends the flow to the round robin list of its priority, sched->mutex must be held
+static void txsched_activate(txsched_t* sched, txsched_flow_t* flow)
+{
+	txsched_list_t* list = &sched->lists[flow->priority];
+	flow->prev = list->tail;
+	flow->next = NULL;
+	if (list->tail == NULL) {
+		list->head = flow;
+	} else {
+		list->tail->next = flow;
+	}
+	list->tail = flow;
+	flow->active = 1;
+}
+
+//removes the flow from the round robin list of its priority, sched->mutex must be held
+static void txsched_deactivate(txsched_t* sched, txsched_flow_t* flow)
+{
+	txsched_list_t* list = &sched->lists[flow->priority];
+	if (flow->prev == NULL) {
+		list->head = flow->next;
+	} else {
+		flow->prev->next = flow->next;
+	}
+	if (flow->next == NULL) {
+		list->tail = flow->prev;
+	} else {
+		flow->next->prev = flow->prev;
+	}
+	flow->prev = NULL;
+	flow->next = NULL;
+	flow->active = 0;
+	flow->granted = 0;
+}
+
+//takes the next segment to send by priority and deficit round robin, sched->mutex must be held.
+//Returns NULL if no flow has queued segments.
+static txsched_item_t* txsched_next(txsched_t* sched)
+{
+	for (int priority = 0; priority < TXSCHED_PRIORITIES; priority++) {
+		txsched_list_t* list = &sched->lists[priority];
+		while (list->head != NULL) {
+			txsched_flow_t* flow = list->head;
+			if (!flow->granted) {
+				flow->deficit += (unsigned long)flow->weight * TXSCHED_QUANTUM;
+				flow->granted = 1;
+			}
+			txsched_item_t* item = flow->head;
+			if (item->len <= flow->deficit) {
+				flow->deficit -= item->len;
+				flow->head = item->next;
+				if (flow->head == NULL) {
+					//an idle flow doesn't save up its deficit
+					flow->tail = NULL;
+					flow->deficit = 0;
+					txsched_deactivate(sched, flow);
+					pthread_cond_broadcast(&sched->idleCond);
+				}
+				return item;
+			}
+			//the flow used up its turn, move it to the end of the round
+			txsched_deactivate(sched, flow);
+			txsched_activate(sched, flow);
+		}
+	}
+	return NULL;
+}
+
+//This thread sends the queued segments on the SNP connection, picking them with txsched_next.
+static void* txsched_thread(void* arg)
+{
+	txsched_t* sched = (txsched_t*)arg;
+
+	pthread_mutex_lock(&sched->mutex);
+	while (1) {
+		txsched_item_t* item = txsched_next(sched);
+		if (item == NULL) {
+			pthread_cond_wait(&sched->cond, &sched->mutex);
+			continue;
+		}
+		pthread_mutex_unlock(&sched->mutex);
+
+		if (snp_sendsegpath(sched->conn, item->destNode, item->path, &item->seg) < 0) {
+			printf("Error sending seg_t with seq_num %u.\n", item->seg.header.seq_num);
+		}
+		free(item);
+
+		pthread_mutex_lock(&sched->mutex);
+	}
+	return NULL;
+}
+
+//This function starts a scheduler and its writer thread sending on the SNP connection conn.
+//Returns the scheduler, or NULL if the writer thread couldn't be started.
+txsched_t* txsched_start(int conn)
+{
+	txsched_t* sched = malloc(sizeof(txsched_t));
+	MALLOC_CHECK(sched);
+	memset(sched, 0, sizeof(txsched_t));
+	sched->conn = conn;
+	pthread_mutex_init(&sched->mutex, NULL);
+	pthread_cond_init(&sched->cond, NULL);
+	timer_condinit(&sched->idleCond);
+
+	if (pthread_create(&sched->thread, NULL, txsched_thread, sched)) {
+		printf("Error creating transmit scheduler thread.\n");
+		return NULL;
+	}
+	pthread_detach(sched->thread);
+	return sched;
+}
+
+//This function sets up an empty flow with weight 1 and TXSCHED_DEFAULT_PRIORITY.
+void txsched_flowinit(txsched_flow_t* flow)
+{
+	memset(flow, 0, sizeof(txsched_flow_t));
+	flow->weight = 1;
+	flow->priority = TXSCHED_DEFAULT_PRIORITY;
+}
+
+//This function sets the flow's weight (1 if 0) and priority (at most TXSCHED_PRIORITIES - 1).
+void txsched_setflow(txsched_t* sched, txsched_flow_t* flow, unsigned int weight, unsigned int priority)
+{
+	pthread_mutex_lock(&sched->mutex);
+	int active = flow->active;
+	if (active) {
+		txsched_deactivate(sched, flow);
+	}
+	flow->weight = (weight > 0) ? weight : 1;
+	flow->priority = min(priority, TXSCHED_PRIORITIES - 1);
+	if (active) {
+		txsched_activate(sched, flow);
+	}
+	pthread_mutex_unlock(&sched->mutex);
+}
+
+//This function queues a copy of the segment on the flow, to be sent to destNode by the writer.
+//Segments of a flow are sent in the order they are queued. Returns 1.
+int txsched_send(txsched_t* sched, txsched_flow_t* flow, int destNode, seg_t* segPtr)
+{
+	return txsched_senddata(sched, flow, destNode, 0, &segPtr->header, segPtr->data);
+}
+
+//This function queues a segment made of a copy of the header and of the header->length bytes
+//at data, like txsched_send, for data kept apart from its header, to be sent on path number path
+//to destNode, see snp_sendsegpath. Returns 1.
+int txsched_senddata(txsched_t* sched, txsched_flow_t* flow, int destNode, int path, srt_hdr_t* header, const char* data)
+{
+	int segLen = sizeof(srt_hdr_t) + header->length;
+	txsched_item_t* item = malloc(offsetof(txsched_item_t, seg) + segLen);
+	MALLOC_CHECK(item);
+	item->seg.header = *header;
+	memcpy(item->seg.data, data, header->length);
+	item->destNode = destNode;
+	item->path = path;
+	item->len = segLen;
+	item->next = NULL;
+
+	pthread_mutex_lock(&sched->mutex);
+	if (flow->tail == NULL) {
+		flow->head = item;
+	} else {
+		flow->tail->next = item;
+	}
+	flow->tail = item;
+	if (!flow->active) {
+		txsched_activate(sched, flow);
+		pthread_cond_signal(&sched->cond);
+	}
+	pthread_mutex_unlock(&sched->mutex);
+	return 1;
+}
+
+//This function waits until the writer took all segments queued on the flow, at most timeout_ns
+//nanoseconds. Returns 1 if the flow is empty, -1 if the timeout passed first.
+int txsched_flowflush(txsched_t* sched, txsched_flow_t* flow, unsigned long timeout_ns)
+{
+	unsigned long deadline = timer_now_ns() + timeout_ns;
+	pthread_mutex_lock(&sched->mutex);
+	while (flow->head != NULL) {
+		if (timer_condwait(&sched->idleCond, &sched->mutex, deadline) == ETIMEDOUT) {
+			break;
+		}
+	}
+	int flushed = (flow->head == NULL) ? 1 : -1;
+	pthread_mutex_unlock(&sched->mutex);
+	return flushed;
+}
+
+//This function drops the segments still queued on the flow. Call it before freeing the
+//memory holding the flow.
+void txsched_flowclose(txsched_t* sched, txsched_flow_t* flow)
+{
+	pthread_mutex_lock(&sched->mutex);
+	if (flow->active) {
+		txsched_deactivate(sched, flow);
+	}
+	while (flow->head != NULL) {
+		txsched_item_t* item = flow->head;
+		flow->head = item->next;
+		free(item);
+	}
+	flow->tail = NULL;
+	flow->deficit = 0;
+	pthread_mutex_unlock(&sched->mutex);
+}
@@ -0,0 +1,85 @@
+//FILE: common/txsched.h
+//
+//Description: this file defines the transmit scheduler shared by the SRT client and server.
+//All sockets of a process send over one SNP connection. Instead of writing to it directly,
+//each socket queues its segments on its own flow, and a single writer thread sends them.
+//The writer always serves the highest priority with queued segments, and shares the
+//connection between the flows of a priority by deficit round robin: every round a flow
+//may send weight * TXSCHED_QUANTUM bytes, so a bulk transfer gets its share of the
+//connection but can't hold it while other sockets wait.
+//
+//Date: October 19, 2026
+
+#ifndef TXSCHED_H
+#define TXSCHED_H
+
+#include <pthread.h>
+#include "seg.h"
+
+//a queued segment. Only the used bytes of the segment data are allocated.
+typedef struct txsched_item {
+	struct txsched_item* next;
+	int destNode;			//node ID the segment is sent to
+	int path;			//path hint the segment is sent with, 0 for the routing table's route
+	int len;			//bytes the segment takes on the connection
+	seg_t seg;
+} txsched_item_t;
+
+//the transmit queue of a socket. It is usually embedded in the TCB and
+//must be set up with txsched_flowinit() before segments are queued on it.
+typedef struct txsched_flow {
+	txsched_item_t* head;		//queued segments, sent in order
+	txsched_item_t* tail;
+	unsigned int weight;		//share of the connection relative to the other flows of its priority
+	unsigned int priority;		//0 is served first, TXSCHED_PRIORITIES - 1 last
+	unsigned long deficit;		//bytes the flow may still send in this round
+	int active;			//1 while the flow is in its priority's round robin list
+	int granted;			//1 once the flow got its quantum for the current turn
+	struct txsched_flow* prev;	//neighbours in the round robin list
+	struct txsched_flow* next;
+} txsched_flow_t;
+
+//round robin list of the flows of one priority with queued segments
+typedef struct txsched_list {
+	txsched_flow_t* head;
+	txsched_flow_t* tail;
+} txsched_list_t;
+
+//a transmit scheduler
+typedef struct txsched {
+	int conn;				//SNP connection the segments are sent on
+	pthread_t thread;			//writer thread
+	pthread_mutex_t mutex;			//protects the flows and lists
+	pthread_cond_t cond;			//signaled when a flow becomes active
+	pthread_cond_t idleCond;		//signaled when the writer takes the last segment of a flow
+	txsched_list_t lists[TXSCHED_PRIORITIES];
+} txsched_t;
+
+//This function starts a scheduler and its writer thread sending on the SNP connection conn.
+//Returns the scheduler, or NULL if the writer thread couldn't be started.
+txsched_t* txsched_start(int conn);
+
+//This function sets up an empty flow with weight 1 and TXSCHED_DEFAULT_PRIORITY.
+void txsched_flowinit(txsched_flow_t* flow);
+
+//This function sets the flow's weight (1 if 0) and priority (at most TXSCHED_PRIORITIES - 1).
+void txsched_setflow(txsched_t* sched, txsched_flow_t* flow, unsigned int weight, unsigned int priority);
+
+//This function queues a copy of the segment on the flow, to be sent to destNode by the writer.
+//Segments of a flow are sent in the order they are queued. Returns 1.
+int txsched_send(txsched_t* sched, txsched_flow_t* flow, int destNode, seg_t* segPtr);
+
+//This function queues a segment made of a copy of the header and of the header->length bytes
+//at data, like txsched_send, for data kept apart from its header, to be sent on path number path
+//to destNode, see snp_sendsegpath. Returns 1.
+int txsched_senddata(txsched_t* sched, txsched_flow_t* flow, int destNode, int path, srt_hdr_t* header, const char* data);
+
+//This function waits until the writer took all segments queued on the flow, at most timeout_ns
+//nanoseconds. Returns 1 if the flow is empty, -1 if the timeout passed first.
+int txsched_flowflush(txsched_t* sched, txsched_flow_t* flow, unsigned long timeout_ns);
+
+//This function drops the segments still queued on the flow. Call it before freeing the
+//memory holding the flow.
+void txsched_flowclose(txsched_t* sched, txsched_flow_t* flow);
+
+#endif
@@ -33,6 +33,14 @@
 //network layer waits this time for establishing the routing paths 
 #define NETWORK_WAITTIME 30
 
+//the alternate next hops to a destination, for segments sent with a path hint
+typedef struct pathentry {
+	int destNodeID;			//destination node ID, -1 if the entry is unused
+	int version;			//routesVersion the alternates were found at
+	int count;			//number of alternates
+	int nextNodeID[MAX_NODE_NUM];	//the alternates, by their cost to the destination
+} pathentry_t;
+
 /**************************************************************/
 //delare global variables
 /**************************************************************/
@@ -43,6 +51,8 @@ dv_t* dv;				//distance vector table
 pthread_mutex_t* dv_mutex;		//dvtable mutex
 routingtable_t* routingtable;		//routing table
 pthread_mutex_t* routingtable_mutex;	//routingtable mutex
+int routesVersion;			//counts the changes of the distance vector table, protected by dv_mutex
+pathentry_t pathtable[MAX_NODE_NUM];	//alternate next hops of the destinations, protected by dv_mutex
 
 
 /**************************************************************/
@@ -200,6 +210,9 @@ void* pkthandler(void* arg) {
 			//update DV and routing tables as needed
 			if (needToUpdateDV) {
 				printf("Updated distance vector table.\n");
+				pthread_mutex_lock(dv_mutex);
+				routesVersion++;
+				pthread_mutex_unlock(dv_mutex);
 				dvtable_print(dv);
 				int newMin;
 
@@ -255,6 +268,68 @@ void* pkthandler(void* arg) {
 	pthread_exit(NULL);
 }
 
+//This function finds the alternate next hops to destNodeID, the neighbors other than the routing
+//table's next hop primary that are loop-free alternates (RFC 5286): the neighbor's shortest path to
+//the destination is shorter than its path back to this node and on from here, so it doesn't come back
+//through this node. They are stored in entry by their cost to the destination. dv_mutex must be held.
+static void findAlternates(pathentry_t* entry, int myNodeID, int destNodeID, int primary)
+{
+	unsigned int costs[MAX_NODE_NUM];
+	int nbrNum = topology_getNbrNum();
+	unsigned int myCost = dvtable_getcost(dv, myNodeID, destNodeID);
+
+	entry->destNodeID = destNodeID;
+	entry->version = routesVersion;
+	entry->count = 0;
+	for (int i = 0; i < nbrNum && entry->count < MAX_NODE_NUM; i++) {
+		int nbr = nct[i].nodeID;
+		if (nbr == primary) {
+			continue;
+		}
+		unsigned int nbrCost = (nbr == destNodeID) ? 0 : dvtable_getcost(dv, nbr, destNodeID);
+		if (nbrCost >= INFINITE_COST || nbrCost >= dvtable_getcost(dv, nbr, myNodeID) + myCost) {
+			continue;
+		}
+		//insert by cost, through the neighbor
+		unsigned int cost = nct[i].cost + nbrCost;
+		int j = entry->count++;
+		while (j > 0 && costs[j - 1] > cost) {
+			costs[j] = costs[j - 1];
+			entry->nextNodeID[j] = entry->nextNodeID[j - 1];
+			j--;
+		}
+		costs[j] = cost;
+		entry->nextNodeID[j] = nbr;
+	}
+}
+
+//This function returns the next hop of path number path to destNodeID, for a segment the SRT process
+//sent with a path hint. Path 0 is the routing table's route, paths 1 and up start at the loop-free
+//alternate neighbors, the best one first, and wrap around to the routing table's route when there
+//are fewer alternates than paths. From the next hop on, the segment follows the routing tables.
+//The alternates are kept in pathtable until the distance vector table changes.
+//Returns -1 if the destination is unreachable.
+int getPathNextNode(int myNodeID, int destNodeID, int path)
+{
+	pthread_mutex_lock(routingtable_mutex);
+	int primary = routingtable_getnextnode(routingtable, destNodeID);
+	pthread_mutex_unlock(routingtable_mutex);
+	if (path <= 0 || primary < 0) {
+		return primary;
+	}
+
+	pthread_mutex_lock(dv_mutex);
+	pathentry_t *entry = &pathtable[destNodeID % MAX_NODE_NUM];
+	if (entry->destNodeID != destNodeID || entry->version != routesVersion) {
+		findAlternates(entry, myNodeID, destNodeID, primary);
+		printf("Found %d alternate next hops to dest_nodeID %d.\n", entry->count, destNodeID);
+	}
+	int k = path % (entry->count + 1);
+	int nextNode = (k == 0) ? primary : entry->nextNodeID[k - 1];
+	pthread_mutex_unlock(dv_mutex);
+	return nextNode;
+}
+
 //This function stops the SNP process. 
 //It closes all the connections and frees all the dynamically allocated memory.
 //It is called when the SNP process receives a signal SIGINT.
@@ -281,6 +356,7 @@ void network_stop() {
 // the segments and their destination node addresses from the SRT process. The received segments are then
 // encapsulated into packets (one segment in one packet), and sent to the next hop using overlay_sendpkt. 
 //The next hop is retrieved from routing table.
+//Segments sent with a path hint go to the next hop of their path instead, see getPathNextNode.
 //When a local SRT process is disconnected, this function waits for the next SRT process to connect.
 void waitTransport() {
 	int tcpserv_sd;
@@ -311,15 +387,14 @@ void waitTransport() {
 		printf("Error accepting connection from SRT.\n");
 
 
-	int dest_nodeID, nextNode;
+	int dest_nodeID, path, nextNode;
 	seg_t segment;
 	snp_pkt_t packet;
 	packet.header.src_nodeID = topology_getMyNodeID();
 	packet.header.type = SNP;
-	packet.header.length = sizeof(seg_t);
 	while (1) {
 		//receive sendseg_arg_t from SRT transport
-		if (getsegToSend(transport_conn, &dest_nodeID, &segment) < 0) {
+		if (getsegToSend(transport_conn, &dest_nodeID, &path, &segment) < 0) {
 			printf("Error getting segment from SRT. Closing transport_conn and listening for additional SRT connections.\n");
 			close(transport_conn);
 			transport_conn = -1;
@@ -328,16 +403,16 @@ void waitTransport() {
 				printf("Error accepting another connection from SRT.\n");
 		}
 
-		//encapsulate in packet
+		//encapsulate in packet, only the used part of the segment is copied
 		packet.header.dest_nodeID = dest_nodeID;
-		memset(packet.data, 0, MAX_PKT_LEN);
-		memcpy(packet.data, &segment, sizeof(segment));
+		packet.header.length = sizeof(srt_hdr_t) + segment.header.length;
+		memcpy(packet.data, &segment, packet.header.length);
 
-		//get next node from routing table
-		nextNode = routingtable_getnextnode(routingtable, dest_nodeID);
+		//get next node of the segment's path, from routing table for path 0
+		nextNode = getPathNextNode(packet.header.src_nodeID, dest_nodeID, path);
 		if(nextNode < 0)
 			printf("Error getting next node for dest_nodeID %d.\n", dest_nodeID);
-		printf("Sending packet with dest_nodeID %d to node ID %d.\n", dest_nodeID, nextNode);
+		printf("Sending packet with dest_nodeID %d on path %d to node ID %d.\n", dest_nodeID, path, nextNode);
 
 		//ask overlay to send packet
 		if (overlay_sendpkt(nextNode, &packet, overlay_conn) < 0) {
@@ -361,6 +436,10 @@ int main(int argc, char *argv[]) {
 	pthread_mutex_init(routingtable_mutex,NULL);
 	overlay_conn = -1;
 	transport_conn = -1;
+	routesVersion = 0;
+	for (int i = 0; i < MAX_NODE_NUM; i++) {
+		pathtable[i].destNodeID = -1;
+	}
 
 	nbrcosttable_print(nct);
 	dvtable_print(dv);
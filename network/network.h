@@ -25,6 +25,13 @@ void* routeupdate_daemon(void* arg);
 //If this packet is an Route Update packet, update the distance vector table and the routing table. 
 void* pkthandler(void* arg); 
 
+//This function returns the next hop of path number path to destNodeID, for a segment the SRT process
+//sent with a path hint. Path 0 is the routing table's route, paths 1 and up start at the loop-free
+//alternate neighbors, the best one first, and wrap around to the routing table's route when there
+//are fewer alternates than paths. From the next hop on, the segment follows the routing tables.
+//Returns -1 if the destination is unreachable.
+int getPathNextNode(int myNodeID, int destNodeID, int path);
+
 //This function stops the SNP process. 
 //Tt closes all the connections and frees all the dynamically allocated memory.
 //Tt is called when the SNP process receives a signal SIGINT.
@@ -1,6 +1,6 @@
 //FILE: server/app_simple_server.c
 
-//Description: this is the simple server application code. The server first connects to the local SNP process. Then it initializes the SRT server by calling srt_svr_init(). It creates 2 sockets and waits for connection from the client by calling srt_svr_sock() and srt_svr_connect() twice. The server then receives short strings sent from the client from both connections. Finally the server closes the socket by calling srt_server_close(). The server disconnects from the local SNP process.
+//Description: this is the simple server application code. The server first connects to the local SNP process. Then it initializes the SRT server by calling srt_svr_init(). It creates a listening socket by calling srt_server_sock() and srt_server_listen(), and accepts the 2 connections of the client on it by calling srt_server_accept() twice. The server then receives short strings sent from the client from both connections. Finally the server closes the sockets by calling srt_server_close(). The server disconnects from the local SNP process.
 
 //Date: May 6,2008
 
@@ -21,13 +21,10 @@
 #include "../common/constants.h"
 #include "srt_server.h"
 
-//Two connection are created. One uses client port CLIENTPORT1 and server port SVRPORT1. The other uses client port CLIENTPORT2 and server port SVRPORT2.
+//Two connection are created to server port SVRPORT1. One uses client port CLIENTPORT1, the other uses client port CLIENTPORT2.
 #define CLIENTPORT1 87
 #define SVRPORT1 88
 #define CLIENTPORT2 89
-#define SVRPORT2 90
-//After the strings are received, the server waits WAITTIME seconds, and then closes the connections
-#define WAITTIME 15
 
 //This function connects to the local SNP process on port NETWORK_PORT. If the TCP connection fails, return -1. The TCP socket desciptor returned will be used by SRT to send segments.
 int connectToNetwork() {
@@ -66,23 +63,19 @@ int main() {
 	//initialize srt server
 	srt_server_init(network_conn);
 
-	//create a srt server sock at port SVRPORT1 
-	int sockfd= srt_server_sock(SVRPORT1);
-	if(sockfd<0) {
+	//create a srt server sock at port SVRPORT1 and listen on it
+	int listenfd= srt_server_sock(SVRPORT1);
+	if(listenfd<0 || srt_server_listen(listenfd,0)<0) {
 		printf("can't create srt server\n");
 		exit(1);
 	}
-	//listen and accept connection from a srt client 
-	srt_server_accept(sockfd);
-
-	//create a srt server sock at port SVRPORT2
-	int sockfd2= srt_server_sock(SVRPORT2);
-	if(sockfd2<0) {
-		printf("can't create srt server\n");
+	//accept both connections from the srt client, in the order the client made them
+	int sockfd= srt_server_accept(listenfd);
+	int sockfd2= srt_server_accept(listenfd);
+	if(sockfd<0 || sockfd2<0) {
+		printf("can't accept srt connections\n");
 		exit(1);
 	}
-	//listen and accept connection from a srt client 
-	srt_server_accept(sockfd2);
 
 
 	char buf1[6];
@@ -99,9 +92,7 @@ int main() {
 		printf("recv string: %s from connection 2\n",buf2);
 	}
 
-	sleep(WAITTIME);
-
-	//close srt server 
+	//close srt server, srt_server_close lingers until the client disconnected
 	if(srt_server_close(sockfd)<0) {
 		printf("can't destroy srt server\n");
 		exit(1);
@@ -110,6 +101,10 @@ int main() {
 		printf("can't destroy srt server\n");
 		exit(1);
 	}				
+	if(srt_server_close(listenfd)<0) {
+		printf("can't destroy srt server\n");
+		exit(1);
+	}				
 
 	//disconnect from the local SNP process
 	disconnectToNetwork(network_conn);
@@ -1,6 +1,6 @@
 //FILE: server/app_stress_server.c
 
-//Description: this is the stress server application code. The server first connects to the local SNP process.  Then it initializes the SRT server by calling srt_svr_init(). It creates a sockets and waits for connection from the client by calling srt_svr_sock() and srt_svr_connect(). It then receives the length of the file to be received. After that, it creates a buffer, receives the file data and saves the file data to receivedtext.txt file. Finally the server closes the socket by calling srt_server_close(). The server disconnects from the local SNP process.
+//Description: this is the stress server application code. The server first connects to the local SNP process.  Then it initializes the SRT server by calling srt_svr_init(). It creates a socket and waits for the connection from the client by calling srt_server_sock() and srt_server_accept(), which listens on the socket and returns a new socket for the connection. It then receives the length of the file to be received. After that, it appends the file data to receivedtext.txt file as it arrives, straight from the receive buffer, by calling srt_server_recv_to_fd(). Finally the server closes the sockets by calling srt_server_close(). The server disconnects from the local SNP process.
 
 //Date: May 6,2008
 
@@ -18,6 +18,7 @@
 #include <unistd.h>
 #include <stdio.h>
 #include <time.h>
+#include <fcntl.h>
 
 #include "../common/constants.h"
 #include "srt_server.h"
@@ -25,8 +26,6 @@
 //One SRT connection is created using client port CLIENTPORT1 and server port SVRPORT1. 
 #define CLIENTPORT1 87
 #define SVRPORT1 88
-//After the received file data is saved, the server waits WAITTIME seconds, and then closes the connection.
-#define WAITTIME 15
 
 //This function connects to the local SNP process on port NETWORK_PORT. If the TCP connection fails, return -1. The TCP socket desciptor returned will be used by SRT to send segments.
 int connectToNetwork() {
@@ -71,27 +70,29 @@ int main() {
 		exit(1);
 	}
 	//listen and accept connection from a srt client 
-	srt_server_accept(sockfd);
+	int listenfd = sockfd;
+	sockfd = srt_server_accept(listenfd);
+	if(sockfd<0) {
+		printf("can't accept srt connection\n");
+		exit(1);
+	}
 
 	//receive the file size first 
-	//and then receive the file data
+	//and then receive the file data, appending it to receivedtext.txt as it arrives
 	int fileLen;
 	srt_server_recv(sockfd,&fileLen,sizeof(int));
-	char* buf = (char*) malloc(fileLen);
-	srt_server_recv(sockfd,buf,fileLen);
-
-	//save the received file data in receivedtext.txt
-	FILE* f;
-	f = fopen("receivedtext.txt","a");
-	fwrite(buf,fileLen,1,f);
-	fclose(f);
-	free(buf);
-
-	//wait for a while
-	sleep(WAITTIME);
+	int fd = open("receivedtext.txt",O_WRONLY|O_CREAT,0644);
+	if(fd<0) {
+		printf("can't open receivedtext.txt\n");
+		exit(1);
+	}
+	if(srt_server_recv_to_fd(sockfd,fd,lseek(fd,0,SEEK_END),fileLen)<fileLen) {
+		printf("receivedtext.txt is incomplete\n");
+	}
+	close(fd);
 
-	//close srt server 
-	if(srt_server_close(sockfd)<0) {
+	//close srt server, srt_server_close lingers until the client disconnected
+	if(srt_server_close(sockfd)<0 || srt_server_close(listenfd)<0) {
 		printf("can't destroy srt server\n");
 		exit(1);
 	}				
@@ -15,38 +15,18 @@
 #include <sys/time.h>
 #include <pthread.h>
 #include <string.h>
+#include <errno.h>
+#include <limits.h>
 #include <unistd.h>
 #include "srt_server.h"
 #include "../topology/topology.h"
 
-#ifdef __MACH__
-#include <mach/clock.h>
-#include <mach/mach.h>
-#endif
-
-
-unsigned long current_utc_time_ns(struct timespec *ts) {
-#ifdef __MACH__ // OS X does not have clock_gettime, use clock_get_time
-  clock_serv_t cclock;
-  mach_timespec_t mts;
-  host_get_clock_service(mach_host_self(), CALENDAR_CLOCK, &cclock);
-  clock_get_time(cclock, &mts);
-  mach_port_deallocate(mach_task_self(), cclock);
-  ts->tv_sec = mts.tv_sec;
-  ts->tv_nsec = mts.tv_nsec;
-  return ts->tv_nsec + ts->tv_sec*NANOSECONDS_PER_SECOND;
-#else
-  clock_gettime(CLOCK_REALTIME, ts);
-  return ts->tv_nsec;
-#endif
-}
-
-
-
 
 // global variables
 int overlay_conn_fd; // for the overlay TCP socket descriptor ‘‘conn’’ used as input parameter for snp_sendseg and snp_recvseg
-svr_tcb_t *server_TCB_Table[MAX_TRANSPORT_CONNECTIONS];
+txsched_t *txSched; // transmit scheduler sending the segments of all sockets on the overlay connection
+siphash_key_t fastOpenKey; // secret key the fast open cookies are derived from, chosen in srt_server_init
+conntable_t serverConnTable; // socket descriptors of the server TCBs and their index by connection
 
 
 //
@@ -66,246 +46,780 @@ svr_tcb_t *server_TCB_Table[MAX_TRANSPORT_CONNECTIONS];
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
 
-// This function initializes the TCB table marking all entries NULL. It also initializes 
+// This function initializes the connection table of the TCBs. It also initializes 
 // a global variable for the overlay TCP socket descriptor ``conn'' used as input parameter
-// for snp_sendseg and snp_recvseg. Finally, the function starts the seghandler thread to 
-// handle the incoming segments. There is only one seghandler for the server side which
-// handles call connections for the client.
+// for snp_sendseg and snp_recvseg, and starts the transmit scheduler that sends the
+// segments of all sockets on it. Finally, the function starts the dispatcher 
+// thread and its pool of worker threads, which run seghandler for the incoming segments
+// of all connections, each connection on one worker.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
 void srt_server_init(int conn)
 {
 	// instantiation of TCB table
-	//server_TCB_Table = malloc(sizeof(svr_tcb_t *) * MAX_TRANSPORT_CONNECTIONS);
-	//MALLOC_CHECK(server_TCB_Table);
-	//memset(server_TCB_Table, 0, sizeof(svr_tcb_t *) * MAX_TRANSPORT_CONNECTIONS);
+	conntable_init(&serverConnTable);
+	siphash_keygen(&fastOpenKey);
 
 	//Initialize global overaly TCP socket descriptor for sendseg and recvseg
 	overlay_conn_fd = conn;
 
-	// instantiation of seghandler thread
-	//there's only one seghandler for the server side. Start seghandler thread to handle incoming segments
-	pthread_t segHandlerThread;
-    if (pthread_create(&segHandlerThread, NULL, seghandler, NULL)){
-    	printf("Error creating seghandler thread.\n");
-    }
+	//start the transmit scheduler, all sockets send through it
+	txSched = txsched_start(conn);
+	if (txSched == NULL) {
+		printf("Error starting the transmit scheduler.\n");
+	}
+
+	//start the dispatcher, its worker threads run seghandler for the incoming segments
+	if (dispatch_start(conn, seghandler) == NULL) {
+		printf("Error starting the seghandler threads.\n");
+	}
 
 	printf("Initialized server.\n");
 }
 
 
-// This function looks up the client TCB table to find the first NULL entry, and creates
-// a new TCB entry using malloc() for that entry. All fields in the TCB are initialized 
+// This function creates a new TCB entry using malloc() and stores it in the server connection
+// table, which hands out a free socket descriptor for it. All fields in the TCB are initialized 
 // e.g., TCB state is set to CLOSED and the server port set to the function call parameter 
-// server port.  The TCB table entry index should be returned as the new socket ID to the server 
-// and be used to identify the connection on the server side. If no entry in the TCB table  
-// is available the function returns -1.
+// server port.  The socket descriptor should be returned as the new socket ID to the server 
+// and be used to identify the connection on the server side. If MAX_TRANSPORT_CONNECTIONS  
+// sockets are in use the function returns -1.
 
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
 int srt_server_sock(unsigned int port)
 {
-  //malloc new TCB entry at first NULL entry
-	int sockfd = 0;
-	while (sockfd < MAX_TRANSPORT_CONNECTIONS){
-		if (server_TCB_Table[sockfd] == NULL) {
-
-			//malloc new client tcb entry
-			server_TCB_Table[sockfd] = malloc(sizeof(svr_tcb_t));
-			MALLOC_CHECK(server_TCB_Table[sockfd]);
-			memset(server_TCB_Table[sockfd], 0, sizeof(svr_tcb_t));
-
-			//initialize TCB entry, malloc recv buffer and mutex
-			server_TCB_Table[sockfd]->svr_portNum = port;
-			server_TCB_Table[sockfd]->state = CLOSED;
-			server_TCB_Table[sockfd]->usedBufLen = 0;
-			server_TCB_Table[sockfd]->expect_seqNum = 0;
-			server_TCB_Table[sockfd]->recvBuf = malloc(RECEIVE_BUF_SIZE);
-			memset(server_TCB_Table[sockfd]->recvBuf, 0, RECEIVE_BUF_SIZE);
-			server_TCB_Table[sockfd]->bufMutex = malloc(sizeof(pthread_mutex_t));
-			memset(server_TCB_Table[sockfd]->bufMutex, 0, sizeof(pthread_mutex_t));
-			server_TCB_Table[sockfd]->svr_nodeID = topology_getMyNodeID();
-			printf("My nodeID is %u.\n", server_TCB_Table[sockfd]->svr_nodeID);
-
-			//initialize mutex
-			if (pthread_mutex_init(server_TCB_Table[sockfd]->bufMutex, NULL) != 0) {
-			    printf("\n mutex init failed\n");
-			    return -1;
-			}
+	return srt_server_socktype(port, SRT_STREAM);
+}
 
-			break;
-		} else {
-			sockfd++;
-		}
-	}
 
-	if (sockfd == MAX_TRANSPORT_CONNECTIONS) {
-		printf("You've reached the maximum number of transport connections.\n");
+// Creates a socket like srt_server_sock, of the given type: SRT_STREAM, the type of
+// srt_server_sock, carries a byte stream, SRT_SEQPACKET carries messages. On a SRT_SEQPACKET
+// socket each srt_server_send is one message, however many segments it takes, and
+// srt_server_recvmsg returns one whole message per call. A SRT_SEQPACKET socket only accepts
+// clients whose socket is SRT_SEQPACKET, and the other way round. Forward error correction
+// isn't used on SRT_SEQPACKET connections.
+// A SRT_DGRAM socket doesn't listen or connect: it takes the datagrams of any client sent to
+// its port right away, with srt_server_recvfrom or srt_server_recvmsg, and sends datagrams with
+// srt_server_sendto. Datagrams aren't Acked or retransmitted, see srt_server_sendto.
+// Returns the socket descriptor, or -1 if the type is unknown or MAX_TRANSPORT_CONNECTIONS
+// sockets are in use.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_socktype(unsigned int port, int type)
+{
+	if (type != SRT_STREAM && type != SRT_SEQPACKET && type != SRT_DGRAM) {
+		printf("Unknown socket type %d.\n", type);
 		return -1;
-	} else {
-		printf("Created new TCB server entry with sockfd %d.\n", sockfd);
-		return sockfd;
 	}
+	svr_tcb_t *newTCB = createTCB(port);
+	if (newTCB == NULL) {
+		return -1;
+	}
+	stream_setseqpacket(&newTCB->stream, type == SRT_SEQPACKET);
+	if (type == SRT_DGRAM) {
+		//datagrams from any client to our port are routed to this TCB, it stays CLOSED
+		newTCB->dgram = dgram_create(newTCB->bufMutex, txSched, &newTCB->txFlow, port);
+		conntable_bind(&serverConnTable, newTCB->sockfd, port, CONN_ANY_NODE, CONN_ANY_PORT);
+	}
+	printf("Created new TCB server entry with sockfd %d.\n", newTCB->sockfd);
+	return newTCB->sockfd;
 }
 
 
-// This function gets the TCB pointer using the sockfd and changes the state of the connection to 
-// LISTENING. It then starts a timer to ``busy wait'' until the TCB's state changes to CONNECTED 
-// (seghandler does this when a SYN is received). It waits in an infinite loop for the state 
-// transition before proceeding and to return 1 when the state change happens, dropping out of
-// the busy wait loop. You can implement this blocking wait in different ways, if you wish.
+// This function gets the TCB pointer using the sockfd and changes the state of the socket to
+// LISTENING: SYNs from any client to its port are handled by it from now on. Each SYN creates
+// a new CONNECTED socket for the client, which waits in the accept queue of the listening socket
+// until srt_server_accept takes it. While backlog connections are waiting (LISTEN_BACKLOG if 0),
+// further SYNs are dropped, and the clients retry. Returns 1 on success, -1 if the socket isn't
+// CLOSED or LISTENING.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
-int srt_server_accept(int sockfd)
+int srt_server_listen(int sockfd, unsigned int backlog)
 {
-  //find TCB entry
-	svr_tcb_t *currentTCB = server_TCB_Table[sockfd];
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
 	if (currentTCB == NULL){
 		printf("Couldn't find the specified server TCB entry.\n");
 		return -1;
 	}
+	if (currentTCB->dgram != NULL) {
+		printf("Socket is SRT_DGRAM. Can't listen.\n");
+		return -1;
+	}
 
+	pthread_mutex_lock(currentTCB->bufMutex);
 	switch(currentTCB->state) {
 		case CLOSED:
 		  printf("State is CLOSED. Transitioning to LISTENING.\n");
+		  //SYNs from any client to our port are routed to this TCB
+		  conntable_bind(&serverConnTable, sockfd, currentTCB->svr_portNum, CONN_ANY_NODE, CONN_ANY_PORT);
+		  currentTCB->state = LISTENING;
 		  break;
 
 		case LISTENING:
-		  printf("State is LISTENING. Can't accept.\n");
-		  return -1;
+		  printf("State is LISTENING. Changing the backlog.\n");
+		  break;
 
 		case CONNECTED:
-		  printf("State is CONNECTED. Can't accept.\n");
+		  printf("State is CONNECTED. Can't listen.\n");
+		  pthread_mutex_unlock(currentTCB->bufMutex);
 		  return -1;
 
 		case CLOSEWAIT:
-		  printf("State is CLOSEWAIT. Can't accept.\n");
+		  printf("State is CLOSEWAIT. Can't listen.\n");
+		  pthread_mutex_unlock(currentTCB->bufMutex);
 		  return -1;
 
 		default:
-		  printf("Unknown state. Can't accept.\n");
+		  printf("Unknown state. Can't listen.\n");
+		  pthread_mutex_unlock(currentTCB->bufMutex);
 		  return -1;
-	}	
+	}
+	currentTCB->backlog = (backlog > 0) ? backlog : LISTEN_BACKLOG;
+	pthread_mutex_unlock(currentTCB->bufMutex);
+	return 1;
+}
 
-	currentTCB->state = LISTENING;
 
-	while (currentTCB->state == LISTENING) {
-		struct timespec req;
-		req.tv_sec = 0;
-		req.tv_nsec = ACCEPT_POLLING_INTERVAL;
-		struct timespec rm;
-		nanosleep(&req,&rm);
+// This function gets the TCB pointer of a listening socket using the sockfd and waits until
+// a client connected to it, i.e. until seghandler queued a connection for the SYN of a client.
+// It takes the first connection off the accept queue and returns its socket descriptor, which
+// is CONNECTED and used to receive from and send to that client. A socket that isn't listening
+// yet starts listening with LISTEN_BACKLOG first. Returns -1 if the socket can't listen or
+// is closed while waiting.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_accept(int sockfd)
+{
+  //find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry.\n");
+		return -1;
 	}
 
-	//if SYN is received, seghandler will change state to CONNECTED
-	if (currentTCB->state == CONNECTED) {
-		printf("We're CONNECTED!\n");
-		return 1;
+	//accept on a fresh socket listens first
+	if (currentTCB->state == CLOSED && srt_server_listen(sockfd, 0) < 0) {
+		return -1;
+	}
+	if (currentTCB->state != LISTENING) {
+		printf("Socket isn't LISTENING. Can't accept.\n");
+		return -1;
+	}
 
-	} else {
-		printf("Couldn't connect. Switching to CLOSED.\n");
-		currentTCB->state = CLOSED;
+	//seghandler queues a connection for each SYN and signals acceptCond
+	pthread_mutex_lock(currentTCB->bufMutex);
+	while (currentTCB->acceptHead == NULL && currentTCB->state == LISTENING) {
+		pthread_cond_wait(&currentTCB->acceptCond, currentTCB->bufMutex);
+	}
+	svr_tcb_t *childTCB = currentTCB->acceptHead;
+	if (childTCB == NULL) {
+		pthread_mutex_unlock(currentTCB->bufMutex);
+		printf("Socket was closed. Can't accept.\n");
 		return -1;
 	}
+	currentTCB->acceptHead = childTCB->acceptNext;
+	if (currentTCB->acceptHead == NULL) {
+		currentTCB->acceptTail = NULL;
+	}
+	currentTCB->acceptLen--;
+	childTCB->acceptNext = NULL;
+	pthread_mutex_unlock(currentTCB->bufMutex);
+
+	printf("We're CONNECTED! Accepted sockfd %d for client port %u.\n", childTCB->sockfd, childTCB->client_portNum);
+	return childTCB->sockfd;
 }
 
 
-// Receive data from a srt client. Recall this is a unidirectional transport
-// where DATA flows from the client to the server. Signaling/control messages
-// such as SYN, SYNACK, etc.flow in both directions. 
-// This function keeps polling the receive buffer every RECVBUF_POLLING_INTERVAL
-// until the requested data is available, then it stores the data and returns 1
-// If the function fails, return -1 
+// Receive data from a srt client. Connections are full duplex: DATA flows from
+// the client to the server and, with srt_server_send, from the server to the client.
+// Signaling/control messages such as SYN, SYNACK, etc.flow in both directions. 
+// This function waits until the requested data is available, woken by seghandler as
+// data arrives, then it stores the data and returns 1.
+// If the function fails, or the receive timeout expires or the client closes the
+// connection first, return -1 
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
 int srt_server_recv(int sockfd, void* buf, unsigned int length)
 {
 	//find TCB entry
-	svr_tcb_t *currentTCB = server_TCB_Table[sockfd];
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
 	if (currentTCB == NULL){
 		printf("Couldn't find the specified server TCB entry in srt_server_recv.\n");
 		return -1;
 	}
 
-	if (length > RECEIVE_BUF_SIZE) {
-		printf("Error: length > RECEIVE_BUF_SIZE.\n");
+	return stream_recv(&currentTCB->stream, buf, length);
+}
+
+
+// Read data from a srt client as it arrives. This function waits until data is in the
+// receive buffer and returns up to length bytes of it right away; with the SRT_WAITALL flag
+// it keeps reading until length bytes arrived. The receive window reopens as data is read,
+// so a transfer of any size streams through the bounded receive buffer.
+// Returns the number of bytes read, 0 once the client closed the connection and all its
+// data was read, or -1 if the socket doesn't exist or the receive timeout expired first.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_read(int sockfd, void* buf, unsigned int length, int flags)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry in srt_server_read.\n");
+		return -1;
+	}
+
+	return stream_read(&currentTCB->stream, buf, length, flags);
+}
+
+
+// Receive a message from the client of a SRT_SEQPACKET socket. This function waits until a
+// whole message arrived and stores it in buf: one srt_client_send of the client, never part
+// of one or several. A message longer than length is cut to length bytes, the rest of it is
+// dropped. A message too long to wait for in the receive buffer is taken out as it arrives.
+// On a SRT_DGRAM socket it receives a datagram like srt_server_recvfrom.
+// Returns the number of bytes stored, 0 once the client closed the connection and all its
+// messages were read, or -1 if the socket doesn't exist or is SRT_STREAM, or the receive
+// timeout expired first.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_recvmsg(int sockfd, void* buf, unsigned int length)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry in srt_server_recvmsg.\n");
+		return -1;
+	}
+	if (currentTCB->dgram != NULL) {
+		return dgram_recv(currentTCB->dgram, buf, length, NULL, NULL, currentTCB->stream.recvTimeout);
+	}
+	if (!currentTCB->stream.seqpacket) {
+		printf("Socket isn't SRT_SEQPACKET. Can't receive a message.\n");
+		return -1;
+	}
+
+	return stream_recvmsg(&currentTCB->stream, buf, length);
+}
+
+
+// Lend data from a srt client without copying it. This function waits until data is in the
+// receive buffer, like srt_server_read, and points views at up to length bytes of it in place.
+// Data that wraps around the end of the receive buffer comes in two pieces: views[0] is the
+// first part, views[1] the rest, otherwise views[1] is empty. The data is read-only and stays
+// in the receive buffer until srt_server_release frees it; until then no other read may be
+// made on the socket. Returns the number of bytes lent, 0 once the client closed the connection
+// and all its data was read, or -1 if the socket doesn't exist or the receive timeout expired.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_recv_zc(int sockfd, srt_view_t views[2], unsigned int length)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry.\n");
+		return -1;
+	}
+
+	return stream_lend(&currentTCB->stream, views, length);
+}
+
+
+// Free the first length bytes lent by srt_server_recv_zc, once the application is done with
+// them, and reopen the receive window. Views of the data beyond length aren't valid afterwards,
+// srt_server_recv_zc lends it again. Returns 1 on success, -1 if the socket doesn't exist or
+// fewer than length bytes are in the receive buffer.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_release(int sockfd, unsigned int length)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry.\n");
+		return -1;
+	}
+
+	if (stream_release(&currentTCB->stream, length) < 0) {
+		printf("Can't release %u bytes, they weren't received.\n", length);
+		return -1;
+	}
+	return 1;
+}
+
+
+// Receive length bytes of data from a srt client straight into the file fd, starting at
+// offset in the file. The data is written to the file from the receive buffer as it arrives,
+// without passing through an application buffer, and its room in the receive buffer is freed
+// as soon as it is written, so a file of any size streams through the bounded receive buffer.
+// Returns the number of bytes written, which is less than length if the client closed the
+// connection, writing the file failed or the receive timeout expired first, or -1 if the socket
+// doesn't exist or nothing was written. At most INT_MAX bytes are received per call.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_recv_to_fd(int sockfd, int fd, off_t offset, unsigned int length)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry.\n");
+		return -1;
+	}
+
+	//the count is returned as an int
+	length = min(length, INT_MAX);
+	unsigned int written = 0;
+	while (written < length) {
+		//borrow what has arrived, up to the wrap of the receive buffer in two pieces
+		srt_view_t views[2];
+		int lentLen = stream_lend(&currentTCB->stream, views, length - written);
+		if (lentLen == 0) {
+			break;
+		}
+		if (lentLen < 0) {
+			return (written > 0) ? (int)written : -1;
+		}
+
+		//copy it once, from the receive buffer into the file
+		unsigned int lentStart = written;
+		for (int i = 0; i < 2; i++) {
+			const char *data = views[i].data;
+			unsigned int left = views[i].length;
+			while (left > 0) {
+				ssize_t n = pwrite(fd, data, left, offset + written);
+				if (n < 0) {
+					//what is in the file leaves the receive buffer, the rest is read next time
+					perror("Error writing received data to file");
+					stream_release(&currentTCB->stream, written - lentStart);
+					return (written > 0) ? (int)written : -1;
+				}
+				data += n;
+				left -= n;
+				written += n;
+			}
+		}
+		stream_release(&currentTCB->stream, lentLen);
+	}
+	printf("Wrote %u bytes of received data to file.\n", written);
+	return (int)written;
+}
+
+
+// Send data to the srt client of a CONNECTED socket. The data is queued in the send buffer
+// of the TCB's stream in segments of the agreed MSS and sent under the same GBN window,
+// retransmission and pacing as client data; the ACKs of the data received from the client
+// ride along in these segments. srt_server_send is non-blocking. Once the client closed the
+// connection, the data already queued is still delivered before the server Acks the client's
+// FIN, but no more can be queued. Returns 1 if the data is queued, -1 otherwise.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_send(int sockfd, void* data, unsigned int length)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry.\n");
+		return -1;
+	}
+
+	switch(currentTCB->state) {
+		case CLOSED:
+		  printf("State is CLOSED. Can't send.\n");
+		  return -1;
+
+		case LISTENING:
+		  printf("State is LISTENING. Can't send.\n");
+		  return -1;
+
+		case CONNECTED:
+		  if (currentTCB->finPending) {
+		  	printf("Client closed the connection. Can't send.\n");
+		  	return -1;
+		  }
+		  printf("\nAdding segBufs to queue to send to %u.\n", currentTCB->client_portNum);
+		  break;
+
+		case CLOSEWAIT:
+		  printf("State is CLOSEWAIT. Can't send.\n");
+		  return -1;
+
+		default:
+		  printf("Unknown state. Can't send.\n");
+		  return -1;
+	}
+
+	return stream_send(&currentTCB->stream, data, length);
+}
+
+
+// Send length bytes of data, at most MAX_SEG_LEN, as one datagram from a SRT_DGRAM socket to
+// the client port on node nodeID. The datagram goes out through the transmit scheduler like
+// any segment, but nothing is kept once it is sent: there is no handshake, ACK or
+// retransmission, so a datagram may be lost, and datagrams may arrive out of order. In
+// exchange, no datagram waits behind a lost one. Returns 1 once the datagram is queued for
+// sending, -1 if the socket doesn't exist or isn't SRT_DGRAM, or the data doesn't fit.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_sendto(int sockfd, int nodeID, unsigned int port, void* data, unsigned int length)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry.\n");
+		return -1;
+	}
+	if (currentTCB->dgram == NULL) {
+		printf("Socket isn't SRT_DGRAM. Can't send a datagram.\n");
+		return -1;
+	}
+
+	return dgram_send(currentTCB->dgram, nodeID, port, data, length);
+}
+
+
+// Receive a datagram on a SRT_DGRAM socket. This function waits until a datagram of any client
+// arrived at the socket's port, stores it in buf, cut to length bytes, and the node ID and
+// port of the client that sent it in *nodeID and *port, unless they are NULL. Datagrams are
+// read in the order they arrived; while DGRAM_QUEUE_LEN wait to be read, further ones are
+// dropped. Returns the number of bytes stored, 0 if the socket was closed, or -1 if the socket
+// doesn't exist or isn't SRT_DGRAM, or the receive timeout expired first.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_recvfrom(int sockfd, void* buf, unsigned int length, int* nodeID, unsigned int* port)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry in srt_server_recvfrom.\n");
+		return -1;
+	}
+	if (currentTCB->dgram == NULL) {
+		printf("Socket isn't SRT_DGRAM. Can't receive a datagram.\n");
+		return -1;
+	}
+
+	return dgram_recv(currentTCB->dgram, buf, length, nodeID, port, currentTCB->stream.recvTimeout);
+}
+
+
+// Turns the sequence numbers of the datagrams a SRT_DGRAM socket sends on or off. With them
+// on, the receiving socket counts the datagrams of the sender lost and arrived late, see
+// srt_server_dgramstats. They are off by default. Returns 1 on success, -1 if the socket
+// doesn't exist or isn't SRT_DGRAM.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_setdgramseq(int sockfd, int on)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry.\n");
+		return -1;
+	}
+	if (currentTCB->dgram == NULL) {
+		printf("Socket isn't SRT_DGRAM.\n");
+		return -1;
+	}
+
+	dgram_setnumbered(currentTCB->dgram, on);
+	return 1;
+}
+
+
+// Copies the statistics of a SRT_DGRAM socket into stats: the datagrams sent, received and
+// dropped because the application didn't read them in time, and of the numbered datagrams
+// of the senders, those that didn't arrive, those counted lost that arrived late after all
+// and those that arrived again or too late to tell.
+// Returns 1 on success, -1 if the socket doesn't exist or isn't SRT_DGRAM.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_dgramstats(int sockfd, srt_dgramstats_t* stats)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry.\n");
+		return -1;
+	}
+	if (currentTCB->dgram == NULL) {
+		printf("Socket isn't SRT_DGRAM.\n");
+		return -1;
+	}
+
+	dgram_getstats(currentTCB->dgram, stats);
+	return 1;
+}
+
+
+// Sets the delayed-ACK policy of the socket. A cumulative DATAACK is sent after ackEvery
+// in-order DATA segments, or ackDelay_ms milliseconds after the first unAcked one arrived.
+// Out-of-order and duplicate segments, and the segment that fills a gap, are Acked at
+// once. ackEvery 1 acknowledges every segment. Zero values select DELAYED_ACK_SEGMENTS
+// and DELAYED_ACK_TIMEOUT. A DATA segment sent to the client in the meantime carries
+// the ACK, and no DATAACK is sent. Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_setdelack(int sockfd, unsigned int ackEvery, unsigned int ackDelay_ms)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry.\n");
 		return -1;
 	}
 
-	//wait until all of the data has been transmitted
-	while (currentTCB->usedBufLen < length) {
-		struct timespec req;
-		req.tv_sec = 0;
-		req.tv_nsec = RECVBUF_POLLING_INTERVAL_NS;
-		struct timespec rm;
-		nanosleep(&req,&rm);
+	stream_setdelack(&currentTCB->stream, ackEvery, ackDelay_ms);
+	return 1;
+}
+
+
+// Sets the transmit scheduling of the socket. The sockets of a process share the overlay
+// connection: sockets of a lower priority number are served first, and sockets of the same
+// priority share it in proportion to their weight. priority is at most TXSCHED_PRIORITIES - 1,
+// weight 0 is taken as 1. New sockets have weight 1 and TXSCHED_DEFAULT_PRIORITY.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_setsched(int sockfd, unsigned int weight, unsigned int priority)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry.\n");
+		return -1;
+	}
+
+	txsched_setflow(txSched, &currentTCB->txFlow, weight, priority);
+	return 1;
+}
+
+
+// Turns fast open on or off for the socket. With fast open on, data a client sends in its
+// SYN together with a valid cookie is delivered into the receive buffer while the
+// connection is accepted, and the SYNACK acknowledges it. With fast open off, the data is
+// dropped and the client sends it again once connected. Cookies are handed out either way.
+// Fast open is on by default. Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_setfastopen(int sockfd, int on)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry.\n");
+		return -1;
 	}
 
-	//return the data
 	pthread_mutex_lock(currentTCB->bufMutex);
+	currentTCB->fastOpen = on;
+	pthread_mutex_unlock(currentTCB->bufMutex);
+	return 1;
+}
 
-	//first copy data from 0 to length
-	currentTCB->recvBuf -= currentTCB->usedBufLen;
-	memcpy(buf, currentTCB->recvBuf, length);
-	printf("usedBufLen(%u) >= length (%u). Returning data (%s).\n", currentTCB->usedBufLen, length, buf);
-	//printf("Recv Buffer: %s, Buf: %s\n", currentTCB->recvBuf, buf);
 
-	//move data between length and usedBufLen to 0
-	char *tempPtr = currentTCB->recvBuf + length;
-	currentTCB->usedBufLen = currentTCB->usedBufLen - length;
-	memmove(currentTCB->recvBuf, tempPtr, currentTCB->usedBufLen);
+// Turns forward error correction on or off for the socket. With it on, a client that asks for
+// it in its SYN is told so in the SYNACK, and both ends send a DATAFEC parity segment of their
+// data every few segments, more often the more segments are retransmitted. When one segment of
+// the data a parity segment covers is lost, the receiver rebuilds it without waiting for the
+// retransmission. Connections accepted on a listening socket take its setting. It is off by default.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_setfec(int sockfd, int on)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry.\n");
+		return -1;
+	}
+
+	stream_setfec(&currentTCB->stream, on);
+	return 1;
+}
+
+
+// Sets the number of overlay paths, at most MULTIPATH_MAX_PATHS, the segments the socket sends are
+// striped over. Each segment carries a path hint to SNP: path 0 is the routing table's route, the
+// others start at the neighbors whose own route to the destination doesn't lead back through this
+// node. New segments are spread over the paths in inverse proportion to the RTT measured on each,
+// raised by the share of segments lost on it, and a retransmission goes out on another path than
+// the one it was lost on. The receiver puts the segments back in order. 1, the default, sends all
+// segments on the routing table's route. Connections accepted on a listening socket take its setting.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_setmultipath(int sockfd, unsigned int paths)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry.\n");
+		return -1;
+	}
+
+	stream_setmultipath(&currentTCB->stream, paths);
+	return 1;
+}
+
+
+// Sets how long srt_server_recv and srt_server_read wait for data from the client:
+// timeout_ms milliseconds, or forever if 0, which is the default.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_setrecvtimeout(int sockfd, unsigned int timeout_ms)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry.\n");
+		return -1;
+	}
+
+	stream_setrecvtimeout(&currentTCB->stream, timeout_ms);
+	return 1;
+}
 
-	//memset
-	tempPtr = currentTCB->recvBuf + currentTCB->usedBufLen;
-	memset(tempPtr, 0, RECEIVE_BUF_SIZE - currentTCB->usedBufLen);
-	//printf("usedBufLen is now %u, Recv Buffer: %s.\n", currentTCB->usedBufLen, currentTCB->recvBuf);
-	currentTCB->recvBuf += currentTCB->usedBufLen;
 
+// Sets how long a connection may go without a segment from the client: once the client sent
+// nothing for timeout_ms milliseconds, the connection is CLOSED, a FIN tells the client and
+// reads waiting for data return. Its segments no longer reach the socket. 0, the default, keeps idle connections open. Connections
+// accepted on a listening socket take its idle timeout.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_setidletimeout(int sockfd, unsigned int timeout_ms)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry.\n");
+		return -1;
+	}
+
+	pthread_mutex_lock(currentTCB->bufMutex);
+	currentTCB->idleTimeout = (unsigned long)timeout_ms * 1000000;
+	if (currentTCB->state == CONNECTED) {
+		if (currentTCB->idleTimeout > 0) {
+			timer_arm(&currentTCB->idleTimer, 0);
+		} else {
+			timer_cancel(&currentTCB->idleTimer);
+		}
+	}
 	pthread_mutex_unlock(currentTCB->bufMutex);
-	//printf("Returning from srt_server_recv with length %u\n", length);
+	return 1;
+}
+
+
+// Sets the linger option of the socket. With linger on, srt_server_close of a connected
+// socket first waits until all data sent to the client is Acked and the client has closed
+// the connection, at most linger_ms milliseconds (LINGER_TIMEOUT if 0). With linger off,
+// srt_server_close fails until the connection is CLOSED. Linger is on by default.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_setlinger(int sockfd, int on, unsigned int linger_ms)
+{
+	//find TCB entry
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
+	if (currentTCB == NULL){
+		printf("Couldn't find the specified server TCB entry.\n");
+		return -1;
+	}
+
+	stream_setlinger(&currentTCB->stream, on, linger_ms);
 	return 1;
 }
 
 
 // This function calls free() to free the TCB entry. It marks that entry in TCB as NULL
 // and returns 1 if succeeded (i.e., was in the right state to complete a close) and -1 
-// if fails (i.e., in the wrong state).
+// if fails (i.e., in the wrong state). A connected socket that lingers first waits for
+// its data to be Acked and for the client to close the connection. Closing a listening
+// socket also closes the connections in its accept queue and sends a FIN to their clients.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
 int srt_server_close(int sockfd)
 {
   	//find TCB entry
-	svr_tcb_t *currentTCB = server_TCB_Table[sockfd];
+	svr_tcb_t *currentTCB = conntable_get(&serverConnTable, sockfd);
 	if (currentTCB == NULL){
 		printf("Couldn't find the specified server TCB entry.\n");
 		return -1;
 	}
 
+	//linger until our data is Acked and the client's FIN took the connection to CLOSED
+	unsigned long linger = currentTCB->stream.linger;
+	if (linger > 0 && (currentTCB->state == CONNECTED || currentTCB->state == CLOSEWAIT)) {
+		printf("Lingering until the client closes the connection.\n");
+		unsigned long deadline = timer_now_ns() + linger;
+		if (currentTCB->state == CONNECTED && stream_drain(&currentTCB->stream, linger) < 0) {
+			printf("Linger timed out before the client Acked all data.\n");
+		}
+		//closeWaitTimeout signals closedCond when CLOSEWAIT ends
+		pthread_mutex_lock(currentTCB->bufMutex);
+		while (currentTCB->state != CLOSED) {
+			if (timer_condwait(&currentTCB->closedCond, currentTCB->bufMutex, deadline) == ETIMEDOUT) {
+				break;
+			}
+		}
+		pthread_mutex_unlock(currentTCB->bufMutex);
+	}
+
 	switch(currentTCB->state) {
 		case CLOSED:
 		  printf("State is CLOSED. Freeing TCB entry and closing.\n");
-		  printf("Destroying mutex.\n");
-		  pthread_mutex_lock(currentTCB->bufMutex);
-		  currentTCB->recvBuf -= currentTCB->usedBufLen;
-		  currentTCB->usedBufLen = 0;
-		  pthread_mutex_unlock(currentTCB->bufMutex);
-		  pthread_mutex_destroy(server_TCB_Table[sockfd]->bufMutex);
-		  free(server_TCB_Table[sockfd]->bufMutex);
-		  printf("Freeing recv buffer.\n");
-		  free(server_TCB_Table[sockfd]->recvBuf);
-		  printf("Freeing server_TCB_Table[sockfd].\n");
-		  free(server_TCB_Table[sockfd]);
-		  server_TCB_Table[sockfd] = NULL;
+		  freeTCB(currentTCB);
 		  return 1;
 
 		case LISTENING:
-		  printf("State is LISTENING. Can't close.\n");
-		  return -1;
+		  printf("State is LISTENING. Closing the connections that weren't accepted.\n");
+		  conntable_unbind(&serverConnTable, sockfd);
+		  pthread_mutex_lock(currentTCB->bufMutex);
+		  currentTCB->state = CLOSED;
+		  svr_tcb_t *childTCB = currentTCB->acceptHead;
+		  currentTCB->acceptHead = NULL;
+		  currentTCB->acceptTail = NULL;
+		  currentTCB->acceptLen = 0;
+		  pthread_cond_broadcast(&currentTCB->acceptCond);
+		  pthread_mutex_unlock(currentTCB->bufMutex);
+		  while (childTCB != NULL) {
+		  	svr_tcb_t *nextTCB = childTCB->acceptNext;
+		  	//their clients are told, freeTCB sends the FIN before the flow is closed
+		  	closeByServer(childTCB);
+		  	freeTCB(childTCB);
+		  	childTCB = nextTCB;
+		  }
+		  freeTCB(currentTCB);
+		  return 1;
 
 		case CONNECTED:
 		  printf("State is CONNECTED. Can't close.\n");
@@ -322,229 +836,437 @@ int srt_server_close(int sockfd)
 }
 
 
-// This is a thread  started by srt_server_init(). It handles all the incoming 
-// segments from the client. The design of seghanlder is an infinite loop that calls snp_recvseg(). If
-// snp_recvseg() fails then the overlay connection is closed and the thread is terminated. Depending
+// This function handles an incoming segment from the client. It is called by the worker threads
+// of the dispatcher started by srt_server_init(), which receives the segments with snp_recvseg() and
+// hands all segments of a connection to the same worker, in order. If snp_recvseg() fails
+// then the overlay connection is closed and the threads are terminated. Depending
 // on the state of the connection when a segment is received  (based on the incoming segment) various
 // actions are taken. See the client FSM for more details.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
-void* seghandler(void* arg)
+void seghandler(seg_t* segPtr, int src_nodeID)
 {
-  	seg_t *segPtr = malloc(sizeof(seg_t));
-	MALLOC_CHECK(segPtr);
-	memset(segPtr, 0, sizeof(seg_t));
-
-	char *segTypeStrings[] = {"SYN", "SYNACK", "FIN", "FINACK", "DATA", "DATAACK"};
+	char *segTypeStrings[] = {"SYN", "SYNACK", "FIN", "FINACK", "DATA", "DATAACK", "DATAFEC", "DGRAM"};
 	char *states[] = {"Unknown", "CLOSED", "LISTENING", "CONNECTED", "CLOSEWAIT"};
-	int src_nodeID;
 
-	while (snp_recvseg(overlay_conn_fd, &src_nodeID, segPtr) > 0) {
+	//get the svr_tcb_t of the connection, or of the listening socket on the port. The reference
+	//taken on it keeps srt_server_close from freeing it until the segment is handled
+	int sockfd;
+	svr_tcb_t *currentTCB = conntable_lookup(&serverConnTable, segPtr->header.dest_port, src_nodeID, segPtr->header.src_port, &sockfd);
+
+	if (currentTCB != NULL){
+		atomic_store(&currentTCB->lastRecvTime, timer_now_ns());
+		printf("\nReceived %s in state %s. client: %u, server: %u.\n", 
+			segTypeStrings[segPtr->header.type], states[currentTCB->state], segPtr->header.src_port, segPtr->header.dest_port);
+
+		switch(currentTCB->state) {
+			case CLOSED:
+			  //printf("State is CLOSED.\n");
+			  if (segPtr->header.type == DGRAM && currentTCB->dgram != NULL) {
+			  	//a datagram of any client to a SRT_DGRAM socket
+			  	dgram_input(currentTCB->dgram, segPtr, src_nodeID);
+			  } else {
+			  	printf("Doing nothing.\n");
+			  }
+			  break;
+
+			case LISTENING:
+			  //printf("State is LISTENING.\n");
+			  if (segPtr->header.type == SYN){
+			  	listenSyn(currentTCB, segPtr, src_nodeID);
+			  } else {
+			  	printf("Doing nothing.\n");
+			  }
+			  break;
+			case CONNECTED:
+			  //printf("State is CONNECTED.\n");
+			  if (segPtr->header.type == SYN  && currentTCB->client_portNum == segPtr->header.src_port && currentTCB->client_nodeID == src_nodeID){
+			  	printf("Sending SYNACK.\n");
+
+				//send SYNACK seg_t
+				if (sendSynAck(currentTCB) < 0) {
+					printf("Error sending SYNACK seg_t.\n");
+				}
+			  } else if (segPtr->header.type == FIN  && currentTCB->client_portNum == segPtr->header.src_port && currentTCB->client_nodeID == src_nodeID) {
+			  	//the client is done sending, our data still in flight is delivered before the FINACK
+			  	stream_stoprecv(&currentTCB->stream);
+			  	pthread_mutex_lock(currentTCB->bufMutex);
+			  	int pending = stream_sendpending(&currentTCB->stream);
+			  	if (pending && !currentTCB->finPending) {
+			  		printf("Client is done sending. Sending FINACK once our data is Acked.\n");
+			  		currentTCB->finPending = 1;
+			  	}
+			  	pthread_mutex_unlock(currentTCB->bufMutex);
+			  	if (!pending) {
+			  		closeWaitStart(currentTCB);
+			  	}
+
+			  } else if ((segPtr->header.type == DATA || segPtr->header.type == DATAACK || segPtr->header.type == DATAFEC) && currentTCB->client_portNum == segPtr->header.src_port && currentTCB->client_nodeID == src_nodeID) {
+			  	//the client's data and its ACKs of ours
+			  	stream_input(&currentTCB->stream, segPtr);
+			  	//the FINACK waited for the client to Ack our data
+			  	pthread_mutex_lock(currentTCB->bufMutex);
+			  	int drained = currentTCB->finPending && !stream_sendpending(&currentTCB->stream);
+			  	pthread_mutex_unlock(currentTCB->bufMutex);
+			  	if (drained) {
+			  		closeWaitStart(currentTCB);
+			  	}
+			  } else {
+			  	printf("Doing nothing.\n");
+			  }
+			  break;
+
+			case CLOSEWAIT:
+			  //printf("State is CLOSEWAIT.\n");
+			  if (segPtr->header.type == FIN  && currentTCB->client_portNum == segPtr->header.src_port && currentTCB->client_nodeID == src_nodeID){
+
+			  	printf("Sending FINACK.\n");
+				if (sendFinAck(currentTCB) < 0) {
+					printf("Error sending FINACK seg_t.\n");
+				}
 
-		if(!segPtr)
-			break;
+			  } else {
+			  	printf("Doing nothing.\n");
+			  }
+			  break;
 
-		//get the right server_tcb_t index
-		unsigned int destPort = segPtr->header.dest_port;
-		int idx = 0;
-		while (idx < MAX_TRANSPORT_CONNECTIONS) {
-			if (server_TCB_Table[idx] != NULL) {
-				if (server_TCB_Table[idx]->svr_portNum == destPort){
-					break;
-				}
-			}
-			idx++;
+			default:
+			  printf("Unknown state.\n");
+			  break;
 		}
+		conntable_put(&serverConnTable, sockfd);
+	} else {
+		printf("Couldn't find the server_tcb the client was trying to reach.\n");
+	}
+}
 
-		if (idx < MAX_TRANSPORT_CONNECTIONS){
-			svr_tcb_t *currentTCB = server_TCB_Table[idx];
-			printf("\nReceived %s in state %s. client: %u, server: %u.\n", 
-				segTypeStrings[segPtr->header.type], states[currentTCB->state], segPtr->header.src_port, segPtr->header.dest_port);
-
-			switch(currentTCB->state) {
-				case CLOSED:
-				  //printf("State is CLOSED.\n");
-				  printf("Doing nothing.\n");
-				  break;
-
-				case LISTENING:
-				  //printf("State is LISTENING.\n");
-				  if (segPtr->header.type == SYN){
-				  	printf("Changing state to CONNECTED. client_portNum: %u, expect_seqNum: %u. Sending SYNACK.\n",
-				  		 segPtr->header.src_port, segPtr->header.seq_num);
-				  	currentTCB->state = CONNECTED;
-				  	currentTCB->client_portNum = segPtr->header.src_port;
-					currentTCB->expect_seqNum = segPtr->header.seq_num;
-					currentTCB->client_nodeID = src_nodeID; //new
-				  	
-				  	//create SYNACK seg_t
-					seg_t* synSegPtr = malloc(sizeof(seg_t));
-					MALLOC_CHECK(synSegPtr);
-					memset(synSegPtr, 0, sizeof(seg_t));
-					synSegPtr->header.src_port = currentTCB->svr_portNum;
-					synSegPtr->header.dest_port = currentTCB->client_portNum;
-					synSegPtr->header.type = SYNACK;
-
-					//send SYNACK seg_t
-					if (snp_sendseg(overlay_conn_fd, currentTCB->client_nodeID, synSegPtr) < 0) {
-						printf("Error sending SYNACK seg_t.\n");
-					}
-					free(synSegPtr);
-				  } else {
-				  	printf("Doing nothing.\n");
-				  }
-				  break;
-
-				case CONNECTED:
-				  //printf("State is CONNECTED.\n");
-				  if (segPtr->header.type == SYN  && currentTCB->client_portNum == segPtr->header.src_port && currentTCB->client_nodeID == src_nodeID){
-				  	printf("Sending SYNACK.\n");
-
-				  	//create SYNACK seg_t
-					seg_t* synSegPtr = malloc(sizeof(seg_t));
-					MALLOC_CHECK(synSegPtr);
-					memset(synSegPtr, 0, sizeof(seg_t));
-					synSegPtr->header.src_port = currentTCB->svr_portNum;
-					synSegPtr->header.dest_port = currentTCB->client_portNum;
-					synSegPtr->header.type = SYNACK;
-
-					//send SYNACK seg_t
-					if (snp_sendseg(overlay_conn_fd, currentTCB->client_nodeID, synSegPtr) < 0) {
-						printf("Error sending SYNACK seg_t.\n");
-					}
-					free(synSegPtr);
-				  } else if (segPtr->header.type == FIN  && currentTCB->client_portNum == segPtr->header.src_port && currentTCB->client_nodeID == src_nodeID) {
-
-				  	printf("Changing state to CLOSEWAIT and sending FINACK.\n");
-				  	currentTCB->state = CLOSEWAIT;
-				  	pthread_t closeWaitThread;
-				    if (pthread_create(&closeWaitThread, NULL, closeWaitTimer, currentTCB)){
-				    	printf("Error creating closeWaitTimer thread.\n");
-				    }
-
-				  	//create FINACK seg_t
-					seg_t *finSegPtr = malloc(sizeof(seg_t));
-					MALLOC_CHECK(finSegPtr);
-					memset(finSegPtr, 0, sizeof(seg_t));
-					finSegPtr->header.src_port = currentTCB->svr_portNum;
-					finSegPtr->header.dest_port = currentTCB->client_portNum;
-					finSegPtr->header.type = FINACK;
-
-					//send FINACK seg_t
-					if (snp_sendseg(overlay_conn_fd, currentTCB->client_nodeID, finSegPtr) < 0) {
-						printf("Error sending FINACK seg_t.\n");
-					}
-					free(finSegPtr);
-
-				  } else if (segPtr->header.type == DATA  && currentTCB->client_portNum == segPtr->header.src_port && currentTCB->client_nodeID == src_nodeID) {
-
-					  	//create DATAACK seg_t
-						seg_t *dataSegPtr = malloc(sizeof(seg_t));
-						MALLOC_CHECK(dataSegPtr);
-						memset(dataSegPtr, 0, sizeof(seg_t));
-						dataSegPtr->header.src_port = currentTCB->svr_portNum;
-						dataSegPtr->header.dest_port = currentTCB->client_portNum;
-						dataSegPtr->header.type = DATAACK;
-
-						//if the seq_nums match, add to buffer and increment relevant variables
-						pthread_mutex_lock(currentTCB->bufMutex);
-						if (segPtr->header.seq_num == currentTCB->expect_seqNum) {
-							//put received data in recv buffer if it can fit
-							if (segPtr->header.length + currentTCB->usedBufLen < RECEIVE_BUF_SIZE) {
-								printf("Seq_nums match (%u)! Adding to buffer.\n", segPtr->header.seq_num);
-								memcpy(currentTCB->recvBuf, segPtr->data, segPtr->header.length);
-								currentTCB->recvBuf += segPtr->header.length;
-								currentTCB->usedBufLen += segPtr->header.length;
-								currentTCB->expect_seqNum += segPtr->header.length;
-							} else {
-								printf("Seq_nums match but recv Buf is too full. Dropping data and sending DATAACK.\n");
-							}
-						} else {
-							printf("Out of order packet (%u).\n", segPtr->header.seq_num);
-						}
-						dataSegPtr->header.seq_num = currentTCB->expect_seqNum;
-						pthread_mutex_unlock(currentTCB->bufMutex);
-
-						//send DATAACK seg_t
-						printf("Sending DATAACK with expect_seqNum %u.\n", dataSegPtr->header.seq_num);
-						if (snp_sendseg(overlay_conn_fd, currentTCB->client_nodeID, dataSegPtr) < 0) {
-							printf("Error sending DATAACK seg_t.\n");
-						}
-						free(dataSegPtr);
-				  } else {
-				  	printf("Doing nothing.\n");
-				  }
-				  break;
-
-				case CLOSEWAIT:
-				  //printf("State is CLOSEWAIT.\n");
-				  if (segPtr->header.type == FIN  && currentTCB->client_portNum == segPtr->header.src_port && currentTCB->client_nodeID == src_nodeID){
-
-				  	printf("Sending FINACK.\n");
-				  	//create FINACK seg_t
-					seg_t* synSegPtr = malloc(sizeof(seg_t));
-					MALLOC_CHECK(synSegPtr);
-					memset(synSegPtr, 0, sizeof(seg_t));
-					synSegPtr->header.src_port = currentTCB->svr_portNum;
-					synSegPtr->header.dest_port = currentTCB->client_portNum;
-					synSegPtr->header.type = FINACK;
-
-					//send FINACK seg_t
-					if (snp_sendseg(overlay_conn_fd, currentTCB->client_nodeID, synSegPtr) < 0) {
-						printf("Error sending FINACK seg_t.\n");
-					}
-					free(synSegPtr);
-
-				  } else {
-				  	printf("Doing nothing.\n");
-				  }
-				  break;
-
-				default:
-				  printf("Unknown state.\n");
-				  break;
-			}
+
+
+//creates a CLOSED TCB on port and stores it in the server connection table
+//returns the TCB, or NULL if MAX_TRANSPORT_CONNECTIONS sockets are in use
+svr_tcb_t* createTCB(unsigned int port)
+{
+	//malloc new server tcb entry
+	svr_tcb_t *newTCB = malloc(sizeof(svr_tcb_t));
+	MALLOC_CHECK(newTCB);
+	memset(newTCB, 0, sizeof(svr_tcb_t));
+
+	//initialize TCB entry, its stream with the recv buffer and mutex
+	newTCB->svr_portNum = port;
+	newTCB->state = CLOSED;
+	newTCB->fastOpen = 1;
+	newTCB->bufMutex = malloc(sizeof(pthread_mutex_t));
+	memset(newTCB->bufMutex, 0, sizeof(pthread_mutex_t));
+	txsched_flowinit(&newTCB->txFlow);
+	stream_init(&newTCB->stream, newTCB->bufMutex, txSched, &newTCB->txFlow);
+	pthread_cond_init(&newTCB->acceptCond, NULL);
+	timer_condinit(&newTCB->closedCond);
+	timer_init(&newTCB->closeWaitTimer, closeWaitTimeout, newTCB);
+	timer_init(&newTCB->idleTimer, idleCheck, newTCB);
+	newTCB->svr_nodeID = topology_getMyNodeID();
+	printf("My nodeID is %u.\n", newTCB->svr_nodeID);
+
+	//initialize mutex
+	if (pthread_mutex_init(newTCB->bufMutex, NULL) != 0) {
+	    printf("\n mutex init failed\n");
+	    free(newTCB->bufMutex);
+	    free(newTCB);
+	    return NULL;
+	}
+
+	//the TCB is bound to its port in srt_server_listen, or to its client in listenSyn
+	int sockfd = conntable_alloc(&serverConnTable, newTCB);
+	if (sockfd < 0) {
+		printf("You've reached the maximum number of transport connections.\n");
+		pthread_mutex_destroy(newTCB->bufMutex);
+		free(newTCB->bufMutex);
+		free(newTCB);
+		return NULL;
+	}
+	newTCB->sockfd = sockfd;
+	return newTCB;
+}
+
+
+//removes the TCB from the server connection table and frees it with its stream
+void freeTCB(svr_tcb_t* currentTCB)
+{
+	//idleCheck unbinds the socket descriptor, it must be done before the slot is reused
+	timer_cancel_sync(&currentTCB->closeWaitTimer);
+	timer_cancel_sync(&currentTCB->idleTimer);
+	conntable_free(&serverConnTable, currentTCB->sockfd);
+	//segments still queued, like the FIN of an idle connection, are sent before the flow is closed
+	if (txsched_flowflush(txSched, &currentTCB->txFlow, FIN_TIMEOUT) < 0) {
+		printf("Dropping the segments still queued.\n");
+	}
+	printf("Freeing send and recv buffers.\n");
+	stream_destroy(&currentTCB->stream);
+	if (currentTCB->dgram != NULL) {
+		dgram_destroy(currentTCB->dgram);
+	}
+	printf("Destroying mutex.\n");
+	pthread_cond_destroy(&currentTCB->acceptCond);
+	pthread_cond_destroy(&currentTCB->closedCond);
+	pthread_mutex_destroy(currentTCB->bufMutex);
+	free(currentTCB->bufMutex);
+	printf("Freeing TCB of sockfd %d.\n", currentTCB->sockfd);
+	free(currentTCB);
+}
+
+
+//handles a SYN to the listening socket listenTCB: creates a CONNECTED socket for the client,
+//queues it for srt_server_accept and sends the SYNACK
+//SYNs from different clients are handled by different workers, the listening socket's mutex
+//serializes them. Retransmitted SYNs of a queued client find its own socket instead.
+void listenSyn(svr_tcb_t* listenTCB, seg_t* segPtr, int src_nodeID)
+{
+	pthread_mutex_lock(listenTCB->bufMutex);
+	if (listenTCB->state != LISTENING) {
+		pthread_mutex_unlock(listenTCB->bufMutex);
+		printf("Socket was closed. Doing nothing.\n");
+		return;
+	}
+	if (listenTCB->acceptLen >= listenTCB->backlog) {
+		pthread_mutex_unlock(listenTCB->bufMutex);
+		printf("Accept queue of port %u is full. Dropping SYN, the client retries.\n", listenTCB->svr_portNum);
+		return;
+	}
+	//messages and byte streams don't mix
+	srt_synopt_t synOpt;
+	seg_getsynopt(segPtr, &synOpt);
+	if (((synOpt.flags & SYNOPT_SEQPACKET) ? 1 : 0) != listenTCB->stream.seqpacket) {
+		pthread_mutex_unlock(listenTCB->bufMutex);
+		printf("Socket type of the client doesn't match port %u. Dropping SYN.\n", listenTCB->svr_portNum);
+		return;
+	}
+	svr_tcb_t *currentTCB = createTCB(listenTCB->svr_portNum);
+	if (currentTCB == NULL) {
+		pthread_mutex_unlock(listenTCB->bufMutex);
+		printf("Couldn't create a socket for the client. Dropping SYN.\n");
+		return;
+	}
+	//the new socket takes the options set on the listening socket
+	currentTCB->fastOpen = listenTCB->fastOpen;
+	currentTCB->idleTimeout = listenTCB->idleTimeout;
+	stream_inherit(&currentTCB->stream, &listenTCB->stream);
+	txsched_setflow(txSched, &currentTCB->txFlow, listenTCB->txFlow.weight, listenTCB->txFlow.priority);
+
+	pthread_mutex_lock(currentTCB->bufMutex);
+	//agree on the smaller of the client's MSS and ours
+	unsigned int mss = min(MAX_SEG_LEN, synOpt.mss);
+	printf("New sockfd %d is CONNECTED. client_portNum: %u, expect_seqNum: %u, MSS: %u. Sending SYNACK.\n",
+		 currentTCB->sockfd, segPtr->header.src_port, segPtr->header.seq_num, mss);
+	currentTCB->client_portNum = segPtr->header.src_port;
+	currentTCB->client_nodeID = src_nodeID; //new
+	conntable_bind(&serverConnTable, currentTCB->sockfd, currentTCB->svr_portNum, src_nodeID, segPtr->header.src_port);
+	stream_pickisn(&currentTCB->stream, currentTCB->svr_portNum, src_nodeID, segPtr->header.src_port);
+	stream_open(&currentTCB->stream, currentTCB->svr_portNum, src_nodeID, segPtr->header.src_port, segPtr->header.seq_num, mss);
+
+	//hand out a cookie if asked, and deliver data on SYN if it comes with a valid one
+	currentTCB->synAckFlags = (synOpt.flags & SYNOPT_COOKIE_REQ) ? SYNOPT_COOKIE : 0;
+	//stamp segments if the client does
+	if (synOpt.flags & SYNOPT_TIMESTAMP) {
+		currentTCB->stream.timestamps = 1;
+		currentTCB->synAckFlags |= SYNOPT_TIMESTAMP;
+	}
+	//send parity segments if both ends want to. A rebuilt segment wouldn't know whether it ends a message
+	if ((synOpt.flags & SYNOPT_FEC) && currentTCB->stream.fecWanted && !currentTCB->stream.seqpacket) {
+		stream_startfec(&currentTCB->stream);
+		currentTCB->synAckFlags |= SYNOPT_FEC;
+	}
+	if (currentTCB->stream.seqpacket) {
+		currentTCB->synAckFlags |= SYNOPT_SEQPACKET;
+	}
+	unsigned int synDataLen;
+	char *synData = seg_getsyndata(segPtr, &synDataLen);
+	if (synData != NULL) {
+		if (currentTCB->fastOpen && (synOpt.flags & SYNOPT_COOKIE) && synOpt.cookie == fastOpenCookie(src_nodeID)
+			&& stream_deliver(&currentTCB->stream, synData, synDataLen)) {
+			printf("Fast open: added %u bytes from the SYN to buffer.\n", synDataLen);
+			currentTCB->synAckFlags |= SYNOPT_DATA;
 		} else {
-			printf("Couldn't find the server_tcb the client was trying to reach.\n");
+			printf("Fast open: dropping %u bytes from the SYN, the client sends them again.\n", synDataLen);
 		}
+	}
+	currentTCB->state = CONNECTED;
+	if (currentTCB->idleTimeout > 0) {
+		timer_arm(&currentTCB->idleTimer, currentTCB->idleTimeout);
+	}
+	pthread_mutex_unlock(currentTCB->bufMutex);
 
-		memset(segPtr, 0, sizeof(seg_t));
-	
+	//send SYNACK seg_t
+	if (sendSynAck(currentTCB) < 0) {
+		printf("Error sending SYNACK seg_t.\n");
 	}
 
-	printf("seghandler is closing the overlay connection.\n");
-	close(overlay_conn_fd);
-	free(segPtr);
-	pthread_exit(NULL);
+	//queue the connection for srt_server_accept
+	if (listenTCB->acceptTail == NULL) {
+		listenTCB->acceptHead = currentTCB;
+	} else {
+		listenTCB->acceptTail->acceptNext = currentTCB;
+	}
+	listenTCB->acceptTail = currentTCB;
+	listenTCB->acceptLen++;
+	pthread_cond_signal(&listenTCB->acceptCond);
+	pthread_mutex_unlock(listenTCB->bufMutex);
 }
 
 
+//timer callback of closeWaitTimer: the client had CLOSEWAIT_TIMEOUT to see the FINACK,
+//switches the connection to CLOSED
+void closeWaitTimeout(void* arg)
+{
+	svr_tcb_t *currentTCB = (svr_tcb_t *)arg;
 
-//after a set amount of time, switches currentTCB's state to CLOSED
-void *closeWaitTimer(void* arg){
+	pthread_mutex_lock(currentTCB->bufMutex);
+	if (currentTCB->state == CLOSEWAIT) {
+		printf("CLOSEWAIT time up! Changing state to CLOSED.\n");
+		currentTCB->state = CLOSED;
+		pthread_cond_broadcast(&currentTCB->closedCond);
+	}
+	pthread_mutex_unlock(currentTCB->bufMutex);
+}
+
+
+//timer callback of idleTimer: closes a connection the client sent nothing on for idleTimeout,
+//unbinds it from the client and sends the FIN, and otherwise checks again when it would be
+//idle for that long
+void idleCheck(void* arg)
+{
 	svr_tcb_t *currentTCB = (svr_tcb_t *)arg;
 
-	//start timer
-	struct timespec ts;
-	unsigned long  tstart, tend;
-	tstart = current_utc_time_ns(&ts);
-
-	while (currentTCB->state == CLOSEWAIT) {
-		//calc time elapsed
-		tend = current_utc_time_ns(&ts);
-		
-		//if timeout, change state to CLOSED and clear recv Buffer
-		//printf("tend - tstart = %ld\n", labs(tend-tstart));
-		if (tend - tstart > NANOSECONDS_PER_SECOND) {
-			currentTCB->state = CLOSED;
-			break;
-		}
+	pthread_mutex_lock(currentTCB->bufMutex);
+	if (currentTCB->state != CONNECTED || currentTCB->idleTimeout == 0) {
+		pthread_mutex_unlock(currentTCB->bufMutex);
+		return;
+	}
+	unsigned long idle = timer_now_ns() - atomic_load(&currentTCB->lastRecvTime);
+	if (idle < currentTCB->idleTimeout) {
+		timer_arm(&currentTCB->idleTimer, currentTCB->idleTimeout - idle);
+		pthread_mutex_unlock(currentTCB->bufMutex);
+		return;
+	}
+	printf("Client of sockfd %d was idle for %lu ms.\n", currentTCB->sockfd, idle / 1000000);
+	pthread_mutex_unlock(currentTCB->bufMutex);
+	closeByServer(currentTCB);
+}
+
+
+//sends a SYNACK carrying the agreed MSS to the client of currentTCB
+//returns 1 for success or -1 for failure
+int sendSynAck(svr_tcb_t *currentTCB)
+{
+	//create SYNACK seg_t
+	seg_t* synSegPtr = malloc(sizeof(seg_t));
+	MALLOC_CHECK(synSegPtr);
+	memset(synSegPtr, 0, sizeof(seg_t));
+	synSegPtr->header.src_port = currentTCB->svr_portNum;
+	synSegPtr->header.dest_port = currentTCB->client_portNum;
+	synSegPtr->header.type = SYNACK;
+	synSegPtr->header.seq_num = currentTCB->stream.initSeqNum;
+
+	srt_synopt_t synOpt;
+	memset(&synOpt, 0, sizeof(srt_synopt_t));
+	synOpt.mss = currentTCB->stream.mss;
+	synOpt.flags = currentTCB->synAckFlags;
+	if (synOpt.flags & SYNOPT_COOKIE) {
+		synOpt.cookie = fastOpenCookie(currentTCB->client_nodeID);
 	}
-	printf("CLOSEWAIT time up! Changing state to CLOSED.\n");
-	pthread_exit(NULL);
+	seg_putsynopt(synSegPtr, &synOpt);
+
+	//send SYNACK seg_t
+	int ret = txsched_send(txSched, &currentTCB->txFlow, currentTCB->client_nodeID, synSegPtr);
+	free(synSegPtr);
+	return (ret < 0) ? -1 : 1;
 }
 
 
+//sends a FINACK to the client of currentTCB
+//returns 1 for success or -1 for failure
+int sendFinAck(svr_tcb_t *currentTCB)
+{
+	//create FINACK seg_t
+	seg_t* finSegPtr = malloc(sizeof(seg_t));
+	MALLOC_CHECK(finSegPtr);
+	memset(finSegPtr, 0, sizeof(seg_t));
+	finSegPtr->header.src_port = currentTCB->svr_portNum;
+	finSegPtr->header.dest_port = currentTCB->client_portNum;
+	finSegPtr->header.type = FINACK;
+
+	//send FINACK seg_t
+	int ret = txsched_send(txSched, &currentTCB->txFlow, currentTCB->client_nodeID, finSegPtr);
+	free(finSegPtr);
+	return (ret < 0) ? -1 : 1;
+}
+
+
+//sends a FIN to the client of currentTCB, closing the connection from the server's side
+//returns 1 for success or -1 for failure
+int sendFin(svr_tcb_t *currentTCB)
+{
+	//create FIN seg_t
+	seg_t* finSegPtr = malloc(sizeof(seg_t));
+	MALLOC_CHECK(finSegPtr);
+	memset(finSegPtr, 0, sizeof(seg_t));
+	finSegPtr->header.src_port = currentTCB->svr_portNum;
+	finSegPtr->header.dest_port = currentTCB->client_portNum;
+	finSegPtr->header.type = FIN;
+
+	//send FIN seg_t
+	int ret = txsched_send(txSched, &currentTCB->txFlow, currentTCB->client_nodeID, finSegPtr);
+	free(finSegPtr);
+	return (ret < 0) ? -1 : 1;
+}
+
 
+//the client closed the connection and all our data is Acked: switches the connection to
+//CLOSEWAIT and sends the FINACK
+void closeWaitStart(svr_tcb_t *currentTCB)
+{
+	printf("Changing state to CLOSEWAIT and sending FINACK.\n");
+	stream_stop(&currentTCB->stream);
+	pthread_mutex_lock(currentTCB->bufMutex);
+	currentTCB->state = CLOSEWAIT;
+	currentTCB->finPending = 0;
+	timer_cancel(&currentTCB->idleTimer);
+	timer_arm(&currentTCB->closeWaitTimer, (unsigned long)CLOSEWAIT_TIMEOUT * NANOSECONDS_PER_SECOND);
+	pthread_mutex_unlock(currentTCB->bufMutex);
 
+	if (sendFinAck(currentTCB) < 0) {
+		printf("Error sending FINACK seg_t.\n");
+	}
+}
+
+
+//the server closes a CONNECTED connection: switches it to CLOSED, stops its stream, unbinds it
+//from the client and sends the FIN. Does nothing in any other state
+void closeByServer(svr_tcb_t *currentTCB)
+{
+	pthread_mutex_lock(currentTCB->bufMutex);
+	if (currentTCB->state != CONNECTED) {
+		pthread_mutex_unlock(currentTCB->bufMutex);
+		return;
+	}
+	printf("Changing state of sockfd %d to CLOSED and sending FIN.\n", currentTCB->sockfd);
+	currentTCB->state = CLOSED;
+	pthread_cond_broadcast(&currentTCB->closedCond);
+	pthread_mutex_unlock(currentTCB->bufMutex);
+	stream_stop(&currentTCB->stream);
+
+	//later segments of the client go to the listening socket, the client's FINACK is ignored there
+	conntable_unbind(&serverConnTable, currentTCB->sockfd);
+	if (sendFin(currentTCB) < 0) {
+		printf("Error sending FIN seg_t.\n");
+	}
+}
+
+
+//returns the fast open cookie of the client node. It is the keyed hash of the node ID under
+//fastOpenKey, so the server doesn't keep any state for the cookies it hands out and a
+//client can't make up the cookie of a node without knowing the key
+unsigned int fastOpenCookie(int nodeID)
+{
+	unsigned int cookie = (unsigned int)siphash(&fastOpenKey, &nodeID, sizeof(nodeID));
+	return (cookie != 0) ? cookie : 1;
+}
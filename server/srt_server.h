@@ -14,8 +14,17 @@
 #define SRTSERVER_H
 
 #include <pthread.h>
+#include <stdatomic.h>
+#include <sys/types.h>
 #include "../common/seg.h"
 #include "../common/constants.h"
+#include "../common/timer.h"
+#include "../common/conntable.h"
+#include "../common/dispatch.h"
+#include "../common/txsched.h"
+#include "../common/stream.h"
+#include "../common/dgram.h"
+#include "../common/siphash.h"
 
 //server states used in FSM
 #define	CLOSED 1
@@ -31,10 +40,25 @@ typedef struct svr_tcb {
 	unsigned int client_nodeID;     //node ID of client, similar as IP address, currently unused
 	unsigned int client_portNum;    	//port number of client
 	unsigned int state;         		//state of server
-	unsigned int expect_seqNum;     	//the server's expecting data sequence number	
-	char* recvBuf;                  	//a pointer pointing to the receive buffer
-	unsigned int  usedBufLen;       	//size of the received data in receive buffer
-	pthread_mutex_t* bufMutex;      	//a pointer pointing to the mutex which is used for receive buffer access
+	int sockfd;                     	//socket descriptor of the TCB in the connection table
+	pthread_mutex_t* bufMutex;      	//a pointer pointing to the mutex which is used for send and receive buffer access
+	txsched_flow_t txFlow;          	//queue of the segments waiting for the transmit scheduler
+	stream_t stream;                	//data transfer in both directions, set up when the SYN arrives
+	int fastOpen;                   	//1 if data on SYN with a valid cookie is accepted
+	unsigned int synAckFlags;       	//SYNOPT_ flags of the SYNACK, repeated if the SYN is retransmitted
+	unsigned int backlog;           	//listening socket: most connections waiting in the accept queue
+	unsigned int acceptLen;         	//listening socket: number of connections in the accept queue
+	struct svr_tcb* acceptHead;     	//listening socket: first connection waiting for srt_server_accept
+	struct svr_tcb* acceptTail;     	//listening socket: last connection waiting for srt_server_accept
+	pthread_cond_t acceptCond;      	//listening socket: signaled when a connection is queued or the socket closed
+	struct svr_tcb* acceptNext;     	//next connection in the accept queue of the listening socket
+	srt_timer_t closeWaitTimer;     	//ends CLOSEWAIT after CLOSEWAIT_TIMEOUT
+	pthread_cond_t closedCond;      	//signaled when the connection becomes CLOSED, srt_server_close lingers on it
+	int finPending;                 	//1 once the client's FIN arrived with our data not Acked yet, the FINACK waits for it
+	unsigned long idleTimeout;      	//a connection the client sends nothing on for this many nanoseconds is closed with a FIN, 0 never
+	atomic_ulong lastRecvTime;      	//monotonic time in nanoseconds the last segment of the client arrived
+	srt_timer_t idleTimer;          	//checks for idleTimeout while CONNECTED
+	dgram_t* dgram;                 	//datagram state of a SRT_DGRAM socket, NULL for the other types
 } svr_tcb_t;
 
 
@@ -62,50 +86,292 @@ typedef struct svr_tcb {
 
 void srt_server_init(int conn);
 
-// This function initializes the TCB table marking all entries NULL. It also initializes 
+// This function initializes the connection table of the TCBs. It also initializes 
 // a global variable for the overlay TCP socket descriptor ``conn'' used as input parameter
-// for snp_sendseg and snp_recvseg. Finally, the function starts the seghandler thread to 
-// handle the incoming segments. There is only one seghandler for the server side which
-// handles call connections for the client.
+// for snp_sendseg and snp_recvseg, and starts the transmit scheduler that sends the
+// segments of all sockets on it. Finally, the function starts the dispatcher 
+// thread and its pool of worker threads, which run seghandler for the incoming segments
+// of all connections, each connection on one worker.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
 
 int srt_server_sock(unsigned int port);
 
-// This function looks up the client TCB table to find the first NULL entry, and creates
-// a new TCB entry using malloc() for that entry. All fields in the TCB are initialized 
+// This function creates a new TCB entry using malloc() and stores it in the server connection
+// table, which hands out a free socket descriptor for it. All fields in the TCB are initialized 
 // e.g., TCB state is set to CLOSED and the server port set to the function call parameter 
-// server port.  The TCB table entry index should be returned as the new socket ID to the server 
-// and be used to identify the connection on the server side. If no entry in the TCB table  
-// is available the function returns -1.
+// server port.  The socket descriptor should be returned as the new socket ID to the server 
+// and be used to identify the connection on the server side. If MAX_TRANSPORT_CONNECTIONS  
+// sockets are in use the function returns -1.
 
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
 
+int srt_server_socktype(unsigned int port, int type);
+
+// Creates a socket like srt_server_sock, of the given type: SRT_STREAM, the type of
+// srt_server_sock, carries a byte stream, SRT_SEQPACKET carries messages. On a SRT_SEQPACKET
+// socket each srt_server_send is one message, however many segments it takes, and
+// srt_server_recvmsg returns one whole message per call. A SRT_SEQPACKET socket only accepts
+// clients whose socket is SRT_SEQPACKET, and the other way round. Forward error correction
+// isn't used on SRT_SEQPACKET connections.
+// A SRT_DGRAM socket doesn't listen or connect: it takes the datagrams of any client sent to
+// its port right away, with srt_server_recvfrom or srt_server_recvmsg, and sends datagrams with
+// srt_server_sendto. Datagrams aren't Acked or retransmitted, see srt_server_sendto.
+// Returns the socket descriptor, or -1 if the type is unknown or MAX_TRANSPORT_CONNECTIONS
+// sockets are in use.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_listen(int sockfd, unsigned int backlog);
+
+// This function gets the TCB pointer using the sockfd and changes the state of the socket to
+// LISTENING: SYNs from any client to its port are handled by it from now on. Each SYN creates
+// a new CONNECTED socket for the client, which waits in the accept queue of the listening socket
+// until srt_server_accept takes it. While backlog connections are waiting (LISTEN_BACKLOG if 0),
+// further SYNs are dropped, and the clients retry. Returns 1 on success, -1 if the socket isn't
+// CLOSED or LISTENING.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
 int srt_server_accept(int sockfd);
 
-// This function gets the TCB pointer using the sockfd and changes the state of the connection to 
-// LISTENING. It then starts a timer to ``busy wait'' until the TCB's state changes to CONNECTED 
-// (seghandler does this when a SYN is received). It waits in an infinite loop for the state 
-// transition before proceeding and to return 1 when the state change happens, dropping out of
-// the busy wait loop. You can implement this blocking wait in different ways, if you wish.
+// This function gets the TCB pointer of a listening socket using the sockfd and waits until
+// a client connected to it, i.e. until seghandler queued a connection for the SYN of a client.
+// It takes the first connection off the accept queue and returns its socket descriptor, which
+// is CONNECTED and used to receive from and send to that client. A socket that isn't listening
+// yet starts listening with LISTEN_BACKLOG first. Returns -1 if the socket can't listen or
+// is closed while waiting.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
 
 int srt_server_recv(int sockfd, void* buf, unsigned int length);
 
-// Receive data from a srt client. Recall this is a unidirectional transport
-// where DATA flows from the client to the server. Signaling/control messages
-// such as SYN, SYNACK, etc.flow in both directions. 
-// This function keeps polling the receive buffer every RECVBUF_POLLING_INTERVAL
-// until the requested data is available, then it stores the data and returns 1
-// If the function fails, return -1 
+// Receive data from a srt client. Connections are full duplex: DATA flows from
+// the client to the server and, with srt_server_send, from the server to the client.
+// Signaling/control messages such as SYN, SYNACK, etc.flow in both directions. 
+// This function waits until the requested data is available, woken by seghandler as
+// data arrives, then it stores the data and returns 1.
+// If the function fails, or the receive timeout expires or the client closes the
+// connection first, return -1 
 //
 // Note that srt_server_recv blocked waiting for the user requested number
-// of bytes (i.e., length) are at the server before returning data to the application
+// of bytes (i.e., length) are at the server before returning data to the application.
+// length may be larger than RECEIVE_BUF_SIZE, the data is taken out as it arrives.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_read(int sockfd, void* buf, unsigned int length, int flags);
+
+// Read data from a srt client as it arrives. This function waits until data is in the
+// receive buffer and returns up to length bytes of it right away; with the SRT_WAITALL flag
+// it keeps reading until length bytes arrived. The receive window reopens as data is read,
+// so a transfer of any size streams through the bounded receive buffer.
+// Returns the number of bytes read, 0 once the client closed the connection and all its
+// data was read, or -1 if the socket doesn't exist or the receive timeout expired first.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_recvmsg(int sockfd, void* buf, unsigned int length);
+
+// Receive a message from the client of a SRT_SEQPACKET socket. This function waits until a
+// whole message arrived and stores it in buf: one srt_client_send of the client, never part
+// of one or several. A message longer than length is cut to length bytes, the rest of it is
+// dropped. A message too long to wait for in the receive buffer is taken out as it arrives.
+// On a SRT_DGRAM socket it receives a datagram like srt_server_recvfrom.
+// Returns the number of bytes stored, 0 once the client closed the connection and all its
+// messages were read, or -1 if the socket doesn't exist or is SRT_STREAM, or the receive
+// timeout expired first.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_recv_zc(int sockfd, srt_view_t views[2], unsigned int length);
+
+// Lend data from a srt client without copying it. This function waits until data is in the
+// receive buffer, like srt_server_read, and points views at up to length bytes of it in place.
+// Data that wraps around the end of the receive buffer comes in two pieces: views[0] is the
+// first part, views[1] the rest, otherwise views[1] is empty. The data is read-only and stays
+// in the receive buffer until srt_server_release frees it; until then no other read may be
+// made on the socket. Returns the number of bytes lent, 0 once the client closed the connection
+// and all its data was read, or -1 if the socket doesn't exist or the receive timeout expired.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_release(int sockfd, unsigned int length);
+
+// Free the first length bytes lent by srt_server_recv_zc, once the application is done with
+// them, and reopen the receive window. Views of the data beyond length aren't valid afterwards,
+// srt_server_recv_zc lends it again. Returns 1 on success, -1 if the socket doesn't exist or
+// fewer than length bytes are in the receive buffer.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_recv_to_fd(int sockfd, int fd, off_t offset, unsigned int length);
+
+// Receive length bytes of data from a srt client straight into the file fd, starting at
+// offset in the file. The data is written to the file from the receive buffer as it arrives,
+// without passing through an application buffer, and its room in the receive buffer is freed
+// as soon as it is written, so a file of any size streams through the bounded receive buffer.
+// Returns the number of bytes written, which is less than length if the client closed the
+// connection, writing the file failed or the receive timeout expired first, or -1 if the socket
+// doesn't exist or nothing was written. At most INT_MAX bytes are received per call.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_send(int sockfd, void* data, unsigned int length);
+
+// Send data to the srt client of a CONNECTED socket. The data is queued in the send buffer
+// of the TCB's stream in segments of the agreed MSS and sent under the same GBN window,
+// retransmission and pacing as client data; the ACKs of the data received from the client
+// ride along in these segments. srt_server_send is non-blocking. Once the client closed the
+// connection, the data already queued is still delivered before the server Acks the client's
+// FIN, but no more can be queued. Returns 1 if the data is queued, -1 otherwise.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_sendto(int sockfd, int nodeID, unsigned int port, void* data, unsigned int length);
+
+// Send length bytes of data, at most MAX_SEG_LEN, as one datagram from a SRT_DGRAM socket to
+// the client port on node nodeID. The datagram goes out through the transmit scheduler like
+// any segment, but nothing is kept once it is sent: there is no handshake, ACK or
+// retransmission, so a datagram may be lost, and datagrams may arrive out of order. In
+// exchange, no datagram waits behind a lost one. Returns 1 once the datagram is queued for
+// sending, -1 if the socket doesn't exist or isn't SRT_DGRAM, or the data doesn't fit.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_recvfrom(int sockfd, void* buf, unsigned int length, int* nodeID, unsigned int* port);
+
+// Receive a datagram on a SRT_DGRAM socket. This function waits until a datagram of any client
+// arrived at the socket's port, stores it in buf, cut to length bytes, and the node ID and
+// port of the client that sent it in *nodeID and *port, unless they are NULL. Datagrams are
+// read in the order they arrived; while DGRAM_QUEUE_LEN wait to be read, further ones are
+// dropped. Returns the number of bytes stored, 0 if the socket was closed, or -1 if the socket
+// doesn't exist or isn't SRT_DGRAM, or the receive timeout expired first.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_setdgramseq(int sockfd, int on);
+
+// Turns the sequence numbers of the datagrams a SRT_DGRAM socket sends on or off. With them
+// on, the receiving socket counts the datagrams of the sender lost and arrived late, see
+// srt_server_dgramstats. They are off by default. Returns 1 on success, -1 if the socket
+// doesn't exist or isn't SRT_DGRAM.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_dgramstats(int sockfd, srt_dgramstats_t* stats);
+
+// Copies the statistics of a SRT_DGRAM socket into stats: the datagrams sent, received and
+// dropped because the application didn't read them in time, and of the numbered datagrams
+// of the senders, those that didn't arrive, those counted lost that arrived late after all
+// and those that arrived again or too late to tell.
+// Returns 1 on success, -1 if the socket doesn't exist or isn't SRT_DGRAM.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_setdelack(int sockfd, unsigned int ackEvery, unsigned int ackDelay_ms);
+
+// Sets the delayed-ACK policy of the socket. A cumulative DATAACK is sent after ackEvery
+// in-order DATA segments, or ackDelay_ms milliseconds after the first unAcked one arrived.
+// Out-of-order and duplicate segments, and the segment that fills a gap, are Acked at
+// once. ackEvery 1 acknowledges every segment. Zero values select DELAYED_ACK_SEGMENTS
+// and DELAYED_ACK_TIMEOUT. A DATA segment sent to the client in the meantime carries
+// the ACK, and no DATAACK is sent. Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_setsched(int sockfd, unsigned int weight, unsigned int priority);
+
+// Sets the transmit scheduling of the socket. The sockets of a process share the overlay
+// connection: sockets of a lower priority number are served first, and sockets of the same
+// priority share it in proportion to their weight. priority is at most TXSCHED_PRIORITIES - 1,
+// weight 0 is taken as 1. New sockets have weight 1 and TXSCHED_DEFAULT_PRIORITY.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+int srt_server_setfastopen(int sockfd, int on);
+
+// Turns fast open on or off for the socket. With fast open on, data a client sends in its
+// SYN together with a valid cookie is delivered into the receive buffer while the
+// connection is accepted, and the SYNACK acknowledges it. With fast open off, the data is
+// dropped and the client sends it again once connected. Cookies are handed out either way.
+// Fast open is on by default. Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_setfec(int sockfd, int on);
+
+// Turns forward error correction on or off for the socket. With it on, a client that asks for
+// it in its SYN is told so in the SYNACK, and both ends send a DATAFEC parity segment of their
+// data every few segments, more often the more segments are retransmitted. When one segment of
+// the data a parity segment covers is lost, the receiver rebuilds it without waiting for the
+// retransmission. Connections accepted on a listening socket take its setting. It is off by default.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_setmultipath(int sockfd, unsigned int paths);
+
+// Sets the number of overlay paths, at most MULTIPATH_MAX_PATHS, the segments the socket sends are
+// striped over. Each segment carries a path hint to SNP: path 0 is the routing table's route, the
+// others start at the neighbors whose own route to the destination doesn't lead back through this
+// node. New segments are spread over the paths in inverse proportion to the RTT measured on each,
+// raised by the share of segments lost on it, and a retransmission goes out on another path than
+// the one it was lost on. The receiver puts the segments back in order. 1, the default, sends all
+// segments on the routing table's route. Connections accepted on a listening socket take its setting.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_setrecvtimeout(int sockfd, unsigned int timeout_ms);
+
+// Sets how long srt_server_recv and srt_server_read wait for data from the client:
+// timeout_ms milliseconds, or forever if 0, which is the default.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_setidletimeout(int sockfd, unsigned int timeout_ms);
+
+// Sets how long a connection may go without a segment from the client: once the client sent
+// nothing for timeout_ms milliseconds, the connection is CLOSED, a FIN tells the client and
+// reads waiting for data return. Its segments no longer reach the socket. 0, the default, keeps idle connections open. Connections
+// accepted on a listening socket take its idle timeout.
+// Returns 1 on success, -1 if the socket doesn't exist.
+//
+//++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+//
+
+int srt_server_setlinger(int sockfd, int on, unsigned int linger_ms);
+
+// Sets the linger option of the socket. With linger on, srt_server_close of a connected
+// socket first waits until all data sent to the client is Acked and the client has closed
+// the connection, at most linger_ms milliseconds (LINGER_TIMEOUT if 0). With linger off,
+// srt_server_close fails until the connection is CLOSED. Linger is on by default.
+// Returns 1 on success, -1 if the socket doesn't exist.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
@@ -114,23 +380,68 @@ int srt_server_close(int sockfd);
 
 // This function calls free() to free the TCB entry. It marks that entry in TCB as NULL
 // and returns 1 if succeeded (i.e., was in the right state to complete a close) and -1 
-// if fails (i.e., in the wrong state).
+// if fails (i.e., in the wrong state). A connected socket that lingers first waits for
+// its data to be Acked and for the client to close the connection. Closing a listening
+// socket also closes the connections in its accept queue and sends a FIN to their clients.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
 
-void* seghandler(void* arg);
+void seghandler(seg_t* segPtr, int src_nodeID);
 
-// This is a thread  started by srt_server_init(). It handles all the incoming 
-// segments from the client. The design of seghanlder is an infinite loop that calls snp_recvseg(). If
-// snp_recvseg() fails then the overlay connection is closed and the thread is terminated. Depending
+// This function handles an incoming segment from the client. It is called by the worker threads
+// of the dispatcher started by srt_server_init(), which receives the segments with snp_recvseg() and
+// hands all segments of a connection to the same worker, in order. If snp_recvseg() fails
+// then the overlay connection is closed and the threads are terminated. Depending
 // on the state of the connection when a segment is received  (based on the incoming segment) various
 // actions are taken. See the client FSM for more details.
 //
 //++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
 //
 
-//after a set amount of time, switches currentTCB's state to CLOSED
-void* closeWaitTimer(void* arg);
+//creates a CLOSED TCB on port and stores it in the server connection table
+//returns the TCB, or NULL if MAX_TRANSPORT_CONNECTIONS sockets are in use
+svr_tcb_t* createTCB(unsigned int port);
+
+//removes the TCB from the server connection table and frees it with its stream
+void freeTCB(svr_tcb_t* currentTCB);
+
+//handles a SYN to the listening socket listenTCB: creates a CONNECTED socket for the client,
+//queues it for srt_server_accept and sends the SYNACK
+void listenSyn(svr_tcb_t* listenTCB, seg_t* segPtr, int src_nodeID);
+
+//timer callback of closeWaitTimer: the client had CLOSEWAIT_TIMEOUT to see the FINACK,
+//switches the connection to CLOSED
+void closeWaitTimeout(void* arg);
+
+//timer callback of idleTimer: closes a connection the client sent nothing on for idleTimeout,
+//unbinds it from the client and sends the FIN, and otherwise checks again when it would be
+//idle for that long
+void idleCheck(void* arg);
+
+//sends a SYNACK carrying the agreed MSS to the client of currentTCB
+//returns 1 for success or -1 for failure
+int sendSynAck(svr_tcb_t *currentTCB);
+
+//sends a FINACK to the client of currentTCB
+//returns 1 for success or -1 for failure
+int sendFinAck(svr_tcb_t *currentTCB);
+
+//sends a FIN to the client of currentTCB, closing the connection from the server's side
+//returns 1 for success or -1 for failure
+int sendFin(svr_tcb_t *currentTCB);
+
+//the client closed the connection and all our data is Acked: switches the connection to
+//CLOSEWAIT and sends the FINACK
+void closeWaitStart(svr_tcb_t *currentTCB);
+
+//the server closes a CONNECTED connection: switches it to CLOSED, stops its stream, unbinds it
+//from the client and sends the FIN. Does nothing in any other state
+void closeByServer(svr_tcb_t *currentTCB);
+
+//returns the fast open cookie of the client node. It is the keyed hash of the node ID under
+//fastOpenKey, so the server doesn't keep any state for the cookies it hands out and a
+//client can't make up the cookie of a node without knowing the key
+unsigned int fastOpenCookie(int nodeID);
 
 #endif